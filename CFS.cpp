@@ -21,6 +21,7 @@
 #include "ENDF.hpp"
 #include "XRS.hpp"
 #include "DBS.hpp"
+#include "PRS.hpp"
 
 #include <iomanip>
 #include <iostream>
@@ -170,7 +171,7 @@ bool CFSAngularDist::isIsotropic() const {
 }
 
 bool CFSAngularDist::loadENDF
-(const ENDFNeutronData::AngularDist& adist) {
+(const ENDFNeutronData::AngularDist& adist, long nthreads) {
     
     // Clear
     clear();
@@ -239,11 +240,13 @@ bool CFSAngularDist::loadENDF
                     throw std::logic_error("interp dim. error!");
                 }
                 // Linearize Legendre function
-                for (long i=0; i<NE; i++) {
-                    auto& from = adist.legendFunc2.data(i);
-                    auto& to   = ergInFunc->data(i);
-                    insertLegendre(from, to);
-                }
+                PRS::parallelFor(NE, nthreads, 1, [&] (long b, long e) {
+                    for (long i=b; i<e; i++) {
+                        auto& from = adist.legendFunc2.data(i);
+                        auto& to   = ergInFunc->data(i);
+                        insertLegendre(from, to);
+                    }
+                });
                 
                 break;
             }
@@ -297,11 +300,13 @@ bool CFSAngularDist::loadENDF
                 data.resize(NE1+NE2-1);
 
                 // Linearize Legendre function
-                for (long i=0; i<NE1-1; i++) {
-                    auto& from = adist.legendFunc2.data(i);
-                    auto& to   = data[i];
-                    insertLegendre(from, to);
-                }
+                PRS::parallelFor(NE1-1, nthreads, 1, [&] (long b, long e) {
+                    for (long i=b; i<e; i++) {
+                        auto& from = adist.legendFunc2.data(i);
+                        auto& to   = data[i];
+                        insertLegendre(from, to);
+                    }
+                });
                 
                 // Linearize ENDF interpolation function
                 for (long i=0; i<NE2; i++) {
@@ -3572,6 +3577,11 @@ CFSNeutronData::CFSNeutronData(const ENDFNeutronData* ndata) {
             }
         }
         
+        // Unionized energy grid
+        if (!buildEnergyGrid(ndata)) {
+            throw std::logic_error("unable to build energy grid!");
+        }
+        
     } catch (std::exception& e) {
         std::cerr << "[CFS]: error msg - " << e.what() << std::endl;
         // Clear memory
@@ -4530,6 +4540,11 @@ CFSNeutronData::CFSNeutronData(const ACENeutronData* ndata) {
             
         }
         
+        // Energy grid from the ESZ grid
+        if (!buildEnergyGrid(ndata)) {
+            throw std::logic_error("unable to build energy grid!");
+        }
+        
     } catch (std::exception& e) {
         std::cerr << "[CFS]: error msg - " << e.what() << std::endl;
         // Clear memory
@@ -4634,6 +4649,15 @@ void CFSNeutronData::clear() {
     }
     deleteReaction(alphaContinuum);
     
+    // Release the energy grid
+    energyGrid.clear();
+    
+    // Release the temperature fit
+    if (temperatureFit != nullptr) {
+        delete temperatureFit;
+        temperatureFit = nullptr;
+    }
+    
 };
 
 void CFSNeutronData::iterateNeutronReactions
@@ -4675,6 +4699,16 @@ bool CFSNeutronData::valid() const {
 }
 
 const CFSReaction* CFSNeutronData::getReactionByNumber(long MT) const {
+    return findReactionByNumber(MT);
+}
+
+CFSReaction* CFSNeutronData::getReactionByNumber(long MT) {
+    return findReactionByNumber(MT);
+}
+
+// The reaction pointers are not const in a const object, the overloads
+// of getReactionByNumber give them the constness of the object
+CFSReaction* CFSNeutronData::findReactionByNumber(long MT) const {
     
     try {
         
@@ -5055,6 +5089,480 @@ const CFSReaction* CFSNeutronData::getReactionByNumber(long MT) const {
     }
 }
 
+bool CFSNeutronData::fitTemperature
+(double tempMinK, double tempMaxK, long nterms, long nthreads) {
+    
+    try {
+        
+        // The main cross sections on the energy grid, with the resolved
+        // resonances, in the column order of the fit. The disappearance
+        // is the absorption less the fission
+        auto& data = energyGrid.data();
+        long  N    = data.size();
+        if (N < 2) {
+            throw std::logic_error("no energy grid!");
+        }
+        auto& ys = data.ys();
+        DBSMultiXsec cold;
+        cold.energies.assign(data.xs(), data.xs() + N);
+        cold.columns.resize(4);
+        cold.columns[0].assign(ys.total.begin(), ys.total.end());
+        cold.columns[1].assign(ys.elastic.begin(), ys.elastic.end());
+        cold.columns[2].resize(N);
+        for (long i=0; i<N; i++) {
+            cold.columns[2][i] = ys.absorption[i] - ys.fission[i];
+        }
+        cold.columns[3].assign(ys.fission.begin(), ys.fission.end());
+        
+        auto fit = DBS::fitTemperature
+        (cold, AWR, tempK, tempMinK, tempMaxK, nterms, 2*nterms+1, nthreads);
+        
+        if (temperatureFit != nullptr) {
+            delete temperatureFit;
+        }
+        temperatureFit = new DBSTemperatureFit(std::move(fit));
+        
+    } catch (std::exception& e) {
+        std::cerr << "[CFS]: error msg - " << e.what() << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+// Evaluate a column of the temperature fit
+static double CFSEvaluateTemperatureFit
+(const DBSTemperatureFit* fit, long c, double energyEv, double tempK) {
+    
+    try {
+        
+        if (fit == nullptr) {
+            throw std::logic_error("temperature fit not available!");
+        }
+        if (tempK < fit->tempMinK || tempK > fit->tempMaxK) {
+            throw std::logic_error("temperature out of fitted range!");
+        }
+        return fit->evaluate(c, energyEv, tempK);
+        
+    } catch (std::exception& e) {
+        std::cerr << "[CFS]: error msg - " << e.what() << std::endl;
+        return 0.;
+    }
+}
+
+double CFSNeutronData::getTotal(double energyEv, double tempK) const {
+    return CFSEvaluateTemperatureFit(temperatureFit, 0, energyEv, tempK);
+}
+
+double CFSNeutronData::getElastic(double energyEv, double tempK) const {
+    return CFSEvaluateTemperatureFit(temperatureFit, 1, energyEv, tempK);
+}
+
+double CFSNeutronData::getDisappear(double energyEv, double tempK) const {
+    return CFSEvaluateTemperatureFit(temperatureFit, 2, energyEv, tempK);
+}
+
+double CFSNeutronData::getFission(double energyEv, double tempK) const {
+    return CFSEvaluateTemperatureFit(temperatureFit, 3, energyEv, tempK);
+}
+
+// The cross section of a column of the energy grid, without the leading
+// and trailing zeros, CFSXsec::at gives them back
+static CFSXsec CFSMakeXsec(const std::vector<double>& column) {
+    CFSXsec xsec;
+    long n = column.size(), first = 0, last = n - 1;
+    while (first < n && column[first] == 0.) {
+        first++;
+    }
+    while (last > first && column[last] == 0.) {
+        last--;
+    }
+    if (first == n) {
+        return xsec;
+    }
+    xsec.startIndex = first;
+    xsec.sigmas.assign(column.begin() + first, column.begin() + last + 1);
+    return xsec;
+}
+
+// Add the resolved resonance cross sections rr to the columns of the
+// joint table of the reactions rxns, on the union of the energies. The
+// resonances go to the elastic (MT = 2), fission (MT = 18) and capture
+// (MT = 102) and to the sums of these present in the table (MT = 1, 3,
+// 27, 101). They jump from and to zero at the ends of the range
+static void CFSAddResolvedResonance
+(const std::vector<CFSReaction*>& rxns, const XRSRRFunction& rr,
+ LSJointTable& table) {
+    
+    // Weights of the elastic, capture and fission in each column
+    long C = rxns.size();
+    std::vector<double> we(C, 0.), wc(C, 0.), wf(C, 0.);
+    for (long c=0; c<C; c++) {
+        switch (rxns[c]->MT) {
+            case 1:   we[c] = wc[c] = wf[c] = 1.; break;
+            case 2:   we[c] = 1.;                 break;
+            case 3:
+            case 27:  wc[c] = wf[c] = 1.;         break;
+            case 18:  wf[c] = 1.;                 break;
+            case 101:
+            case 102: wc[c] = 1.;                 break;
+            default:                              break;
+        }
+    }
+    
+    auto& rd = rr.data();
+    auto& xs = table.energies;
+    long  N  = xs.size(), R = rd.size();
+    double EL = rd.front().x, EH = rd.back().x;
+    
+    LSJointTable out;
+    out.pointsIn    = table.pointsIn;
+    out.pointsUnion = table.pointsUnion;
+    out.columns.resize(C);
+    std::vector<double> bg(2*C);
+    XRSRRXsec res[2];
+    long i = 0, r = 0;
+    while (i < N || r < R) {
+        double x = (r == R || (i < N && xs[i] <= rd[r].x)) ?
+        xs[i] : rd[r].x;
+        
+        // The background at x, the first and last rows of a jump
+        long i0 = i;
+        while (i < N && xs[i] == x) {
+            i++;
+        }
+        long nb = (i - i0 > 1) ? 2 : 1;
+        for (long c=0; c<C; c++) {
+            auto& col = table.columns[c];
+            if (i > i0) {
+                bg[c]     = col[i0];
+                bg[C + c] = col[i-1];
+            } else if (i0 > 0 && i0 < N) {
+                double t = (x - xs[i0-1])/(xs[i0] - xs[i0-1]);
+                bg[c] = bg[C + c] = col[i0-1] + t*(col[i0] - col[i0-1]);
+            } else {
+                bg[c] = bg[C + c] = 0.;
+            }
+        }
+        
+        // The resonances at x, linear between the reconstructed points
+        long r0 = r;
+        while (r < R && rd[r].x == x) {
+            r++;
+        }
+        if (r > r0) {
+            res[0] = rd[r0].y;
+            res[1] = rd[r-1].y;
+        } else if (x > EL && x < EH) {
+            auto& p1 = rd[r-1];
+            auto& p2 = rd[r];
+            double t = (x - p1.x)/(p2.x - p1.x);
+            res[0].elastic = p1.y.elastic + t*(p2.y.elastic - p1.y.elastic);
+            res[0].capture = p1.y.capture + t*(p2.y.capture - p1.y.capture);
+            res[0].fission = p1.y.fission + t*(p2.y.fission - p1.y.fission);
+            res[1] = res[0];
+        } else {
+            res[0] = res[1] = XRSRRXsec();
+        }
+        long nr = (x == EL || x == EH || r - r0 > 1) ? 2 : 1;
+        if (x == EL) {
+            res[0] = XRSRRXsec();
+        }
+        if (x == EH) {
+            res[1] = XRSRRXsec();
+        }
+        
+        for (long k=0; k<std::max(nb, nr); k++) {
+            const double*    b = &bg[(k + 1 < nb) ? 0 : C];
+            const XRSRRXsec& y = res[(k + 1 < nr) ? 0 : 1];
+            out.energies.push_back(x);
+            for (long c=0; c<C; c++) {
+                out.columns[c].push_back
+                (b[c] + we[c]*y.elastic + wc[c]*y.capture +
+                 wf[c]*y.fission);
+            }
+        }
+    }
+    out.pointsOut = out.energies.size();
+    
+    table = std::move(out);
+}
+
+bool CFSNeutronData::buildEnergyGrid
+(const ENDFNeutronData* ndata, long nthreads) {
+    
+    try {
+        
+        energyGrid.clear();
+        
+        // All reactions with a background cross section
+        std::vector<CFSReaction*> rxns;
+        std::vector<const ENDFInterpolationFunction*> funcs;
+        for (long MT : supportedReactionNumbers()) {
+            // The reactions are owned, so they can be modified
+            auto rxn = getReactionByNumber(MT);
+            if (rxn == nullptr || !rxn->bgXsec.valid()) {
+                continue;
+            }
+            rxns.push_back(rxn);
+            funcs.push_back(&rxn->bgXsec);
+        }
+        if (funcs.empty()) {
+            throw std::logic_error("no background cross sections!");
+        }
+        
+        // Linearize them jointly on one grid
+        auto table = LS::linearize
+        (funcs, CMS::defaultTol, CMS::zeroThres, nthreads);
+        if (table.energies.size() < 2) {
+            throw std::logic_error("joint linearization error!");
+        }
+        
+        // The resolved resonance cross sections at 0K
+        XRSRRFunction rr;
+        auto rrRange = ndata->getResolvedResonanceRange();
+        if (rrRange.first < rrRange.second) {
+            rr = XRS::processResolvedResonance
+            (ndata, CMS::defaultTol, nthreads);
+            if (!rr.valid()) {
+                throw std::logic_error("resolved resonance error!");
+            }
+        }
+        if (rr.valid()) {
+            CFSAddResolvedResonance(rxns, rr, table);
+        }
+        long N = table.energies.size();
+        
+        // The column of a reaction, nullptr if not there
+        auto column = [&] (const CFSReaction* rxn)
+        -> const std::vector<double>* {
+            for (long c=0; c<rxns.size(); c++) {
+                if (rxns[c] == rxn) {
+                    return &table.columns[c];
+                }
+            }
+            return nullptr;
+        };
+        
+        // The first existing column of reactions, or the sum of the
+        // existing columns of the partial reactions
+        auto mainColumn = [&]
+        (const CFSReaction* rxn, const std::vector<long>& partials)
+        -> std::vector<double> {
+            std::vector<double> col(N, 0.);
+            auto p = column(rxn);
+            if (p != nullptr) {
+                col = *p;
+                return col;
+            }
+            for (long MT : partials) {
+                auto q = column(getReactionByNumber(MT));
+                if (q == nullptr) {
+                    continue;
+                }
+                for (long i=0; i<N; i++) {
+                    col[i] += (*q)[i];
+                }
+            }
+            return col;
+        };
+        
+        // The main cross sections, absorption is 27 = 18 + 101
+        auto totals     = mainColumn(total, {2, 3});
+        auto elastics   = mainColumn(elastic, {});
+        auto fissions   = mainColumn(prompt, {19, 20, 21, 38});
+        auto disappears = mainColumn
+        (disappear, {102, 103, 104, 105, 106, 107, 108, 109,
+            111, 112, 113, 114, 115, 116, 117});
+        auto absorbs    = mainColumn(absorption, {});
+        if (column(absorption) == nullptr) {
+            for (long i=0; i<N; i++) {
+                absorbs[i] = fissions[i] + disappears[i];
+            }
+        }
+        
+        ENDFSoAVector<CFSMainRxnDataPoint> data(N);
+        for (long i=0; i<N; i++) {
+            auto d = data[i];
+            d.x            = table.energies[i];
+            d.y.total      = totals[i];
+            d.y.elastic    = elastics[i];
+            d.y.absorption = absorbs[i];
+            d.y.fission    = fissions[i];
+        }
+        if (!energyGrid.init(std::move(data))) {
+            throw std::logic_error("init energy grid error!");
+        }
+        energyGrid.buildLookup();
+        
+        // The reaction cross sections on the grid
+        for (long c=0; c<rxns.size(); c++) {
+            rxns[c]->xsec = CFSMakeXsec(table.columns[c]);
+        }
+        
+    } catch (std::exception& e) {
+        std::cerr << "[CFS]: error msg - " << e.what() << std::endl;
+        energyGrid.clear();
+        return false;
+    }
+    
+    return true;
+}
+
+bool CFSNeutronData::buildEnergyGrid(const ACENeutronData* ndata) {
+    
+    try {
+        
+        energyGrid.clear();
+        
+        auto& esz = ndata->energyMevGrid.data;
+        long  N   = esz.size();
+        if (N < 2) {
+            throw std::logic_error("no ESZ energy grid!");
+        }
+        
+        // The reaction cross sections are on the ESZ grid already,
+        // the elastic and the total are in the ESZ block
+        std::vector<double> fissions(N, 0.);
+        for (auto& from : ndata->reactions) {
+            auto rxn = getReactionByNumber(from.MT);
+            if (rxn == nullptr || from.xsec.sigmas.empty()) {
+                continue;
+            }
+            rxn->xsec.startIndex = from.xsec.start;
+            rxn->xsec.sigmas     = from.xsec.sigmas;
+            
+            // Fission from MT = 18, or the sum of the partials
+            bool partial = from.MT == 19 || from.MT == 20 ||
+            from.MT == 21 || from.MT == 38;
+            if (from.MT == 18 || (partial && prompt == nullptr)) {
+                for (long i=0; i<N; i++) {
+                    fissions[i] += rxn->xsec.at(i);
+                }
+            }
+        }
+        
+        // The ESZ grid in eV, the ESZ absorption is the disappearance,
+        // without fission
+        ENDFSoAVector<CFSMainRxnDataPoint> data(N);
+        CFSXsec totals, elastics;
+        totals.sigmas.resize(N);
+        elastics.sigmas.resize(N);
+        for (long i=0; i<N; i++) {
+            auto d = data[i];
+            d.x            = esz[i].x * CMS::evPerMev;
+            d.y.total      = esz[i].y.total;
+            d.y.elastic    = esz[i].y.elastic;
+            d.y.absorption = esz[i].y.absorption + fissions[i];
+            d.y.fission    = fissions[i];
+            totals.sigmas[i]   = d.y.total;
+            elastics.sigmas[i] = d.y.elastic;
+        }
+        if (!energyGrid.init(std::move(data))) {
+            throw std::logic_error("init energy grid error!");
+        }
+        energyGrid.buildLookup();
+        
+        if (total != nullptr) {
+            total->xsec = std::move(totals);
+        }
+        if (elastic != nullptr) {
+            elastic->xsec = std::move(elastics);
+        }
+        
+    } catch (std::exception& e) {
+        std::cerr << "[CFS]: error msg - " << e.what() << std::endl;
+        energyGrid.clear();
+        return false;
+    }
+    
+    return true;
+}
+
+// The grid index of an energy, located by locate(energyEv) if it lies
+// in the grid
+template <typename L>
+static CFSGridIndex CFSLocateEnergy
+(const CFSEnergyGrid& energyGrid, double energyEv, L locate) {
+    CFSGridIndex index;
+    auto& data = energyGrid.data();
+    long  N    = data.size();
+    if (N < 2) {
+        return index;
+    }
+    if (energyEv <= data.front().x) {
+        return index;
+    }
+    if (energyEv >= data.back().x) {
+        index.i = N - 2;
+        index.r = 1.;
+        return index;
+    }
+    index.i = locate(energyEv);
+    index.r = (energyEv - data[index.i].x) /
+    (data[index.i+1].x - data[index.i].x);
+    return index;
+}
+
+CFSGridIndex CFSNeutronData::locateEnergy(double energyEv) const {
+    return CFSLocateEnergy
+    (energyGrid, energyEv,
+     [&](double e){ return energyGrid.locate(e); });
+}
+
+CFSGridIndex CFSNeutronData::locateEnergy
+(double energyEv, ENDFCursor& cursor) const {
+    return CFSLocateEnergy
+    (energyGrid, energyEv,
+     [&](double e){ return energyGrid.locate(e, cursor); });
+}
+
+CFSMainRxnDataPoint CFSNeutronData::getMainXsecs
+(const CFSGridIndex& index) const {
+    CFSMainRxnDataPoint xs;
+    auto& data = energyGrid.data();
+    if (data.size() < 2) {
+        return xs;
+    }
+    auto y1 = data[index.i].y;
+    auto y2 = data[index.i+1].y;
+    double r = index.r;
+    xs.total      = y1.total      + r*(y2.total      - y1.total);
+    xs.elastic    = y1.elastic    + r*(y2.elastic    - y1.elastic);
+    xs.absorption = y1.absorption + r*(y2.absorption - y1.absorption);
+    xs.fission    = y1.fission    + r*(y2.fission    - y1.fission);
+    return xs;
+}
+
+double CFSNeutronData::getXsec(long MT, const CFSGridIndex& index) const {
+    auto rxn = getReactionByNumber(MT);
+    if (rxn == nullptr) {
+        return 0.;
+    }
+    return rxn->xsec.evaluate(index);
+}
+
+bool CFSNeutronData::isFissionable() const {
+    return prompt != nullptr || n_f != nullptr;
+}
+
+double CFSNeutronData::getTotal(double energyEv) const {
+    return getMainXsecs(locateEnergy(energyEv)).total;
+}
+
+double CFSNeutronData::getElastic(double energyEv) const {
+    return getMainXsecs(locateEnergy(energyEv)).elastic;
+}
+
+double CFSNeutronData::getDisappear(double energyEv) const {
+    auto xs = getMainXsecs(locateEnergy(energyEv));
+    return xs.absorption - xs.fission;
+}
+
+double CFSNeutronData::getFission(double energyEv) const {
+    return getMainXsecs(locateEnergy(energyEv)).fission;
+}
+
 static long ENDFTabGetLaw
 (const std::vector<ENDFInterpLaw>& interp, long i) {
     long m = -1, n = -1, law = -1;
@@ -24,6 +24,7 @@
 #include "CMS.hpp"
 #include "ENDF.hpp"
 #include "ACE.hpp"
+#include "DBS.hpp"
 
 #include <iostream>
 #include <vector>
@@ -130,9 +131,107 @@ struct CFSMainRxnDataPoint {
     
 };
 
-// The energy grid along with key cross sections
+// The main cross sections of one point of the energy grid by reference
+struct CFSMainRxnRef {
+    double& total;
+    double& elastic;
+    double& absorption;
+    double& fission;
+    
+    CFSMainRxnRef& operator=(const CFSMainRxnDataPoint& xs) {
+        total      = xs.total;
+        elastic    = xs.elastic;
+        absorption = xs.absorption;
+        fission    = xs.fission;
+        return *this;
+    }
+    
+    operator CFSMainRxnDataPoint() const {
+        CFSMainRxnDataPoint xs;
+        xs.total      = total;
+        xs.elastic    = elastic;
+        xs.absorption = absorption;
+        xs.fission    = fission;
+        return xs;
+    }
+};
+
+struct CFSMainRxnConstRef {
+    const double& total;
+    const double& elastic;
+    const double& absorption;
+    const double& fission;
+    
+    operator CFSMainRxnDataPoint() const {
+        CFSMainRxnDataPoint xs;
+        xs.total      = total;
+        xs.elastic    = elastic;
+        xs.absorption = absorption;
+        xs.fission    = fission;
+        return xs;
+    }
+};
+
+// Every main cross section in a column of its own, so the total cross
+// section of a transport lookup does not load the others
+template <>
+struct ENDFSoAColumns<CFSMainRxnDataPoint> {
+    typedef CFSMainRxnRef      Ref;
+    typedef CFSMainRxnConstRef ConstRef;
+    
+    ENDFAlignedVector<double> total;
+    ENDFAlignedVector<double> elastic;
+    ENDFAlignedVector<double> absorption;
+    ENDFAlignedVector<double> fission;
+    
+    void clear() {
+        total.clear();
+        elastic.clear();
+        absorption.clear();
+        fission.clear();
+    }
+    
+    void resize(size_t n) {
+        total.resize(n, 0.);
+        elastic.resize(n, 0.);
+        absorption.resize(n, 0.);
+        fission.resize(n, 0.);
+    }
+    
+    void reserve(size_t n) {
+        total.reserve(n);
+        elastic.reserve(n);
+        absorption.reserve(n);
+        fission.reserve(n);
+    }
+    
+    void push_back(const CFSMainRxnDataPoint& xs) {
+        total.push_back(xs.total);
+        elastic.push_back(xs.elastic);
+        absorption.push_back(xs.absorption);
+        fission.push_back(xs.fission);
+    }
+    
+    Ref ref(size_t i) {
+        return Ref{total[i], elastic[i], absorption[i], fission[i]};
+    }
+    
+    ConstRef ref(size_t i) const {
+        return ConstRef{total[i], elastic[i], absorption[i], fission[i]};
+    }
+};
+
+// The energy grid along with key cross sections, stored by columns
 typedef ENDFObjectInterpolationFunction
-<CFSMainRxnDataPoint> CFSEnergyGrid;
+<CFSMainRxnDataPoint, ENDFEmpty, ENDFBinarySearch, ENDFSoAStorage>
+CFSEnergyGrid;
+
+// An energy located on the energy grid, it lies in the interval i,
+// with the linear interpolation factor r in [0, 1]
+struct CFSGridIndex {
+    long   i = 0;
+    double r = 0.;
+};
 
 struct CFSXsec {
     
@@ -142,6 +241,18 @@ struct CFSXsec {
     // The cross section data points in barn
     std::vector<double> sigmas;
     
+    // The cross section at the grid point i, zero out of the points
+    double at(long i) const {
+        long k = i - startIndex;
+        return (k >= 0 && k < (long)sigmas.size()) ? sigmas[k] : 0.;
+    }
+    
+    // The cross section at a located energy
+    double evaluate(const CFSGridIndex& index) const {
+        double y1 = at(index.i);
+        return y1 + index.r*(at(index.i + 1) - y1);
+    }
+    
 };
 
 // Angular distribution, the angular distribution is
@@ -166,7 +277,9 @@ struct CFSAngularDist {
     bool isIsotropic() const;
     
     // Load the ENDF version of angular distribution
-    bool loadENDF(const ENDFNeutronData::AngularDist&);
+    // The Legendre distributions of the incident energies are converted
+    // to tabular form on nthreads threads (<= 0 uses all hardware threads)
+    bool loadENDF(const ENDFNeutronData::AngularDist&, long nthreads = 1);
     
     // Load the ACE version of angular distribution
     bool loadACE(const ACEAngularDist&);
@@ -479,6 +592,9 @@ struct CFSReaction {
     // Keep an original ENDF background cross section
     ENDFInterpolationFunction bgXsec;
     
+    // Cross section on the energy grid of the material
+    CFSXsec xsec;
+    
     // Interfaces of a reaction
     CFSReaction(long _MT = 0) :MT(_MT) {}
     
@@ -1471,6 +1587,10 @@ struct CFSNeutronData {
         }
     }
     
+    // The reaction of number MT, shared by the overloads of
+    // getReactionByNumber
+    CFSReaction* findReactionByNumber(long MT) const;
+    
     // Perform action on neutron production reactions
     // The action will be applied on all existing
     // neutron production reactions
@@ -1487,6 +1607,7 @@ struct CFSNeutronData {
     // Get the reaction pointer given rxn number
     // If reaction number not valid or rxn not exist, return nullptr
     const CFSReaction* getReactionByNumber(long MT) const;
+    CFSReaction* getReactionByNumber(long MT);
     
     
     
@@ -1494,9 +1615,35 @@ struct CFSNeutronData {
     
     
     // Universal energy grid, along with key cross sections
+    // The reactions keep their cross sections on it in CFSReaction::xsec
     CFSEnergyGrid energyGrid;
     
+    // Build the energy grid by linearizing the background cross sections
+    // of all reactions jointly, see LS::linearize, and adding the points
+    // and cross sections of the resolved resonances of ndata at 0K, see
+    // XRS::processResolvedResonance. Called by the ENDF constructor.
+    // Returns false on failure
+    bool buildEnergyGrid(const ENDFNeutronData* ndata, long nthreads = 1);
+    
+    // Build the energy grid from the ESZ grid of the ACE data, with the
+    // reaction cross sections on their original indices. Called by the
+    // ACE constructor. Returns false on failure
+    bool buildEnergyGrid(const ACENeutronData* ndata);
     
+    // Locate an energy on the energy grid, energies out of the grid take
+    // the end points. The index can be shared by all reactions
+    CFSGridIndex locateEnergy(double energyEv) const;
+    
+    // Locate an energy from the interval of the cursor, for successive
+    // energies close to each other, see ENDFCursor
+    CFSGridIndex locateEnergy(double energyEv, ENDFCursor& cursor) const;
+    
+    // The main cross sections at a located energy
+    CFSMainRxnDataPoint getMainXsecs(const CFSGridIndex& index) const;
+    
+    // The cross section of reaction MT at a located energy, zero if the
+    // reaction does not exist
+    double getXsec(long MT, const CFSGridIndex& index) const;
     
     // Clear the allocated memory
     void clear();
@@ -1522,6 +1669,24 @@ struct CFSNeutronData {
     // Ontain the fission neutron yield at given energy
     double getYield(double energyEv) const;
     
+    // Temperature fits of the total, elastic, disappear and fission
+    // cross sections, in this column order, nullptr if not fitted
+    DBSTemperatureFit *temperatureFit = nullptr;
+    
+    // Fit the main cross sections of the energy grid, the backgrounds
+    // with the resolved resonances, broadened from tempK to temperatures
+    // in [tempMinK, tempMaxK], see DBS::fitTemperature. Returns false on
+    // failure
+    bool fitTemperature
+    (double tempMinK, double tempMaxK, long nterms = 7, long nthreads = 1);
+    
+    // Obtain the main cross sections at given energy and temperature
+    // within the fitted range, from the temperature fits
+    double getTotal(double energyEv, double tempK) const;
+    double getElastic(double energyEv, double tempK) const;
+    double getDisappear(double energyEv, double tempK) const;
+    double getFission(double energyEv, double tempK) const;
+    
     // Sample particle energy from fission
     template<typename RNG>
     double sampleFission(RNG& e) const {
@@ -18,17 +18,28 @@
 #include "DBS.hpp"
 #include "CMS.hpp"
 #include "ENDF.hpp"
+#include "LS.hpp"
+#include "PRS.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <exception>
+#include <limits>
 #include <vector>
 
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
 // Define constants
 static const double sqrtPiInv = 1.0/sqrt(M_PI);
 
 static double exponentialThreshold = 4.0;
 
+// Number of energy points handed to a thread at once
+static const long sigma1ChunkSize = 64;
+
 struct FFunc {
     double zero  = 0.;
     double one   = 0.;
@@ -62,8 +73,728 @@ inline static FFunc CalculateF(double a) {
     return f;
 }
 
-void DBS::proceedWithSigma1
-(ENDFInterpolationFunction& xsec, double AWR, double tempK) {
+/* Vectorized F function kernel */
+
+// The F functions are evaluated in batches for the vectorized kernel.
+// erfc is written in the form of the erfcc routine of Numerical Recipes,
+//   erfc(z) = t*Q(u)*exp(-z*z), t = 2/(2 + z), u = (2 - z)/(2 + z),
+// for z >= 0, and erfc(-z) = 2 - erfc(z). Q is a Chebyshev series of
+// degree 26 in u, fitted to erfc(z)*exp(z*z)/t in extended precision.
+// It covers the whole range 0 <= z < infinity, and exp(-z*z) is shared
+// with F.one. The relative error of erfc is below 8E-16 for |z| <= 1
+// and 1.5E-15 for |z| <= 4, beyond it grows with the rounding of z*z
+// (7.5E-15 at |z| = 10), as for the library functions. The degree 9
+// fit of Numerical Recipes (relative error 1.2E-7) is not accurate
+// enough, the error is amplified by the cancellation between the two
+// Sigma1 terms at low energies.
+// exp is reduced to exp(r)*2^n with |r| <= ln2/2 and a degree 13 Taylor
+// polynomial, the relative error is below 2E-16 for arguments in
+// [-708, 0]; smaller arguments are clamped to -708.
+
+// Lanes of the widest vector unit enabled at compile time
+#if defined(__AVX512F__)
+static const long sigma1VectorWidth = 8;
+#elif defined(__AVX2__) && defined(__FMA__)
+static const long sigma1VectorWidth = 4;
+#else
+static const long sigma1VectorWidth = 1;
+#endif
+
+// Constants of the exp reduction
+static const double expLog2e  = 1.4426950408889634;
+static const double expLn2Hi  = 6.93145751953125E-1;
+static const double expLn2Lo  = 1.42860682030941723212E-6;
+static const double expMinArg = -708.;
+
+// Taylor coefficients of exp(r), from 1/13! down to 1/0!
+static const long   expOrder = 14;
+static const double expCoeffs[expOrder] = {
+    1.6059043836821613E-10, 2.08767569878681E-9,
+    2.505210838544172E-8,   2.755731922398589E-7,
+    2.7557319223985893E-6,  2.48015873015873E-5,
+    1.984126984126984E-4,   1.388888888888889E-3,
+    8.333333333333333E-3,   4.1666666666666664E-2,
+    1.6666666666666666E-1,  0.5,
+    1.0,                    1.0
+};
+
+// Chebyshev coefficients of Q(u), from T26 down to T0
+static const long   erfcOrder = 27;
+static const double erfcCoeffs[erfcOrder] = {
+    3.50603877527499996E-17, -6.25262781004179424E-17,
+   -2.28440833054064281E-16,  1.57315420004257532E-15,
+   -2.35871401349421056E-15, -1.28951533560342155E-14,
+    7.41876929580811163E-14, -6.14566132720618478E-14,
+   -8.58641338978842657E-13,  3.57149204687542271E-12,
+    2.06121512183408036E-12, -6.16039021834984714E-11,
+    1.43208228135591429E-10,  6.34705827227528685E-10,
+   -4.15472163090515223E-09, -1.29628468460982078E-09,
+    8.23460882729976677E-08, -1.42976081809986089E-07,
+   -1.51546655531918917E-06,  5.44244164550711463E-06,
+    3.27803157417296183E-05, -1.60758299153779679E-04,
+   -1.11284474335263271E-03,  3.67114239583663833E-03,
+    6.50951588287865264E-02,  3.55436921270498485E-01,
+    5.77033738616469690E-01
+};
+
+// F functions evaluated at a batch of arguments, structure of arrays
+struct FFuncArray {
+    std::vector<double> a;
+    std::vector<double> zero;
+    std::vector<double> one;
+    std::vector<double> two;
+    std::vector<double> three;
+    std::vector<double> four;
+    
+    void resize(long n) {
+        if ((long)a.size() < n) {
+            a.resize(n);
+            zero.resize(n);
+            one.resize(n);
+            two.resize(n);
+            three.resize(n);
+            four.resize(n);
+        }
+    }
+};
+
+// Evaluate F for the arguments [begin, end) one by one
+inline static void CalculateFLanes(FFuncArray& f, long begin, long end) {
+    for (long n=begin; n<end; n++) {
+        auto F     = CalculateF(f.a[n]);
+        f.zero[n]  = F.zero;
+        f.one[n]   = F.one;
+        f.two[n]   = F.two;
+        f.three[n] = F.three;
+        f.four[n]  = F.four;
+    }
+}
+
+#if defined(__AVX512F__)
+
+inline static __m512d Sigma1FastExp8(__m512d x) {
+    x = _mm512_max_pd(x, _mm512_set1_pd(expMinArg));
+    __m512d n = _mm512_roundscale_pd
+    (_mm512_mul_pd(x, _mm512_set1_pd(expLog2e)),
+     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(expLn2Hi), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(expLn2Lo), r);
+    __m512d p = _mm512_set1_pd(expCoeffs[0]);
+    for (long c=1; c<expOrder; c++) {
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(expCoeffs[c]));
+    }
+    // Adding 1.5*2^52 leaves n in the low mantissa bits, the high
+    // bits are shifted out when moved into the exponent field
+    __m512i bits = _mm512_castpd_si512
+    (_mm512_add_pd(n, _mm512_set1_pd(6755399441055744.0)));
+    bits = _mm512_slli_epi64
+    (_mm512_add_epi64(bits, _mm512_set1_epi64(1023)), 52);
+    return _mm512_mul_pd(p, _mm512_castsi512_pd(bits));
+}
+
+inline static void CalculateF8(FFuncArray& f, long n) {
+    __m512d a   = _mm512_loadu_pd(&f.a[n]);
+    __m512d one = _mm512_set1_pd(1.);
+    __m512d two = _mm512_set1_pd(2.);
+    __m512d aSq = _mm512_mul_pd(a, a);
+    __m512d e   = Sigma1FastExp8(_mm512_sub_pd(_mm512_setzero_pd(), aSq));
+    
+    // Clenshaw recurrence of Q
+    __m512d z   = _mm512_abs_pd(a);
+    __m512d t   = _mm512_div_pd(two, _mm512_add_pd(two, z));
+    __m512d u2  = _mm512_mul_pd(two, _mm512_fmsub_pd(two, t, one));
+    __m512d b1  = _mm512_setzero_pd();
+    __m512d b2  = _mm512_setzero_pd();
+    for (long c=0; c<erfcOrder-1; c++) {
+        __m512d b0 = _mm512_sub_pd
+        (_mm512_fmadd_pd(u2, b1, _mm512_set1_pd(erfcCoeffs[c])), b2);
+        b2 = b1;
+        b1 = b0;
+    }
+    __m512d q   = _mm512_sub_pd
+    (_mm512_fmadd_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), u2), b1,
+                     _mm512_set1_pd(erfcCoeffs[erfcOrder-1])), b2);
+    
+    __m512d v   = _mm512_mul_pd(_mm512_mul_pd(t, q), e);
+    __mmask8 neg = _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_LT_OQ);
+    v = _mm512_mask_sub_pd(v, neg, two, v);
+    
+    __m512d f0  = _mm512_mul_pd(_mm512_set1_pd(0.5), v);
+    __m512d f1  = _mm512_mul_pd(_mm512_set1_pd(0.5*sqrtPiInv), e);
+    _mm512_storeu_pd(&f.zero[n], f0);
+    _mm512_storeu_pd(&f.one[n], f1);
+    _mm512_storeu_pd
+    (&f.two[n], _mm512_fmadd_pd(a, f1, _mm512_mul_pd(_mm512_set1_pd(0.5), f0)));
+    _mm512_storeu_pd(&f.three[n], _mm512_mul_pd(f1, _mm512_add_pd(one, aSq)));
+    _mm512_storeu_pd
+    (&f.four[n], _mm512_fmadd_pd
+     (_mm512_mul_pd(f1, a), _mm512_add_pd(_mm512_set1_pd(1.5), aSq),
+      _mm512_mul_pd(_mm512_set1_pd(0.75), f0)));
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+inline static __m256d Sigma1FastExp4(__m256d x) {
+    x = _mm256_max_pd(x, _mm256_set1_pd(expMinArg));
+    __m256d n = _mm256_round_pd
+    (_mm256_mul_pd(x, _mm256_set1_pd(expLog2e)),
+     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(expLn2Hi), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(expLn2Lo), r);
+    __m256d p = _mm256_set1_pd(expCoeffs[0]);
+    for (long c=1; c<expOrder; c++) {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(expCoeffs[c]));
+    }
+    // Adding 1.5*2^52 leaves n in the low mantissa bits, the high
+    // bits are shifted out when moved into the exponent field
+    __m256i bits = _mm256_castpd_si256
+    (_mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0)));
+    bits = _mm256_slli_epi64
+    (_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+
+inline static void CalculateF4(FFuncArray& f, long n) {
+    __m256d a   = _mm256_loadu_pd(&f.a[n]);
+    __m256d one = _mm256_set1_pd(1.);
+    __m256d two = _mm256_set1_pd(2.);
+    __m256d aSq = _mm256_mul_pd(a, a);
+    __m256d e   = Sigma1FastExp4(_mm256_sub_pd(_mm256_setzero_pd(), aSq));
+    
+    // Clenshaw recurrence of Q
+    __m256d z   = _mm256_andnot_pd(_mm256_set1_pd(-0.), a);
+    __m256d t   = _mm256_div_pd(two, _mm256_add_pd(two, z));
+    __m256d u2  = _mm256_mul_pd(two, _mm256_fmsub_pd(two, t, one));
+    __m256d b1  = _mm256_setzero_pd();
+    __m256d b2  = _mm256_setzero_pd();
+    for (long c=0; c<erfcOrder-1; c++) {
+        __m256d b0 = _mm256_sub_pd
+        (_mm256_fmadd_pd(u2, b1, _mm256_set1_pd(erfcCoeffs[c])), b2);
+        b2 = b1;
+        b1 = b0;
+    }
+    __m256d q   = _mm256_sub_pd
+    (_mm256_fmadd_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), u2), b1,
+                     _mm256_set1_pd(erfcCoeffs[erfcOrder-1])), b2);
+    
+    __m256d v   = _mm256_mul_pd(_mm256_mul_pd(t, q), e);
+    __m256d neg = _mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_LT_OQ);
+    v = _mm256_blendv_pd(v, _mm256_sub_pd(two, v), neg);
+    
+    __m256d f0  = _mm256_mul_pd(_mm256_set1_pd(0.5), v);
+    __m256d f1  = _mm256_mul_pd(_mm256_set1_pd(0.5*sqrtPiInv), e);
+    _mm256_storeu_pd(&f.zero[n], f0);
+    _mm256_storeu_pd(&f.one[n], f1);
+    _mm256_storeu_pd
+    (&f.two[n], _mm256_fmadd_pd(a, f1, _mm256_mul_pd(_mm256_set1_pd(0.5), f0)));
+    _mm256_storeu_pd(&f.three[n], _mm256_mul_pd(f1, _mm256_add_pd(one, aSq)));
+    _mm256_storeu_pd
+    (&f.four[n], _mm256_fmadd_pd
+     (_mm256_mul_pd(f1, a), _mm256_add_pd(_mm256_set1_pd(1.5), aSq),
+      _mm256_mul_pd(_mm256_set1_pd(0.75), f0)));
+}
+
+#endif
+
+// Evaluate F for the first n arguments in f.a, the arguments left over
+// by the vector unit use the library functions
+inline static void CalculateFArray(FFuncArray& f, long n) {
+    long m = 0;
+#if defined(__AVX512F__)
+    for (; m+sigma1VectorWidth<=n; m+=sigma1VectorWidth) {
+        CalculateF8(f, m);
+    }
+#elif defined(__AVX2__) && defined(__FMA__)
+    for (; m+sigma1VectorWidth<=n; m+=sigma1VectorWidth) {
+        CalculateF4(f, m);
+    }
+#endif
+    CalculateFLanes(f, m, n);
+}
+
+// Sum the interval contributions Ak*A + Bk*B over the intervals between
+// the nodes [begin, end] of f, where sigma = A + B*x^2 on the interval.
+// A and B start at the interval of node begin. The terms are summed four
+// at a time to break the dependency chain of the accumulation
+inline static double Sigma1SumIntervals
+(const FFuncArray& f, long begin, long end,
+ const double* A, const double* B, double y) {
+    
+    double ySq    = y*y;
+    double yInv   = 1./y;
+    double yInvSq = yInv*yInv;
+    
+    // The contribution of the interval k
+    auto term = [&] (long k) -> double {
+        long n = begin + k;
+        
+        // H function, F at the lower minus F at the upper node
+        double H0 = f.zero[n]  - f.zero[n+1];
+        double H1 = f.one[n]   - f.one[n+1];
+        double H2 = f.two[n]   - f.two[n+1];
+        double H3 = f.three[n] - f.three[n+1];
+        double H4 = f.four[n]  - f.four[n+1];
+        
+        double Ak = yInvSq*H2 + 2.0*yInv*H1 + H0;
+        double Bk = yInvSq*H4 + 4.0*yInv*H3 + 6.0*H2 +
+                    4.0*y*H1 + ySq*H0;
+        
+        return Ak*A[k] + Bk*B[k];
+    };
+    
+    double s[4] = {0., 0., 0., 0.};
+    long   nk   = end - begin;
+    long   k    = 0;
+    
+    for (; k+4<=nk; k+=4) {
+        s[0] += term(k);
+        s[1] += term(k+1);
+        s[2] += term(k+2);
+        s[3] += term(k+3);
+    }
+    for (; k<nk; k++) {
+        s[k%4] += term(k);
+    }
+    
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+// The nodes of the exponential window around an energy point, and
+// their positions in the F function workspace
+struct Sigma1Window {
+    // First term nodes jmin..jmax, with the extensions to 0 and infinity
+    long jmin       = 0;
+    long jmax       = 0;
+    bool lowExtend  = false;
+    bool highExtend = false;
+    
+    // Second term nodes 0..kmax, evaluated only for y below threshold
+    bool second     = false;
+    long kmax       = 0;
+    
+    // Layout in the workspace: extension to 0 at 0, first term below y
+    // from l0, first term above y from r0, extension to 0 and second
+    // term from s0
+    long l0 = 0, nl = 0;
+    long r0 = 0, nr = 0;
+    long s0 = 0, ns = 0;
+};
+
+// Locate the window of the energy point i, and evaluate the F functions
+// of all its nodes at once in the workspace f
+static Sigma1Window Sigma1PrepareWindow
+(const std::vector<double>& xvec, long i, FFuncArray& f) {
+    
+    long N = xvec.size();
+    const double* x = xvec.data();
+    double y = xvec[i];
+    
+    Sigma1Window w;
+    
+    // The lowest node of the first term below y, the intervals are
+    // taken as long as their upper node is within the threshold
+    w.jmin = i;
+    while (w.jmin > 0 && x[w.jmin] - y >= -exponentialThreshold) {
+        w.jmin--;
+    }
+    w.lowExtend = (w.jmin == 0 && x[0] - y >= -exponentialThreshold);
+    
+    // The highest node of the first term above y, the intervals are
+    // taken as long as their lower node is within the threshold
+    w.jmax = i;
+    while (w.jmax < N-1 && x[w.jmax] - y <= exponentialThreshold) {
+        w.jmax++;
+    }
+    w.highExtend = (w.jmax == N-1 && x[N-1] - y <= exponentialThreshold);
+    
+    // The highest node of the second term
+    w.second = (y < exponentialThreshold);
+    if (w.second) {
+        while (w.kmax < N-1 && x[w.kmax] + y <= exponentialThreshold) {
+            w.kmax++;
+        }
+    }
+    
+    w.nl = i - w.jmin + 1;
+    w.nr = w.jmax - i + 1;
+    w.ns = w.second ? w.kmax + 2 : 0;
+    w.l0 = 1;
+    w.r0 = w.l0 + w.nl;
+    w.s0 = w.r0 + w.nr;
+    f.resize(w.s0 + w.ns);
+    
+    f.a[0] = -y;
+    for (long n=0; n<w.nl; n++) {
+        f.a[w.l0+n] = x[w.jmin+n] - y;
+    }
+    for (long n=0; n<w.nr; n++) {
+        f.a[w.r0+n] = x[i+n] - y;
+    }
+    if (w.second) {
+        f.a[w.s0] = y;
+        for (long n=0; n<=w.kmax; n++) {
+            f.a[w.s0+1+n] = x[n] + y;
+        }
+    }
+    
+    CalculateFArray(f, w.s0 + w.ns);
+    
+    return w;
+}
+
+// Broaden the cross section at the energy point i with the vectorized
+// kernel. A and B hold sigma = A + B*x^2 of the intervals of the grid
+static double Sigma1BroadenPointVector
+(const std::vector<double>& xvec, const std::vector<double>& xsvec,
+ const std::vector<double>& A, const std::vector<double>& B, long i,
+ FFuncArray& f) {
+    
+    long N = xvec.size();
+    
+    const double* x  = xvec.data();
+    const double* xs = xsvec.data();
+    
+    double y      = xvec[i];
+    double yInv   = 1./y;
+    double yInvSq = yInv*yInv;
+    
+    auto w = Sigma1PrepareWindow(xvec, i, f);
+    
+    // Evaluate first term from x[k] - y = 0 to - (exponential thres.)
+    double sigma = Sigma1SumIntervals
+    (f, w.l0, w.l0+w.nl-1, A.data()+w.jmin, B.data()+w.jmin, y);
+    
+    // Extend cross section to 0 assuming 1/v
+    if (w.lowExtend) {
+        double H0 = f.zero[0] - f.zero[w.l0];
+        double H1 = f.one[0]  - f.one[w.l0];
+        sigma += xs[0]*x[0]*(yInvSq*H1 + yInv*H0);
+    }
+    
+    // Evaluate first term from x[k] - y = 0 to (exponential thres.)
+    sigma += Sigma1SumIntervals
+    (f, w.r0, w.r0+w.nr-1, A.data()+i, B.data()+i, y);
+    
+    // Extend cross section to infinity assuming constant shape
+    if (w.highExtend) {
+        long n = w.r0 + w.nr - 1;
+        sigma += xs[N-1]*(yInvSq*f.two[n] + 2.0*yInv*f.one[n] + f.zero[n]);
+    }
+    
+    // Evaluate second term from 0 to (exponential thres.)
+    if (w.second) {
+        // Extend cross section to 0 assuming 1/v
+        double H0 = f.zero[w.s0] - f.zero[w.s0+1];
+        double H1 = f.one[w.s0]  - f.one[w.s0+1];
+        sigma += - xs[0]*x[0]*(yInvSq*H1 - yInv*H0);
+        
+        // The summed terms in the second integrals, with y -> -y
+        sigma -= Sigma1SumIntervals
+        (f, w.s0+1, w.s0+1+w.kmax, A.data(), B.data(), -y);
+        
+        // Extend cross section to infinity assuming constant shape
+        if (w.kmax == N-1 && x[N-1] + y <= exponentialThreshold) {
+            long n = w.s0 + 1 + w.kmax;
+            sigma -= xs[N-1]*(yInvSq*f.two[n] - 2.0*yInv*f.one[n] + f.zero[n]);
+        }
+    }
+    
+    return sigma;
+}
+
+// The broadened cross section at an energy point is linear in the cold
+// cross sections, sigma = sum of first[j-jmin]*xs[j] over jmin..jmax
+// plus sum of second[j]*xs[j] over 0..kmax
+struct Sigma1Weights {
+    long jmin = 0;
+    long kmax = -1;
+    std::vector<double> first;
+    std::vector<double> second;
+};
+
+// Sum of w[j]*xs[j], four at a time to break the dependency chain
+inline static double Sigma1Dot(const std::vector<double>& w, const double* xs) {
+    double s[4] = {0., 0., 0., 0.};
+    long   n    = w.size();
+    long   j    = 0;
+    for (; j+4<=n; j+=4) {
+        s[0] += w[j]*xs[j];
+        s[1] += w[j+1]*xs[j+1];
+        s[2] += w[j+2]*xs[j+2];
+        s[3] += w[j+3]*xs[j+3];
+    }
+    for (; j<n; j++) {
+        s[j%4] += w[j]*xs[j];
+    }
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+// Add the weights of the intervals between the nodes [begin, end] of f
+// to w, x and dInv (1/(x[k+1]^2 - x[k]^2)) start at the interval of node
+// begin, and so does w
+inline static void Sigma1AddIntervalWeights
+(const FFuncArray& f, long begin, long end, const double* x,
+ const double* dInv, double y, double sign, double* w) {
+    
+    double ySq    = y*y;
+    double yInv   = 1./y;
+    double yInvSq = yInv*yInv;
+    
+    for (long k=0; k<end-begin; k++) {
+        long n = begin + k;
+        
+        // H function, F at the lower minus F at the upper node
+        double H0 = f.zero[n]  - f.zero[n+1];
+        double H1 = f.one[n]   - f.one[n+1];
+        double H2 = f.two[n]   - f.two[n+1];
+        double H3 = f.three[n] - f.three[n+1];
+        double H4 = f.four[n]  - f.four[n+1];
+        
+        double Ak = yInvSq*H2 + 2.0*yInv*H1 + H0;
+        double Bk = yInvSq*H4 + 4.0*yInv*H3 + 6.0*H2 +
+                    4.0*y*H1 + ySq*H0;
+        
+        // Ak*A + Bk*B with A and B written in the cross sections at
+        // the ends of the interval
+        w[k]   += sign*(Ak*x[k+1]*x[k+1] - Bk)*dInv[k];
+        w[k+1] += sign*(Bk - Ak*x[k]*x[k])*dInv[k];
+    }
+}
+
+// Weights of the cold cross sections in the broadened one at point i
+static void Sigma1PointWeights
+(const std::vector<double>& xvec, const std::vector<double>& dInv, long i,
+ FFuncArray& f, Sigma1Weights& wt) {
+    
+    long N = xvec.size();
+    const double* x = xvec.data();
+    
+    double y      = xvec[i];
+    double yInv   = 1./y;
+    double yInvSq = yInv*yInv;
+    
+    auto w = Sigma1PrepareWindow(xvec, i, f);
+    
+    wt.jmin = w.jmin;
+    wt.kmax = w.second ? w.kmax : -1;
+    wt.first.assign(w.jmax - w.jmin + 1, 0.);
+    wt.second.assign(wt.kmax + 1, 0.);
+    
+    // First term below and above y
+    Sigma1AddIntervalWeights
+    (f, w.l0, w.l0+w.nl-1, x+w.jmin, dInv.data()+w.jmin, y, 1.,
+     wt.first.data());
+    Sigma1AddIntervalWeights
+    (f, w.r0, w.r0+w.nr-1, x+i, dInv.data()+i, y, 1.,
+     wt.first.data()+(i-w.jmin));
+    
+    // Extend cross section to 0 assuming 1/v
+    if (w.lowExtend) {
+        double H0 = f.zero[0] - f.zero[w.l0];
+        double H1 = f.one[0]  - f.one[w.l0];
+        wt.first[0] += x[0]*(yInvSq*H1 + yInv*H0);
+    }
+    
+    // Extend cross section to infinity assuming constant shape
+    if (w.highExtend) {
+        long n = w.r0 + w.nr - 1;
+        wt.first[N-1-w.jmin] += yInvSq*f.two[n] + 2.0*yInv*f.one[n] + f.zero[n];
+    }
+    
+    if (w.second) {
+        // Extend cross section to 0 assuming 1/v
+        double H0 = f.zero[w.s0] - f.zero[w.s0+1];
+        double H1 = f.one[w.s0]  - f.one[w.s0+1];
+        wt.second[0] += - x[0]*(yInvSq*H1 - yInv*H0);
+        
+        // The second term, with y -> -y
+        Sigma1AddIntervalWeights
+        (f, w.s0+1, w.s0+1+w.kmax, x, dInv.data(), -y, -1.,
+         wt.second.data());
+        
+        // Extend cross section to infinity assuming constant shape
+        if (w.kmax == N-1 && x[N-1] + y <= exponentialThreshold) {
+            long n = w.s0 + 1 + w.kmax;
+            wt.second[N-1] -=
+            yInvSq*f.two[n] - 2.0*yInv*f.one[n] + f.zero[n];
+        }
+    }
+}
+
+// Broaden the cross section at the energy point i with the scalar kernel
+// xvec holds the sqrt(M/kT*E) values of the grid, and
+// xsvec the cold cross sections on the grid
+static double Sigma1BroadenPoint
+(const std::vector<double>& xvec, const std::vector<double>& xsvec, long i) {
+    
+    long N = xvec.size();
+    
+    // Doppler broadened cross section
+    double sigma = 0.;
+    
+    // The y value, and related constants
+    double y      = xvec[i];
+    double ySq    = y*y;
+    double yInv   = 1./y;
+    double yInvSq = yInv/y;
+    
+    // Perform calculations
+    
+    // Evaluate first term from x[k] - y = 0 to - (exponential thres.)
+    {
+    long   k  = i;
+    double a  = 0.;
+    auto   Fa = CalculateF(a);
+    
+    for (; k>0; k--) {
+        
+        // Check evaluate limits
+        if (a < -exponentialThreshold) break;
+        
+        // The point next
+        auto Fb = Fa;
+        a       = xvec[k-1] - y;
+        
+        // Calculate F function and H function
+        Fa      = CalculateF(a);
+        auto H  = Fa - Fb;
+        
+        // Calcuate Ak, Bk and slope terms
+        auto Ak = yInvSq*H.two  + 2.0*yInv*H.one   + H.zero;
+        auto Bk = yInvSq*H.four + 4.0*yInv*H.three + 6.0*H.two +
+                  4.0*y*H.one + ySq*H.zero;
+        auto slope = (xsvec[k] - xsvec[k-1]) /
+        (xvec[k]*xvec[k] - xvec[k-1]*xvec[k-1]);
+        
+        // Add contribution to broadened cross section
+        sigma += Ak*(xsvec[k-1] - slope*xvec[k-1]*xvec[k-1]) + slope*Bk;
+        
+    }
+    
+    // Extend cross section to 0 assuming 1/v
+    if (k == 0 && a >= -exponentialThreshold) {
+        
+        // Extended point
+        auto Fb = Fa;
+        a       = -y;
+        
+        // Calculate F and H function
+        Fa      = CalculateF(a);
+        auto H  = Fa - Fb;
+        
+        // Add constribution to broadened cross section
+        sigma += xsvec[0]*xvec[0]*(yInvSq*H.one + yInv*H.zero);
+        
+    }
+    }
+    
+    // Evaluate first term from x[k] - y = 0 to (exponential thres.)
+    {
+    long   k  = i;
+    double b  = 0.;
+    auto   Fb = CalculateF(b);
+    
+    for (; k<N-1; k++) {
+        
+        // Check evaluate limits
+        if (b > exponentialThreshold) break;
+        
+        // The point next
+        auto Fa = Fb;
+        b       = xvec[k+1] - y;
+        
+        // Calculate F and H functions
+        Fb      = CalculateF(b);
+        auto H  = Fa - Fb;
+        
+        // Calculate Ak, Bk and slope terms
+        auto Ak = yInvSq*H.two  + 2.0*yInv*H.one   + H.zero;
+        auto Bk = yInvSq*H.four + 4.0*yInv*H.three + 6.0*H.two +
+                  4.0*y*H.one + ySq*H.zero;
+        auto slope = (xsvec[k+1] - xsvec[k]) /
+        (xvec[k+1]*xvec[k+1] - xvec[k]*xvec[k]);
+        
+        // Add contribution to the broadedn cross section
+        sigma += Ak*(xsvec[k+1] - slope*xvec[k+1]*xvec[k+1]) + slope*Bk;
+        
+    }
+    
+    // Extend cross section to infinity assuming constant shape
+    if (k == N-1 && b <= exponentialThreshold) {
+        
+        // Calculate F function at last energy point
+        auto a  = xvec[N-1] - y;
+        auto Fa = CalculateF(a);
+        
+        // Add contribution to broadened cross section
+        sigma += xsvec[N-1]*(yInvSq*Fa.two + 2.0*yInv*Fa.one + Fa.zero);
+        
+    }
+    }
+    
+    // Evaluate second term from 0 to (exponential thres.)
+    // Check whether y already exceeds the exponential limit
+    if (y >= exponentialThreshold) {
+        return sigma;
+    }
+    
+    // Change sign of y and yinv
+    y       = -y;
+    yInv    = - yInv;
+    
+    // Extend cross section to 0 assuming 1/v
+    auto b  = xvec[0] - y;
+    auto Fb = CalculateF(b);
+    
+    {
+        // Calculate F and H functions
+        auto a  = -y;
+        auto Fa = CalculateF(a);
+        auto H  = Fa - Fb;
+        
+        // Add contribution to broadened cross section
+        sigma += - xsvec[0]*xvec[0]*(yInvSq*H.one + yInv*H.zero);
+    }
+    
+    // The summed terms in the second integrals
+    for (long k=0; k<N-1; k++) {
+        
+        // Check evaluate limits
+        if (b > exponentialThreshold) break;
+        
+        // The point next
+        auto Fa = Fb;
+        b       = xvec[k+1] - y;
+        
+        // Calculate the F and H function
+        Fb      = CalculateF(b);
+        auto H  = Fa - Fb;
+        
+        // Calculate Ak, Bk and slope terms
+        auto Ak = yInvSq*H.two  + 2.0*yInv*H.one   + H.zero;
+        auto Bk = yInvSq*H.four + 4.0*yInv*H.three + 6.0*H.two +
+                  4.0*y*H.one + ySq*H.zero;
+        auto slope = (xsvec[k+1] - xsvec[k]) /
+        (xvec[k+1]*xvec[k+1] - xvec[k]*xvec[k]);
+        
+        // Add contribution to broadened cross section
+        sigma -= Ak*(xsvec[k+1] - slope*xvec[k+1]*xvec[k+1]) + slope*Bk;
+        
+    }
+    
+    // Extend cross section to infinity assuming constant shape
+    if (b <= exponentialThreshold) {
+        sigma -= xsvec[N-1]*(yInvSq*Fb.two + 2.0*yInv*Fb.one + Fb.zero);
+    }
+    
+    return sigma;
+}
+
+// Broaden the points of the linear cross section up to cutoffEv,
+// returns the number of broadened points
+static long Sigma1Broaden
+(ENDFInterpolationFunction& xsec, double AWR, double tempK, long nthreads,
+ DBSSigma1Kernel kernel, double cutoffEv) {
     
     if (!xsec.isLinear()) {
         throw std::logic_error("xsec func is not linear!");
@@ -79,17 +810,24 @@ void DBS::proceedWithSigma1
     
     // Do nothing for zero temperature difference
     if (tempK == 0.) {
-        return;
+        return 0;
     }
     
     // Do nothing for empty cross section points
     long N = xsec.data().size();
     if (N == 0) {
-        return;
+        return 0;
     }
     
-    // Define the sqrt(M/mkT) parameter
-    double factor = sqrt(AWR / CMS::BoltzmannEvK / tempK);
+    // The points up to the cutoff energy
+    long Nb = std::upper_bound
+    (xsec.data().begin(), xsec.data().end(), cutoffEv,
+     [](double e, const ENDFDataPoint& dp) -> bool {
+         return e < dp.x;
+     }) - xsec.data().begin();
+    
+    // Define the M/mkT parameter
+    double factor = AWR / CMS::BoltzmannEvK / tempK;
     
     // Construct "cold" x values, and cross section
     std::vector<double> xvec(N, 0.), xsvec(N, 0.);
@@ -104,161 +842,295 @@ void DBS::proceedWithSigma1
          return dp.y;
      });
     
-    // Loop over all energy point
-    for (long i=0; i<N; i++) {
-        
-        // Doppler broadened cross section
-        double sigma = 0.;
-        
-        // The y value, and related constants
-        double y      = xvec[i];
-        double ySq    = y*y;
-        double yInv   = 1./y;
-        double yInvSq = yInv/y;
-        
-        // Perform calculations
-        
-        // Evaluate first term from x[k] - y = 0 to - (exponential thres.)
-        {
-        long   k  = i;
-        double a  = 0.;
-        auto   Fa = CalculateF(a);
-        
-        for (; k>0; k--) {
-            
-            // Check evaluate limits
-            if (a < -exponentialThreshold) break;
-            
-            // The point next
-            auto Fb = Fa;
-            a       = xvec[k-1] - y;
-            
-            // Calculate F function and H function
-            Fa      = CalculateF(a);
-            auto H  = Fa - Fb;
-            
-            // Calcuate Ak, Bk and slope terms
-            auto Ak = yInvSq*H.two  + 2.0*yInv*H.one   + H.zero;
-            auto Bk = yInvSq*H.four + 4.0*yInv*H.three + 6.0*H.two +
-                      4.0*y*H.one + ySq*H.zero;
-            auto slope = (xsvec[k] - xsvec[k-1]) /
-            (xvec[k]*xvec[k] - xvec[k-1]*xvec[k-1]);
-            
-            // Add contribution to broadened cross section
-            sigma += Ak*(xvec[k-1] - slope*xvec[k-1]*xvec[k-1]) + slope*Bk;
-            
-        }
-        
-        // Extend cross section to 0 assuming 1/v
-        if (k == 0 && a >= -exponentialThreshold) {
-            
-            // Extended point
-            auto Fb = Fa;
-            a       = -y;
-            
-            // Calculate F and H function
-            Fa      = CalculateF(a);
-            auto H  = Fa - Fb;
-            
-            // Add constribution to broadened cross section
-            sigma += xsvec[0]*xvec[0]*(yInvSq*H.one + yInv*H.zero);
-            
+    // The cold cross section is sigma = A + B*x^2 on every interval,
+    // the vectorized kernel takes them from a table
+    std::vector<double> A, B;
+    if (kernel == DBSSigma1Kernel::VECTOR) {
+        A.resize(std::max(N-1, 0L));
+        B.resize(std::max(N-1, 0L));
+        for (long k=0; k<N-1; k++) {
+            B[k] = (xsvec[k+1] - xsvec[k]) /
+            (xvec[k+1]*xvec[k+1] - xvec[k]*xvec[k]);
+            A[k] = xsvec[k] - B[k]*xvec[k]*xvec[k];
         }
+    }
+    
+    // Broadened cross sections, every point only reads the cold data,
+    // so the points are distributed over threads in chunks. The work
+    // per point varies with the number of points in the exponential
+    // window, hence the chunks are scheduled dynamically
+    std::vector<double> sigmas(Nb, 0.);
+    PRS::parallelFor(Nb, nthreads, sigma1ChunkSize, [&] (long begin, long end) {
+        if (kernel == DBSSigma1Kernel::SCALAR) {
+            for (long i=begin; i<end; i++) {
+                sigmas[i] = Sigma1BroadenPoint(xvec, xsvec, i);
+            }
+        } else {
+            // F function workspace of this chunk
+            FFuncArray f;
+            for (long i=begin; i<end; i++) {
+                sigmas[i] = Sigma1BroadenPointVector(xvec, xsvec, A, B, i, f);
+            }
         }
-        
-        // Evaluate first term from x[k] - y = 0 to (exponential thres.)
-        {
-        long   k  = i;
-        double b  = 0.;
-        auto   Fb = CalculateF(b);
-        
-        for (; k<N-1; k++) {
-            
-            // Check evaluate limits
-            if (b > exponentialThreshold) break;
-            
-            // The point next
-            auto Fa = Fb;
-            b       = xvec[k+1] - y;
-            
-            // Calculate F and H functions
-            Fb      = CalculateF(b);
-            auto H  = Fa - Fb;
-            
-            // Calculate Ak, Bk and slope terms
-            auto Ak = yInvSq*H.two  + 2.0*yInv*H.one   + H.zero;
-            auto Bk = yInvSq*H.four + 4.0*yInv*H.three + 6.0*H.two +
-                      4.0*y*H.one + ySq*H.zero;
-            auto slope = (xsvec[k+1] - xsvec[k]) /
-            (xvec[k+1]*xvec[k+1] - xvec[k]*xvec[k]);
-            
-            // Add contribution to the broadedn cross section
-            sigma += Ak*(xsvec[k+1] - slope*xvec[k+1]*xvec[k+1]) + slope*Bk;
-            
+    });
+    
+    // Set the broadened cross section
+    for (long i=0; i<Nb; i++) {
+        xsec.data(i).y = sigmas[i];
+    }
+    
+    return Nb;
+}
+
+void DBS::proceedWithSigma1
+(ENDFInterpolationFunction& xsec, double AWR, double tempK, long nthreads,
+ DBSSigma1Kernel kernel) {
+    Sigma1Broaden
+    (xsec, AWR, tempK, nthreads, kernel,
+     std::numeric_limits<double>::infinity());
+}
+
+double DBS::sigma1CutoffEnergy(double AWR, double tempK, double widthRatio) {
+    if (AWR <= 0. || widthRatio <= 0.) {
+        throw std::logic_error("mass ratio and width ratio must be positive!");
+    }
+    // Doppler width sqrt(4*E*kT/A) equals widthRatio*E
+    return 4.0*CMS::BoltzmannEvK*tempK/AWR/(widthRatio*widthRatio);
+}
+
+DBSThinSummary DBS::proceedWithSigma1AndThin
+(ENDFInterpolationFunction& xsec, double AWR, double tempK, double tol,
+ double widthRatio, long nthreads) {
+    
+    DBSThinSummary summary;
+    summary.pointsIn = xsec.data().size();
+    summary.cutoffEv = sigma1CutoffEnergy(AWR, tempK, widthRatio);
+    
+    summary.pointsBroadened = Sigma1Broaden
+    (xsec, AWR, tempK, nthreads, DBSSigma1Kernel::VECTOR, summary.cutoffEv);
+    
+    // Thin the broadened grid
+    auto thinned = LS::thin(xsec, tol, CMS::zeroThres);
+    if (!thinned.valid() && summary.pointsIn > 0) {
+        throw std::logic_error("thinning broadened xsec failed!");
+    }
+    xsec = std::move(thinned);
+    summary.pointsOut = xsec.data().size();
+    
+    return summary;
+}
+
+std::vector<DBSMultiXsec> DBS::proceedWithSigma1
+(const DBSMultiXsec& xsecs, double AWR, const std::vector<double>& tempKs,
+ long nthreads) {
+    
+    // Check inputs
+    if (AWR <= 0.) {
+        throw std::logic_error("mass ratio must be positive!");
+    }
+    for (auto tempK : tempKs) {
+        if (tempK < 0.) {
+            throw std::logic_error
+            ("temperature difference must be non-negative!");
         }
-        
-        // Extend cross section to infinity assuming constant shape
-        if (k == N-1 && b <= exponentialThreshold) {
-            
-            // Calculate F function at last energy point
-            auto a  = xvec[N-1] - y;
-            auto Fa = CalculateF(a);
-            
-            // Add contribution to broadened cross section
-            sigma += xsvec[N-1]*(yInvSq*Fa.two + 2.0*yInv*Fa.one + Fa.zero);
-            
+    }
+    
+    long N = xsecs.energies.size();
+    long C = xsecs.columns.size();
+    for (long c=0; c<C; c++) {
+        if ((long)xsecs.columns[c].size() != N) {
+            throw std::logic_error("xsec column size mismatches energy grid!");
         }
+    }
+    // A repeated energy is a jump
+    for (long i=1; i<N; i++) {
+        if (xsecs.energies[i] < xsecs.energies[i-1]) {
+            throw std::logic_error("energy grid is decreasing!");
         }
-        
-        // Evaluate second term from 0 to (exponential thres.)
-        // Check whether y already exceeds the exponential limit
-        if (y >= exponentialThreshold) {
+    }
+    
+    // The cold cross sections as the initial results
+    long T = tempKs.size();
+    std::vector<DBSMultiXsec> results(T, xsecs);
+    if (N == 0 || C == 0) {
+        return results;
+    }
+    
+    // Define x values and 1/(x[k+1]^2 - x[k]^2) for every temperature,
+    // zero temperature differences are left cold
+    std::vector<std::vector<double> > xvecs(T), dInvs(T);
+    for (long t=0; t<T; t++) {
+        if (tempKs[t] == 0.) {
             continue;
         }
-        
-        // Change sign of y and yinv
-        y       = -y;
-        yInv    = - yInv;
-        
-        // Extend cross section to 0 assuming 1/v
-        auto b  = xvec[0] - y;
-        auto Fb = CalculateF(b);
-        
-        {
-            // Calculate F and H functions
-            auto a  = -y;
-            auto Fa = CalculateF(a);
-            auto H  = Fa - Fb;
-            
-            // Add contribution to broadened cross section
-            sigma += - xsvec[0]*xvec[0]*(yInvSq*H.one + yInv*H.zero);
+        double factor = AWR / CMS::BoltzmannEvK / tempKs[t];
+        xvecs[t].resize(N);
+        dInvs[t].resize(N-1);
+        for (long i=0; i<N; i++) {
+            xvecs[t][i] = sqrt(factor * xsecs.energies[i]);
         }
-        
-        // The summed terms in the second integrals
+        // The interval of a jump has no width and no weight
         for (long k=0; k<N-1; k++) {
-            
-            // The point next
-            auto Fa = Fb;
-            b       = xvec[k+1] - y;
-            
-            // Calculate the F and H function
-            Fb      = CalculateF(b);
-            auto H  = Fa - Fb;
-            
-            // Calculate Ak, Bk and slope terms
-            auto Ak = yInvSq*H.two  + 2.0*yInv*H.one   + H.zero;
-            auto Bk = yInvSq*H.four + 4.0*yInv*H.three + 6.0*H.two +
-                      4.0*y*H.one + ySq*H.zero;
-            auto slope = (xsvec[k+1] - xsvec[k]) /
-            (xvec[k+1]*xvec[k+1] - xvec[k]*xvec[k]);
-            
-            // Add contribution to broadened cross section
-            sigma -= Ak*(xsvec[k+1] - slope*xvec[k+1]*xvec[k+1]) - slope*Bk;
-            
+            double d = xvecs[t][k+1]*xvecs[t][k+1] - xvecs[t][k]*xvecs[t][k];
+            dInvs[t][k] = d > 0. ? 1./d : 0.;
         }
-        
-        // Set the broadened cross section
-        xsec.data(i).y = sigma;
     }
     
-}
\ No newline at end of file
+    // The weights depend only on the grid and temperature, they are
+    // evaluated once per point and temperature and applied to all columns
+    PRS::parallelFor(N, nthreads, sigma1ChunkSize, [&] (long begin, long end) {
+        FFuncArray    f;
+        Sigma1Weights wt;
+        for (long i=begin; i<end; i++) {
+            for (long t=0; t<T; t++) {
+                if (xvecs[t].empty()) {
+                    continue;
+                }
+                Sigma1PointWeights(xvecs[t], dInvs[t], i, f, wt);
+                
+                for (long c=0; c<C; c++) {
+                    const double* xs = xsecs.columns[c].data();
+                    results[t].columns[c][i] =
+                    Sigma1Dot(wt.first, xs + wt.jmin) +
+                    Sigma1Dot(wt.second, xs);
+                }
+            }
+        }
+    });
+    
+    return results;
+}
+
+DBSTemperatureFit DBS::fitTemperature
+(const DBSMultiXsec& cold, double AWR, double coldTempK,
+ double tempMinK, double tempMaxK, long nterms, long nsamples,
+ long nthreads) {
+    
+    const long M = nterms;
+    
+    // Check inputs
+    if (tempMinK <= 0. || tempMinK >= tempMaxK) {
+        throw std::logic_error("invalid temperature range!");
+    }
+    if (coldTempK < 0. || coldTempK > tempMinK) {
+        throw std::logic_error("cold temperature exceeds the range!");
+    }
+    if (M < 1 || nsamples < M) {
+        throw std::logic_error("too few temperature samples!");
+    }
+    
+    // The fit temperatures, evenly spaced in sqrt(T), followed by
+    // the check temperatures halfway between them
+    std::vector<double> temps;
+    double smin = sqrt(tempMinK), smax = sqrt(tempMaxK);
+    for (long s=0; s<nsamples; s++) {
+        double st = smin + (smax - smin)*s/(nsamples - 1);
+        temps.push_back(st*st);
+    }
+    for (long s=0; s<nsamples-1; s++) {
+        double st = smin + (smax - smin)*(s + 0.5)/(nsamples - 1);
+        temps.push_back(st*st);
+    }
+    
+    // Broaden to all temperatures at once
+    std::vector<double> tempDiffs(temps.size());
+    for (long s=0; s<temps.size(); s++) {
+        tempDiffs[s] = std::max(temps[s] - coldTempK, 0.);
+    }
+    auto hot = proceedWithSigma1(cold, AWR, tempDiffs, nthreads);
+    
+    auto basis = [&] (double T, double* b) {
+        double t  = T / tempMaxK;
+        double st = sqrt(t);
+        b[0] = 1./t;
+        for (long k=1; k<M; k++) {
+            b[k] = b[k-1]*st;
+        }
+    };
+    
+    // Least squares by QR of the nsamples x M basis matrix with modified
+    // Gram-Schmidt, the same for all points. P = R^-1 Q^T maps the
+    // sampled cross sections of a point to its coefficients
+    std::vector<double> Q(nsamples*M), R(M*M, 0.), P(M*nsamples, 0.);
+    for (long s=0; s<nsamples; s++) {
+        basis(temps[s], &Q[s*M]);
+    }
+    for (long m=0; m<M; m++) {
+        for (long k=0; k<m; k++) {
+            double d = 0.;
+            for (long s=0; s<nsamples; s++) {
+                d += Q[s*M+k]*Q[s*M+m];
+            }
+            R[k*M+m] = d;
+            for (long s=0; s<nsamples; s++) {
+                Q[s*M+m] -= d*Q[s*M+k];
+            }
+        }
+        double norm = 0.;
+        for (long s=0; s<nsamples; s++) {
+            norm += Q[s*M+m]*Q[s*M+m];
+        }
+        norm = sqrt(norm);
+        if (norm <= 0.) {
+            throw std::logic_error("singular temperature basis!");
+        }
+        R[m*M+m] = norm;
+        for (long s=0; s<nsamples; s++) {
+            Q[s*M+m] /= norm;
+        }
+    }
+    // Back substitution of R P = Q^T, column by column
+    for (long s=0; s<nsamples; s++) {
+        for (long m=M-1; m>=0; m--) {
+            double v = Q[s*M+m];
+            for (long k=m+1; k<M; k++) {
+                v -= R[m*M+k]*P[k*nsamples+s];
+            }
+            P[m*nsamples+s] = v / R[m*M+m];
+        }
+    }
+    
+    // Fit every point of every column
+    long N = cold.energies.size();
+    long C = cold.columns.size();
+    
+    DBSTemperatureFit fit;
+    fit.nterms   = M;
+    fit.tempMinK = tempMinK;
+    fit.tempMaxK = tempMaxK;
+    fit.energies = cold.energies;
+    fit.coeffs.assign(C, std::vector<double>(N*M, 0.));
+    fit.maxRelError.assign(C, 0.);
+    
+    // Basis at the check temperatures
+    long nchecks = nsamples - 1;
+    std::vector<double> checkBasis(nchecks*M);
+    for (long s=0; s<nchecks; s++) {
+        basis(temps[nsamples+s], &checkBasis[s*M]);
+    }
+    
+    for (long c=0; c<C; c++) {
+        auto& cs  = fit.coeffs[c];
+        auto& err = fit.maxRelError[c];
+        for (long i=0; i<N; i++) {
+            for (long m=0; m<M; m++) {
+                double v = 0.;
+                for (long s=0; s<nsamples; s++) {
+                    v += P[m*nsamples+s]*hot[s].columns[c][i];
+                }
+                cs[i*M+m] = v;
+            }
+            for (long s=0; s<nchecks; s++) {
+                double v = 0.;
+                for (long m=0; m<M; m++) {
+                    v += cs[i*M+m]*checkBasis[s*M+m];
+                }
+                double ref = hot[nsamples+s].columns[c][i];
+                err = std::max
+                (err, fabs(v - ref) / std::max(fabs(ref), CMS::zeroThres));
+            }
+        }
+    }
+    
+    return fit;
+}
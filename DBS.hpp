@@ -22,6 +22,8 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include "CMS.hpp"
 #include "ENDF.hpp"
@@ -29,10 +31,138 @@
 //namespace com {
 //namespace ibhe {
 
+// The kernel evaluating the Sigma1 sums
+// SCALAR evaluates erfc and exp point by point with the math library,
+// VECTOR evaluates them in batches, with SIMD approximations of relative
+// error below 1.5E-15 within the exponential window when AVX-512 or
+// AVX2 is enabled at compile time, and the math library otherwise
+enum class DBSSigma1Kernel {
+    SCALAR = 0,
+    VECTOR = 1
+};
+
+// Cross sections of several reactions on a shared energy grid, linearly
+// interpolated. columns[c][i] is the cross section c at energies[i]
+struct DBSMultiXsec {
+    std::vector<double> energies;
+    std::vector<std::vector<double> > columns;
+};
+
+// Point counts of a broadening with thinning
+struct DBSThinSummary {
+    // Points of the cold cross section
+    long   pointsIn        = 0;
+    // Points broadened, those up to the cutoff energy
+    long   pointsBroadened = 0;
+    // Points left after thinning
+    long   pointsOut       = 0;
+    // The cutoff energy in eV
+    double cutoffEv        = 0.;
+};
+
+// Temperature fits of broadened cross sections on an energy grid
+// At every grid point, the cross section of column c is fitted as
+//   xs(T) = sum of c_k * t^((k-2)/2), k = 0 .. nterms-1, t = T/tempMaxK
+// that is 1/t, 1/sqrt(t), 1, sqrt(t), t, ..., over [tempMinK, tempMaxK],
+// and interpolated linearly in energy
+struct DBSTemperatureFit {
+    
+    // Number of fit coefficients per point
+    long nterms = 0;
+    
+    // Fitted temperature range
+    double tempMinK = 0.;
+    double tempMaxK = 0.;
+    
+    // The energy grid in eV
+    std::vector<double> energies;
+    
+    // The coefficients of point i are coeffs[c][i*nterms .. (i+1)*nterms)
+    std::vector<std::vector<double> > coeffs;
+    
+    // The maximum relative error of each column, checked against
+    // broadening at the temperatures between the fitted ones
+    std::vector<double> maxRelError;
+    
+    bool valid() const {
+        return nterms > 0 && !energies.empty() && !coeffs.empty();
+    }
+    
+    // Evaluate column c at energyEv and tempK, tempK shall be within
+    // the fitted range, energies out of the grid take the end values
+    double evaluate(long c, double energyEv, double tempK) const {
+        double t  = tempK / tempMaxK;
+        double st = sqrt(t);
+        
+        // Horner in sqrt(t), then divided by t
+        auto& cs = coeffs[c];
+        auto  xs = [&] (long i) -> double {
+            const double* p = &cs[i*nterms];
+            double y = p[nterms-1];
+            for (long k=nterms-2; k>=0; k--) {
+                y = y*st + p[k];
+            }
+            return y / t;
+        };
+        
+        long N = energies.size();
+        if (energyEv <= energies.front()) {
+            return xs(0);
+        }
+        if (energyEv >= energies.back()) {
+            return xs(N-1);
+        }
+        long i = std::upper_bound
+        (energies.begin(), energies.end(), energyEv) - energies.begin() - 1;
+        double r = (energyEv - energies[i]) / (energies[i+1] - energies[i]);
+        
+        double y1 = xs(i);
+        return y1 + r*(xs(i+1) - y1);
+    }
+};
+
 class DBS {
 public:
+    // Broaden the linear cross section by tempK with Sigma1 method
+    // The energy points are distributed over nthreads threads,
+    // nthreads <= 0 uses all hardware threads. The result does not
+    // depend on the number of threads
     static void proceedWithSigma1
-    (ENDFInterpolationFunction& xsec, double AWR, double tempK);
+    (ENDFInterpolationFunction& xsec, double AWR, double tempK,
+     long nthreads = 1, DBSSigma1Kernel kernel = DBSSigma1Kernel::VECTOR);
+    
+    // The energy above which the Doppler width sqrt(4*E*kT/A) is
+    // less than widthRatio of the energy
+    static double sigma1CutoffEnergy
+    (double AWR, double tempK, double widthRatio);
+    
+    // Broaden the linear cross section by tempK with Sigma1 method up
+    // to the cutoff energy of widthRatio, the points above keep their
+    // cold values. The result is then thinned to the relative tolerance
+    // tol with LS::thin. Returns the point counts
+    static DBSThinSummary proceedWithSigma1AndThin
+    (ENDFInterpolationFunction& xsec, double AWR, double tempK, double tol,
+     double widthRatio = 1E-4, long nthreads = 1);
+    
+    // Fit the cross sections of cold, given at coldTempK, broadened to
+    // temperatures in [tempMinK, tempMaxK] with nterms coefficients per
+    // point. The fits are made on nsamples temperatures evenly spaced in
+    // sqrt(T), and checked on the temperatures halfway between them.
+    // Over 300 - 3000 K, 7 terms keep resonance wings within 0.3%,
+    // 9 terms within 0.05%
+    static DBSTemperatureFit fitTemperature
+    (const DBSMultiXsec& cold, double AWR, double coldTempK,
+     double tempMinK, double tempMaxK, long nterms = 7, long nsamples = 15,
+     long nthreads = 1);
+    
+    // Broaden all columns of xsecs by each of tempKs with Sigma1 method,
+    // one result on the same grid per temperature difference. The F
+    // functions depend only on the grid and temperature, they are
+    // evaluated once per point and temperature for all the columns.
+    // A repeated energy is a jump, as in LSJointTable
+    static std::vector<DBSMultiXsec> proceedWithSigma1
+    (const DBSMultiXsec& xsecs, double AWR, const std::vector<double>& tempKs,
+     long nthreads = 1);
 };
 
 
@@ -18,6 +18,8 @@
 #include "CMS.hpp"
 #include "ENDF.hpp"
 #include "NIST.hpp"
+#include "PRS.hpp"
+#include "WMP.hpp"
 
 #include <algorithm>
 #include <numeric>
@@ -596,8 +598,6 @@ struct ENDFLegendreCoefficients {
     std::vector<double> coeff2; // - L/(L+1), L >= 0
     std::vector<double> multip; // (2*L+1)/2, L >= 0
     
-    std::vector<double> buffer; // For user
-    
     ENDFLegendreCoefficients();
 };
 
@@ -605,7 +605,6 @@ ENDFLegendreCoefficients::ENDFLegendreCoefficients() {
     coeff1.resize(maxOrder, 0.);
     coeff2.resize(maxOrder, 0.);
     multip.resize(maxOrder, 0.);
-    buffer.resize(maxOrder, 0.);
     
     multip[0] = .5;
     coeff1[0] = 1.;
@@ -914,7 +913,6 @@ static long ENDFTabGetLaw
 
 // This function evaluates the interpolated value of an ENDF table
 double ENDFInterpolationFunction::evaluate(double x) const {
-    double y = 0.;
     
     if (x<_data.front().x) {
         return _data.front().y;
@@ -924,8 +922,27 @@ double ENDFInterpolationFunction::evaluate(double x) const {
         return _data.back().y;
     }
     
-    long i   = ENDFTabLocateIdx(_data, x);
-    long law = ENDFTabGetLaw(_interp, i);
+    return interpolate(locate(x), x);
+};
+
+double ENDFInterpolationFunction::evaluate
+(double x, ENDFCursor& cursor) const {
+    
+    if (x<_data.front().x) {
+        return _data.front().y;
+    }
+    
+    if (x>=_data.back().x) {
+        return _data.back().y;
+    }
+    
+    return interpolate(locate(x, cursor), x);
+};
+
+double ENDFInterpolationFunction::interpolate(long i, double x) const {
+    double y = 0.;
+    
+    long law = _lookup.valid() ? _lookup.laws[i] : ENDFTabGetLaw(_interp, i);
     
     // Perform intepolation
     if (law >= 1 && law <= 5) {
@@ -942,6 +959,190 @@ double ENDFInterpolationFunction::evaluate(double x) const {
     return y;
 };
 
+// Number of points located and evaluated together
+static const long interpBlockSize = 256;
+
+// Unsorted points are sorted first if there are so many, and the
+// function has so many points it does not stay in cache
+static const long interpSortThreshold = 4096;
+static const long interpSortMinPoints = 1 << 18;
+
+void ENDFInterpolationFunction::evaluate
+(const double* xs, double* ys, long n) const {
+    
+    long N = _data.size();
+    if (N < 2) {
+        for (long k=0; k<n; k++) {
+            ys[k] = evaluate(xs[k]);
+        }
+        return;
+    }
+    
+    const double xfront = _data.front().x;
+    const double xback  = _data.back().x;
+    const bool   sorted = std::is_sorted(xs, xs + n);
+    
+    // Many unsorted points on a large function are sorted, walked and
+    // scattered back, which is cheaper than a cache missing search each
+    if (!sorted && n >= interpSortThreshold && N >= interpSortMinPoints) {
+        std::vector< std::pair<double, long> > order(n);
+        for (long k=0; k<n; k++) {
+            if (std::isnan(xs[k])) {
+                throw std::logic_error("evaluate data error!");
+            }
+            order[k] = {xs[k], k};
+        }
+        std::sort(order.begin(), order.end());
+        std::vector<double> sx(n), sy(n);
+        for (long k=0; k<n; k++) {
+            sx[k] = order[k].first;
+        }
+        evaluate(sx.data(), sy.data(), n);
+        for (long k=0; k<n; k++) {
+            ys[order[k].second] = sy[k];
+        }
+        return;
+    }
+    
+    // Cursors of the sorted walk, the interval and the region
+    long i = 0, r = 0;
+    
+    // The interval and the law of every point of a block, the law 0
+    // marks points out of range
+    long idx[interpBlockSize], law[interpBlockSize];
+    
+    for (long b=0; b<n; b+=interpBlockSize) {
+        long m = std::min(interpBlockSize, n - b);
+        const double* xb = xs + b;
+        double*       yb = ys + b;
+        
+        // Locate
+        for (long k=0; k<m; k++) {
+            double x = xb[k];
+            if (!(x >= xfront && x < xback)) {
+                idx[k] = 0;
+                law[k] = 0;
+                continue;
+            }
+            if (sorted) {
+                while (_data[i+1].x <= x) {
+                    i++;
+                }
+                while (r + 1 < (long)_interp.size() &&
+                       i >= _interp[r].NBT - 1) {
+                    r++;
+                }
+                idx[k] = i;
+                law[k] = _interp.empty() ? 2 : _interp[r].INT;
+            } else {
+                idx[k] = locate(x);
+                law[k] = _lookup.valid() ?
+                _lookup.laws[idx[k]] : ENDFTabGetLaw(_interp, idx[k]);
+            }
+        }
+        
+        // Linear-linear for all points, no branches, so it vectorizes
+        const ENDFDataPoint* d = _data.data();
+        for (long k=0; k<m; k++) {
+            const ENDFDataPoint& p1 = d[idx[k]];
+            const ENDFDataPoint& p2 = d[idx[k]+1];
+            double rk = (xb[k] - p1.x) / (p2.x - p1.x);
+            yb[k] = p1.y + rk * (p2.y - p1.y);
+        }
+        
+        // The other laws and the points out of range
+        for (long k=0; k<m; k++) {
+            if (law[k] == 2) {
+                continue;
+            }
+            if (law[k] == 0) {
+                if (std::isnan(xb[k])) {
+                    throw std::logic_error("evaluate data error!");
+                }
+                yb[k] = xb[k] < xfront ? _data.front().y : _data.back().y;
+                continue;
+            }
+            if (law[k] < 1 || law[k] > 5) {
+                throw std::logic_error("unsupport ENDF law!");
+            }
+            auto& p1 = d[idx[k]];
+            auto& p2 = d[idx[k]+1];
+            yb[k] = ENDFInterpEval(p1.x, p1.y, p2.x, p2.y, xb[k], law[k]);
+        }
+        
+        for (long k=0; k<m; k++) {
+            if (std::isinf(yb[k]) || std::isnan(yb[k])) {
+                throw std::logic_error("evaluate data error!");
+            }
+        }
+    }
+}
+
+bool ENDFPreparedFunction::init(const ENDFInterpolationFunction& func) {
+    
+    clear();
+    
+    try {
+        
+        if (!func.valid()) {
+            throw std::logic_error("invalid function!");
+        }
+        
+        long N = func.data().size();
+        x.resize(N);
+        y.resize(N);
+        for (long i=0; i<N; i++) {
+            x[i] = func.data()[i].x;
+            y[i] = func.data()[i].y;
+        }
+        
+        b.assign(std::max(N - 1, 0L), 0.);
+        laws.assign(b.size(), ENDFPreparedLaw::LINLIN);
+        linlin = true;
+        for (long i=0; i+1<N; i++) {
+            long   INT = ENDFTabGetLaw(func.interp(), i);
+            double x1 = x[i], y1 = y[i], x2 = x[i+1], y2 = y[i+1];
+            
+            // The branches of ENDFInterpEval
+            bool xcond = x1 <= 0. || x2 <= 0.;
+            bool ycond = y1 <= 0. || y2 <= 0.;
+            bool logx  = (INT == 3 || INT == 5) && !xcond;
+            bool logy  = (INT == 4 || INT == 5) && !ycond;
+            
+            ENDFPreparedLaw law = ENDFPreparedLaw::LINLIN;
+            if (INT == 1) {
+                law = ENDFPreparedLaw::CONST;
+            } else if (INT >= 2 && INT <= 5) {
+                law = logx ?
+                (logy ? ENDFPreparedLaw::LOGLOG : ENDFPreparedLaw::LOGLIN):
+                (logy ? ENDFPreparedLaw::LINLOG : ENDFPreparedLaw::LINLIN);
+            } else {
+                throw std::logic_error("unsupport ENDF law!");
+            }
+            laws[i] = law;
+            linlin  = linlin && law == ENDFPreparedLaw::LINLIN;
+            
+            // A jump has no interior point
+            if (x1 == x2) {
+                continue;
+            }
+            double dx = logx ? log(x2 / x1) : (x2 - x1);
+            double dy = logy ? log(y2 / y1) : (y2 - y1);
+            b[i] = law == ENDFPreparedLaw::CONST ? 0. : dy / dx;
+            if (std::isnan(b[i]) || std::isinf(b[i])) {
+                throw std::logic_error("interval coefficient error!");
+            }
+        }
+        
+    } catch (std::exception& e) {
+        std::cerr << "[ENDF]: error msg - " << e.what() << std::endl;
+        clear();
+        return false;
+    }
+    
+    return true;
+}
+
 double ENDFPolynomialFunction::evaluate(double x) const {
     double y = 0., xn = 1.;
     for (auto c : coefficents) {
@@ -954,18 +1155,18 @@ double ENDFPolynomialFunction::evaluate(double x) const {
 // Implementations of distribution
 double ENDFLegendreDistribution::evaluate(double x) const {
     auto& L = gENDFLegendreCoefficients;
-    if (coefficents.size() > L.maxOrder) {
+    if (coefficents.size() >= L.maxOrder) {
         throw std::logic_error("max legendre order exceeds!");
     }
-    auto& P = L.buffer;
-    P[0] = 1.;
-    P[1] = x;
-    double y = L.multip[0]*P[0];
+    double P0 = 1., P1 = x;
+    double y  = L.multip[0]*P0;
     for (long l=1; l<=coefficents.size(); l++) {
         if (l >= 2) {
-            P[l] = L.coeff1[l-1]*x*P[l-1] + L.coeff2[l-1]*P[l-2];
+            double P2 = L.coeff1[l-1]*x*P1 + L.coeff2[l-1]*P0;
+            P0 = P1;
+            P1 = P2;
         }
-        y += L.multip[l]*coefficents[l-1]*P[l];
+        y += L.multip[l]*coefficents[l-1]*P1;
     }
     
     // Set to CMS::zeroThres if negative
@@ -976,6 +1177,53 @@ double ENDFLegendreDistribution::evaluate(double x) const {
     return y;
 }
 
+// Number of cosines run through the recurrence together
+static const long legendreBlockSize = 64;
+
+void ENDFLegendreDistribution::evaluate
+(const double* x, double* y, long n) const {
+    auto& L = gENDFLegendreCoefficients;
+    if (coefficents.size() >= L.maxOrder) {
+        throw std::logic_error("max legendre order exceeds!");
+    }
+    long NL = coefficents.size();
+    
+    // The order is the outer loop, so the inner loop over the block
+    // has no dependency and is vectorized
+    double P0[legendreBlockSize], P1[legendreBlockSize];
+    for (long b=0; b<n; b+=legendreBlockSize) {
+        long m = std::min(legendreBlockSize, n - b);
+        const double* xb = x + b;
+        double*       yb = y + b;
+        for (long k=0; k<m; k++) {
+            P0[k] = 1.;
+            P1[k] = xb[k];
+            yb[k] = L.multip[0]*P0[k];
+        }
+        for (long l=1; l<=NL; l++) {
+            double c1 = L.coeff1[l-1], c2 = L.coeff2[l-1];
+            double m1 = L.multip[l], a = coefficents[l-1];
+            if (l >= 2) {
+                for (long k=0; k<m; k++) {
+                    double P2 = c1*xb[k]*P1[k] + c2*P0[k];
+                    P0[k] = P1[k];
+                    P1[k] = P2;
+                }
+            }
+            for (long k=0; k<m; k++) {
+                yb[k] += m1*a*P1[k];
+            }
+        }
+        
+        // Set to CMS::zeroThres if negative
+        for (long k=0; k<m; k++) {
+            if (yb[k] < CMS::zeroThres) {
+                yb[k] = CMS::zeroThres;
+            }
+        }
+    }
+}
+
 bool ENDFLegendreDistribution::isIsotropic() const {
     return std::all_of
     (coefficents.begin(), coefficents.end(),
@@ -983,7 +1231,10 @@ bool ENDFLegendreDistribution::isIsotropic() const {
 }
 
 // ENDF Math functions
-inline static double ENDFSLBWPenetrationFactor(long l, double rho) {
+// The penetration and shift factors are also evaluated at complex rho,
+// for the poles of the resonances
+template <typename T>
+inline static T ENDFSLBWPenetrationFactor(long l, T rho) {
     if (l == 0) {
         return rho;
     } else if (l == 1) {
@@ -1035,7 +1286,8 @@ inline static double ENDFSLBWPhaseShift(long l, double rho) {
     }
 }
 
-inline static double ENDFSLBWShiftFactor(long l, double rho) {
+template <typename T>
+inline static T ENDFSLBWShiftFactor(long l, T rho) {
     if (l == 0) {
         return 0.;
     } else if (l == 1) {
@@ -1071,15 +1323,51 @@ inline static double ENDFSLBWChi0(double x) {
     return x/(1. + x*x);
 }
 
+// Doppler broadened line shapes psi and chi at energy E, of a resonance
+// at ER of total width G. At 0K psi + i*chi = (i*G/2)/(E - q), with the
+// pole q = ER - i*G/2. The reaction cross sections go as 1/u times the
+// shapes, u = sqrt(E), for s-waves, so u*(psi + i*chi) is broadened with
+// the free gas kernel, the Gaussian of width du = sqrt(kT/A) in u with
+// the odd extension to u < 0. It splits into the poles +-s in u,
+// s^2 = q, each broadened exactly by the Faddeeva function. du = 0 gives
+// the 0K shapes
+inline static void ENDFSLBWPsiChi
+(double E, double ER, double G, double du, double& psi, double& chi) {
+    if (du <= 0.) {
+        double x = 2*(E - ER)/G;
+        psi = ENDFSLBWPsi0(x);
+        chi = ENDFSLBWChi0(x);
+        return;
+    }
+    const std::complex<double> I(0., 1.);
+    double u = sqrt(E);
+    auto   s = std::sqrt(std::complex<double>(ER, -0.5*G));
+    // Averages of 1/(u' - s) and 1/(u' + s), Im(s) < 0
+    auto   m = -I*sqrt(M_PI)/du*
+    std::conj(WMP::faddeeva(std::conj(s - u)/du));
+    auto   p = I*sqrt(M_PI)/du*WMP::faddeeva((-s - u)/du);
+    auto   f = 0.25*I*G/u*(m + p);
+    psi = f.real();
+    chi = f.imag();
+}
+
+// Doppler width in u = sqrt(E) of a nuclide of mass ratio A at tempK
+inline static double ENDFDopplerWidth(double A, double tempK) {
+    return (tempK > 0.) ? sqrt(CMS::BoltzmannEvK*tempK/A) : 0.;
+}
+
 inline static double ENDFSqr(double x) {
     return x*x;
 }
 
+// Fixed size matrix for the Reich-Moore channels
+typedef double ENDFMatrix3[3][3];
+
 // Inverts symmetric matrix
 static void ENDFSYMINV
-(std::vector<std::vector<double>>& D, long N, long& KIMERR) {
+(ENDFMatrix3& D, long N, long& KIMERR) {
     double FOOEY;
-    std::vector<double> S(N,0);
+    double S[3] = {0, 0, 0};
     
     KIMERR = 0;
     for (long j=0; j<N; j++) {
@@ -1119,8 +1407,7 @@ static void ENDFSYMINV
 
 // Matrix multiplication
 static void ENDFABCMAT
-(std::vector<std::vector<double>> A, std::vector<std::vector<double>> B,
- std::vector<std::vector<double>>& C, long N) {
+(const ENDFMatrix3& A, const ENDFMatrix3& B, ENDFMatrix3& C, long N) {
     for (long i=0; i<N; i++) {
         for (long j=0; j<N; j++) {
             C[i][j] = 0;
@@ -1135,13 +1422,18 @@ static void ENDFABCMAT
 //!     PARTS A AND B AND GIVES C AND D THE REAL AND IMAGINARY PARTS OF
 //!     THE INVERSE. FROBENIUS-SCHUR METHOD OF INVERSION.
 static void ENDFFROBNS
-(std::vector<std::vector<double>> A, std::vector<std::vector<double>> B,
- std::vector<std::vector<double>>& C, std::vector<std::vector<double>>& D,
- long N) {
+(const ENDFMatrix3& AIN, const ENDFMatrix3& B,
+ ENDFMatrix3& C, ENDFMatrix3& D, long N) {
     long IND;
-    decltype(A) Q = A;
+    ENDFMatrix3 A, Q;
     
-    C = A;
+    for (long i=0; i<3; i++) {
+        for (long j=0; j<3; j++) {
+            A[i][j] = AIN[i][j];
+            Q[i][j] = AIN[i][j];
+            C[i][j] = AIN[i][j];
+        }
+    }
     ENDFSYMINV(A, N, IND);
     if (IND != 1) {
         ENDFABCMAT(A, B, Q, N);
@@ -1193,9 +1485,19 @@ static void ENDFGNRL
         {1.4079206E-08,0.0          ,5.0989546E-07,0.0}
     });
     
+    if (MU < 1 || MU > 4) {
+        MU = 4;
+    }
     if (NU < 1 || NU > 4) {
         NU = 4;
     }
+    if (LAMBDA < 1 || LAMBDA > 4) {
+        LAMBDA = 4;
+    }
+    // Columns of the tables are for 1 to 4 degrees of freedom
+    MU--;
+    NU--;
+    LAMBDA--;
     S = 0;
     if (GALPHA > 0) {
         if (GAMMA > 0) {
@@ -1376,7 +1678,7 @@ std::pair<double, double> ENDFNeutronData::getResolvedResonanceRange() const {
 }
 
 ENDFNeutronData::Resonance::Xsec
-ENDFNeutronData::getResolvedResonanceXsec(double energy) const {
+ENDFNeutronData::getResolvedResonanceXsec(double energy, double tempK) const {
     
     if (energy < 0.) {
         throw std::logic_error("negative energy!");
@@ -1392,7 +1694,8 @@ ENDFNeutronData::getResolvedResonanceXsec(double energy) const {
         for (auto& range : resonance.ranges) {
             if(!hasRR && range.LRU == 1) {
                 hasRR = true;
-                auto addXsec = range.generate(energy, resonance.LFW);
+                auto addXsec =
+                range.generate(energy, resonance.LFW, tempK);
                 double ABN = resonance.ABN;
                 xsec.capture   += ABN * addXsec.capture;
                 xsec.elastic   += ABN * addXsec.elastic;
@@ -1411,6 +1714,76 @@ ENDFNeutronData::getResolvedResonanceXsec(double energy) const {
 }
 
 
+// Number of energies handed out to a worker thread at once
+static const long endfEnergiesPerChunk = 256;
+
+std::vector<ENDFNeutronData::Resonance::Xsec>
+ENDFNeutronData::getResolvedResonanceXsec
+(const std::vector<double>& energies, long nthreads) const {
+    
+    for (auto energy : energies) {
+        if (energy < 0.) {
+            throw std::logic_error("negative energy!");
+        }
+    }
+    
+    // Define alias for simplicity
+    using Xsec = ENDFNeutronData::Resonance::Xsec;
+    
+    // Select the resolved range of each isotope once for all energies
+    std::vector<const Resonance::Range*> selected;
+    std::vector<double> abundances;
+    std::vector<long>   flags;
+    for (auto& resonance : resonances) {
+        bool hasRR = false;
+        for (auto& range : resonance.ranges) {
+            if(!hasRR && range.LRU == 1) {
+                hasRR = true;
+                selected.push_back(&range);
+                abundances.push_back(resonance.ABN);
+                flags.push_back(resonance.LFW);
+            } else if (hasRR && range.LRU == 1) {
+                std::cerr
+                << "[NDLS]: warning already have resolved resonance range!"
+                << std::endl;
+            }
+        }
+    }
+    
+    // The cross sections will be summed
+    std::vector<Xsec> xsecs(energies.size());
+    PRS::parallelFor
+    (energies.size(), nthreads, endfEnergiesPerChunk, [&] (long b, long e) {
+        std::vector<Xsec> addXsecs(e - b);
+        for (long r=0; r<selected.size(); r++) {
+            selected[r]->generate
+            (&energies[b], e - b, flags[r], addXsecs.data());
+            double ABN = abundances[r];
+            for (long i=b; i<e; i++) {
+                auto& xsec    = xsecs[i];
+                auto& addXsec = addXsecs[i-b];
+                xsec.capture   += ABN * addXsec.capture;
+                xsec.elastic   += ABN * addXsec.elastic;
+                xsec.fission   += ABN * addXsec.fission;
+                xsec.potential += ABN * addXsec.potential;
+                xsec.total     += ABN * addXsec.total;
+            }
+        }
+    });
+    
+    return xsecs;
+}
+
+void ENDFNeutronData::indexResolvedResonance(double tol, double widths) {
+    for (auto& resonance : resonances) {
+        for (auto& range : resonance.ranges) {
+            if (range.LRU == 1) {
+                range.indexResonances(tol, widths);
+            }
+        }
+    }
+}
+
 // Other implementations in details
 ENDFTab1& ENDFTab1::eliminateDuplicatedZeros() {
     long idxFirstNonZero=0;
@@ -1454,57 +1827,132 @@ ENDFNeutronData::Yield::~Yield() {
     }
 }
 
-ENDFNeutronData::Resonance::Xsec
-ENDFNeutronData::Resonance::Range::
-generateLRU1LRF1(double E) const {
-    // Implementation of Resonance reconstruction of SLBW representation
-    ENDFNeutronData::Resonance::Xsec xsec;
-    
-    // SLBW, sample implementation
+// The resonance part of the LRF=1,2,3 kernels is a sum of terms, one per
+// resonance, combined with the channel quantities of each angular momentum
+// at the end. The kernels are split into these two steps, the sums can then
+// be taken over a part of the resonances only, see Range::WindowIndex
+
+// Alias for simplicity
+using ENDFResonanceRange = ENDFNeutronData::Resonance::Range;
+using ENDFResonanceMomentum = ENDFNeutronData::Resonance::AngularMomentum;
+
+// Wave number and channel radii of an angular momentum at energy E
+// E in eV, k in (1E-12 cm)^(-1)
+static void ENDFResonanceRadii
+(const ENDFResonanceRange& range, const ENDFResonanceMomentum& momentum,
+ double E, double& k, double& rho, double& rho_hat) {
+    double A = momentum.AWRI;
+    double a = 0.123*pow(A, 1.0/3.0)+0.08;
+    k = (2.196771E-3)*A/(A+1)*sqrt(fabs(E));
+    rho     = 0.;
+    rho_hat = 0.;
+    if (range.LRF == 3) {
+        // L-dependent scattering radius for Reich-Moore
+        double AP = (momentum.APL==0) ? range.AP : momentum.APL;
+        if (range.NRO == 0) {
+            if (range.NAPS == 0) {
+                rho     = k * a;
+            } else if (range.NAPS == 1) {
+                rho     = k * AP;
+            }
+            rho_hat = k * AP;
+        } else if (range.NRO == 1) {
+            if (range.NAPS == 0) {
+                rho     = k * a;
+            } else if (range.NAPS == 1) {
+                rho     = k * range.APE.evaluate(E);
+            } else if (range.NAPS == 2) {
+                rho     = k * range.AP;
+            }
+            rho_hat = k * range.APE.evaluate(E);
+        }
+    } else {
+        if (range.NRO == 0) {
+            if (range.NAPS == 0) {
+                rho     = k * a;
+                rho_hat = k * range.AP;
+            } else if (range.NAPS == 1) {
+                rho     = k * range.AP;
+                rho_hat = k * range.AP;
+            }
+        } else if (range.NRO == 1) {
+            if (range.NAPS == 0) {
+                rho     = k * a;
+                rho_hat = k * range.APE.evaluate(E);
+            } else if (range.NAPS == 1) {
+                rho     = k * range.APE.evaluate(E);
+                rho_hat = k * range.APE.evaluate(E);
+            } else if (range.NAPS == 2) {
+                rho     = k * range.AP;
+                rho_hat = k * range.APE.evaluate(E);
+            }
+        }
+    }
+}
+
+// Number of J values of an angular momentum, from the lowest AJMIN
+static long ENDFResonanceNumJ(double I, double l, double& AJMIN) {
+    AJMIN = fabs(fabs(I-l)-0.5);
+    double AJMAX = I+l+0.5;
+    return lround(AJMAX-AJMIN) + 1;
+}
+
+// Number of resonance sums of a LRF=1,2,3 range
+static long ENDFResonanceNumSums(const ENDFResonanceRange& range) {
+    long n = 0;
+    double AJMIN;
+    for (auto& momentum : range.moments) {
+        long NUMJ = ENDFResonanceNumJ(range.SPI, momentum.L, AJMIN);
+        if (range.LRF == 1) {
+            n += 5;
+        } else if (range.LRF == 2) {
+            n += 2 + 2*NUMJ;
+        } else if (range.LRF == 3) {
+            n += 2*NUMJ*12;
+        } else {
+            throw std::logic_error("no resonance sums for LRF!");
+        }
+    }
+    return n;
+}
+
+// SLBW, sample implementation
+// Sums per angular momentum, without the factor 4*pi/k^2:
+// fission, capture, and the psi, (1-GN/G)*psi, chi terms of elastic
+// At tempK > 0 the line shapes are Doppler broadened
+static void ENDFResonanceSumLRF1
+(const ENDFResonanceRange& range, double E,
+ const std::vector<long>* members, double* sums, double tempK = 0.) {
     double
-    l, sigma_mr, phi_l, gamma_r_max,
+    l, gamma_r_max,
     gamma_nr_max, gamma_fr, gamma_gr,
-    g_J, I, J, k, kr, A, a, ER, ER_p,
+    g_J, I, J, k, kr, A, ER, ER_p,
     rho=0, rho_hat=0,
     P_l, P_l_max, gamma_r, gamma_nr, rho_max,
-    x, psi, chi, rho_c=0, rho_c_max, gamma_xr,
-    P_l_c, P_l_c_max;
+    psi, chi, rho_c=0, rho_c_max, gamma_xr,
+    P_l_c, P_l_c_max, t;
     
-    I = SPI;
-    for (auto& momentum : moments) {
+    I = range.SPI;
+    for (long m=0; m<range.moments.size(); m++) {
+        auto& momentum = range.moments[m];
+        double* s = sums + 5*m;
+        for (long i=0; i<5; i++) {
+            s[i] = 0.;
+        }
         A = momentum.AWRI;
         l = momentum.L;
-        a = 0.123*pow(A, 1.0/3.0)+0.08;
-        k = (2.196771E-3)*A/(A+1)*sqrt(fabs(E));
-        // E in eV, k in (1E-12 cm)^(-1)
-        if (NRO == 0) {
-            if (NAPS == 0) {
-                rho     = k * a;
-                rho_hat = k * AP;
-            } else if (NAPS == 1) {
-                rho     = k * AP;
-                rho_hat = k * AP;
-            }
-        } else if (NRO == 1) {
-            if (NAPS == 0) {
-                rho     = k * a;
-                rho_hat = k * APE.evaluate(E);
-            } else if (NAPS == 1) {
-                rho     = k * APE.evaluate(E);
-                rho_hat = k * APE.evaluate(E);
-            } else if (NAPS == 2) {
-                rho     = k * AP;
-                rho_hat = k * APE.evaluate(E);
-            }
-        }
-        phi_l = ENDFSLBWPhaseShift(l, rho_hat);
-        xsec.potential += 4*M_PI/(k*k)*(2*l+1)*
-        (sin(phi_l)*sin(phi_l));
+        ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
         if (momentum.LRX != 0) {
             rho_c     = (2.196771E-3)*A/(A+1)*
             sqrt(fabs(E+A/(A+1)*momentum.QX));
         }
-        for (auto& region : momentum.BWTables) {
+        P_l = ENDFSLBWPenetrationFactor(l, rho);
+        double du = ENDFDopplerWidth(A, tempK);
+        long N = (members == nullptr) ?
+        momentum.BWTables.size() : members[m].size();
+        for (long n=0; n<N; n++) {
+            auto& region = momentum.BWTables
+            [(members == nullptr) ? n : members[m][n]];
             ER           = region.ER;
             kr           = (2.196771E-3)*A/(A+1)*
             sqrt(fabs(ER));
@@ -1517,8 +1965,6 @@ generateLRU1LRF1(double E) const {
             gamma_fr     = region.GF;
             P_l_max      =
             ENDFSLBWPenetrationFactor(l, rho_max);
-            P_l          =
-            ENDFSLBWPenetrationFactor(l, rho);
             gamma_nr     = gamma_nr_max*P_l/P_l_max;
             ER_p         = ER +
             (ENDFSLBWShiftFactor(l, rho_max)-
@@ -1542,16 +1988,35 @@ generateLRU1LRF1(double E) const {
             } else {
                 gamma_r  = gamma_nr + gamma_xr;
             }
-            sigma_mr     = 4*M_PI/(k*k)*g_J*gamma_nr/gamma_r;
-            x            = 2*(E - ER_p)/gamma_r;
-            psi          = ENDFSLBWPsi0(x);
-            chi          = ENDFSLBWChi0(x);
-            xsec.fission += sigma_mr/gamma_r*gamma_fr*psi;
-            xsec.capture += sigma_mr/gamma_r*gamma_gr*psi;
-            xsec.elastic += sigma_mr*
-            ((cos(2*phi_l)-(1-gamma_nr/gamma_r))*psi
-             + sin(2*phi_l)*chi);
+            t            = g_J*gamma_nr/gamma_r;
+            ENDFSLBWPsiChi(E, ER_p, gamma_r, du, psi, chi);
+            s[0] += t/gamma_r*gamma_fr*psi;
+            s[1] += t/gamma_r*gamma_gr*psi;
+            s[2] += t*psi;
+            s[3] += t*(1-gamma_nr/gamma_r)*psi;
+            s[4] += t*chi;
         }
+    }
+}
+
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceFinishLRF1
+(const ENDFResonanceRange& range, double E, const double* sums) {
+    ENDFNeutronData::Resonance::Xsec xsec;
+    
+    double l, k, rho, rho_hat, phi_l, f;
+    for (long m=0; m<range.moments.size(); m++) {
+        auto& momentum = range.moments[m];
+        const double* s = sums + 5*m;
+        l = momentum.L;
+        ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
+        phi_l = ENDFSLBWPhaseShift(l, rho_hat);
+        f     = 4*M_PI/(k*k);
+        xsec.potential += f*(2*l+1)*
+        (sin(phi_l)*sin(phi_l));
+        xsec.fission += f*s[0];
+        xsec.capture += f*s[1];
+        xsec.elastic += f*
+        (cos(2*phi_l)*s[2] - s[3] + sin(2*phi_l)*s[4]);
         // Add potential scattering
         xsec.elastic += xsec.potential;
     }
@@ -1561,86 +2026,64 @@ generateLRU1LRF1(double E) const {
     return xsec;
 }
 
-ENDFNeutronData::Resonance::Xsec
-ENDFNeutronData::Resonance::Range::
-generateLRU1LRF2(double E) const {
-    // Implementation of Resonance reconstruction of MLBW representation
-    ENDFNeutronData::Resonance::Xsec xsec;
-    
-    // MLBW, sample implementation
+// MLBW, sample implementation
+// Sums per angular momentum, without the factor 4*pi/k^2:
+// fission, capture, and the elastic components SIGJ1, SIGJ2 of each J
+// At tempK > 0 the line shapes are Doppler broadened, the elastic
+// squares of SIGJ1 and SIGJ2 then hold the products psi^2 + chi^2 of
+// each resonance, broadened they are psi. diagonal receives these
+// differences per angular momentum and J, in the order of the sums
+static void ENDFResonanceSumLRF2
+(const ENDFResonanceRange& range, double E,
+ const std::vector<long>* members, double* sums,
+ double tempK = 0., double* diagonal = nullptr) {
     double
-    l, sigma_mr, phi_l, gamma_r_max,
+    l, gamma_r_max,
     gamma_nr_max, gamma_fr, gamma_gr,
-    g_J, I, J, k, kr, A, a, ER, ER_p,
+    g_J, I, J, k, kr, A, ER, ER_p,
     rho=0, rho_hat=0,
     P_l, P_l_max, gamma_r, gamma_nr,
-    rho_max, rho_hat_max,
-    x, psi, chi, rho_c=0,
-    rho_c_max, gamma_xr, P_l_c, P_l_c_max;
-    // Reference to the subroutine CSSLBW
-    double SSUM, AJMIN, AJMAX, AJ, DIFF;
-    long NUMJ;
-    std::vector<double> GJ;
-    std::vector<double> SIGJ1, SIGJ2;
+    rho_max,
+    psi, chi, rho_c=0,
+    rho_c_max, gamma_xr, P_l_c, P_l_c_max, t;
+    double AJMIN;
+    long NUMJ, j;
     
-    I = SPI;
-    for (auto& momentum : moments) {
+    I = range.SPI;
+    for (long m=0; m<range.moments.size(); m++) {
+        auto& momentum = range.moments[m];
         A = momentum.AWRI;
         l = momentum.L;
-        a = 0.123*pow(A, 1.0/3.0)+0.08;
-        k = (2.196771E-3)*A/(A+1)*sqrt(fabs(E));
-        // E in eV, k in (1E-12 cm)^(-1)
-        if (NRO == 0) {
-            if (NAPS == 0) {
-                rho     = k * a;
-                rho_hat = k * AP;
-            } else if (NAPS == 1) {
-                rho     = k * AP;
-                rho_hat = k * AP;
-            }
-        } else if (NRO == 1) {
-            if (NAPS == 0) {
-                rho     = k * a;
-                rho_hat = k * APE.evaluate(E);
-            } else if (NAPS == 1) {
-                rho     = k * APE.evaluate(E);
-                rho_hat = k * APE.evaluate(E);
-            } else if (NAPS == 2) {
-                rho     = k * AP;
-                rho_hat = k * APE.evaluate(E);
+        NUMJ = ENDFResonanceNumJ(I, l, AJMIN);
+        double* s     = sums;
+        double* SIGJ1 = sums + 2;
+        double* SIGJ2 = sums + 2 + NUMJ;
+        sums += 2 + 2*NUMJ;
+        for (long i=0; i<2+2*NUMJ; i++) {
+            s[i] = 0.;
+        }
+        double* DIAG = diagonal;
+        if (diagonal != nullptr) {
+            diagonal += NUMJ;
+            for (long i=0; i<NUMJ; i++) {
+                DIAG[i] = 0.;
             }
         }
-        phi_l = ENDFSLBWPhaseShift(l, rho_hat);
-        xsec.potential += 4*M_PI/(k*k)*(2*l+1)*
-        (sin(phi_l)*sin(phi_l));
+        ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
         if (momentum.LRX != 0) {
             rho_c     = (2.196771E-3)*A/(A+1)*
             sqrt(fabs(E+A/(A+1)*momentum.QX));
         }
-        
-        // Calculate number of spins exists and ther gJ sum
-        AJMIN = fabs(fabs(I-l)-0.5);
-        AJMAX = I+l+0.5;
-        NUMJ  = lround(AJMAX-AJMIN) + 1;
-        AJ    = AJMIN;
-        GJ.resize(NUMJ,0);
-        SSUM  = 0;
-        for (long j=0; j<NUMJ; j++) {
-            GJ[j] = (2*AJ+1)/(2*(2*I+1));
-            AJ++;
-            SSUM += GJ[j];
-        }
-        DIFF = 2*l + 1 - SSUM;
-        
-        // Zero elastic components
-        SIGJ1.resize(NUMJ, 0);
-        SIGJ2.resize(NUMJ, 0);
-        
-        for (auto& region : momentum.BWTables) {
+        P_l = ENDFSLBWPenetrationFactor(l, rho);
+        double du = ENDFDopplerWidth(A, tempK);
+        long N = (members == nullptr) ?
+        momentum.BWTables.size() : members[m].size();
+        for (long n=0; n<N; n++) {
+            auto& region = momentum.BWTables
+            [(members == nullptr) ? n : members[m][n]];
             ER           = region.ER;
             kr           = (2.196771E-3)*A/(A+1)*sqrt(fabs(ER));
             rho_max      = rho/k*kr;
-            rho_hat_max  = rho_hat/k*kr;
             J            = region.AJ;
             g_J          = (2*J+1)/(2*(2*I+1));
             gamma_r_max  = region.GT;
@@ -1648,7 +2091,6 @@ generateLRU1LRF2(double E) const {
             gamma_gr     = region.GG;
             gamma_fr     = region.GF;
             P_l_max      = ENDFSLBWPenetrationFactor(l, rho_max);
-            P_l          = ENDFSLBWPenetrationFactor(l, rho);
             gamma_nr     = gamma_nr_max*P_l/P_l_max;
             ER_p         = ER +
             (ENDFSLBWShiftFactor(l, rho_max)-
@@ -1672,24 +2114,68 @@ generateLRU1LRF2(double E) const {
             } else {
                 gamma_r  = gamma_nr + gamma_xr;
             }
-            sigma_mr     = 4*M_PI/(k*k)*g_J*gamma_nr/gamma_r;
-            x            = 2*(E - ER_p)/gamma_r;
-            psi          = ENDFSLBWPsi0(x);
-            chi          = ENDFSLBWChi0(x);
-            xsec.fission += sigma_mr/gamma_r*gamma_fr*psi;
-            xsec.capture += sigma_mr/gamma_r*gamma_gr*psi;
+            t            = g_J*gamma_nr/gamma_r;
+            ENDFSLBWPsiChi(E, ER_p, gamma_r, du, psi, chi);
+            s[0] += t/gamma_r*gamma_fr*psi;
+            s[1] += t/gamma_r*gamma_gr*psi;
             
             // Elastic components
-            SIGJ1[lround(J-AJMIN)] += 2*gamma_nr/gamma_r*psi;
-            SIGJ2[lround(J-AJMIN)] += 2*gamma_nr/gamma_r*chi;
+            j = lround(J-AJMIN);
+            SIGJ1[j] += 2*gamma_nr/gamma_r*psi;
+            SIGJ2[j] += 2*gamma_nr/gamma_r*chi;
+            if (DIAG != nullptr) {
+                DIAG[j] += ENDFSqr(2*gamma_nr/gamma_r)*
+                (psi - psi*psi - chi*chi);
+            }
         }
+    }
+}
+
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceFinishLRF2
+(const ENDFResonanceRange& range, double E, const double* sums,
+ const double* diagonal = nullptr) {
+    ENDFNeutronData::Resonance::Xsec xsec;
+    
+    double l, I, k, rho, rho_hat, phi_l, f;
+    // Reference to the subroutine CSSLBW
+    double SSUM, AJMIN, AJ, DIFF, GJ;
+    long NUMJ;
+    
+    I = range.SPI;
+    for (long m=0; m<range.moments.size(); m++) {
+        auto& momentum = range.moments[m];
+        l = momentum.L;
+        NUMJ = ENDFResonanceNumJ(I, l, AJMIN);
+        const double* s     = sums;
+        const double* SIGJ1 = sums + 2;
+        const double* SIGJ2 = sums + 2 + NUMJ;
+        sums += 2 + 2*NUMJ;
+        ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
+        phi_l = ENDFSLBWPhaseShift(l, rho_hat);
+        f     = 4*M_PI/(k*k);
+        xsec.potential += f*(2*l+1)*
+        (sin(phi_l)*sin(phi_l));
+        xsec.fission += f*s[0];
+        xsec.capture += f*s[1];
         
-        // Add potential cross section
+        // Add potential cross section, with the gJ sum
+        AJ   = AJMIN;
+        SSUM = 0;
         for (long j=0; j<NUMJ; j++) {
-            xsec.elastic += GJ[j]*
+            GJ = (2*AJ+1)/(2*(2*I+1));
+            AJ++;
+            SSUM += GJ;
+            xsec.elastic += GJ*
             (ENDFSqr(1.0-cos(2*phi_l)-SIGJ1[j])
              + ENDFSqr(sin(2*phi_l)+SIGJ2[j])) * M_PI/(k*k);
+            if (diagonal != nullptr) {
+                xsec.elastic += GJ*diagonal[j]*M_PI/(k*k);
+            }
         }
+        if (diagonal != nullptr) {
+            diagonal += NUMJ;
+        }
+        DIFF = 2*l + 1 - SSUM;
         xsec.elastic +=
         2*DIFF*(1.0-cos(2*phi_l))*M_PI/(k*k);
     }
@@ -1699,281 +2185,2018 @@ generateLRU1LRF2(double E) const {
     return xsec;
 }
 
-ENDFNeutronData::Resonance::Xsec
-ENDFNeutronData::Resonance::Range::
-generateLRU1LRF3(double E) const {
-    // Implementation of Resonance reconstruction of RM representation
+// Reich-Moore, reference to the subroutine CSRMAT
+// Sums per angular momentum, J value and channel spin: the upper
+// triangular terms of the R (00,01,02,11,12,22) and S matrices
+static void ENDFResonanceSumLRF3
+(const ENDFResonanceRange& range, double E,
+ const std::vector<long>* members, double* sums) {
+    double
+    A, I, k, rho=0, rho_hat=0, l, kr, rho_max;
+    double
+    PE, ER, GN, GG, GF, PER, GC,
+    A1, A2, A3, DIFF, DEN, DE2, GG4,
+    AJMIN, AJ, AJPM;
+    long NUMJ, j;
+    
+    I = range.SPI;
+    for (long m=0; m<range.moments.size(); m++) {
+        auto& momentum = range.moments[m];
+        A = momentum.AWRI;
+        l = momentum.L;
+        NUMJ = ENDFResonanceNumJ(I, l, AJMIN);
+        double* s = sums;
+        sums += 2*NUMJ*12;
+        for (long i=0; i<2*NUMJ*12; i++) {
+            s[i] = 0.;
+        }
+        ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
+        PE = ENDFSLBWPenetrationFactor(l, rho);
+        long N = (members == nullptr) ?
+        momentum.RMTables.size() : members[m].size();
+        for (long n=0; n<N; n++) {
+            auto& resonance = momentum.RMTables
+            [(members == nullptr) ? n : members[m][n]];
+            AJPM = resonance.AJ; // Signed quantivity
+            AJ   = fabs(AJPM);
+            
+            // Select the J value
+            j = lround(AJ-AJMIN);
+            if (j < 0 || j >= NUMJ || fabs(AJ-(AJMIN+j)) > 0.01) {
+                continue;
+            }
+            
+            // Process resonance
+            ER      = resonance.ER;
+            kr      =
+            (2.196771E-3)*A/(A+1)*
+            sqrt(fabs(ER));
+            rho_max = rho/k*kr;
+            GN      = resonance.GN;
+            GG      = resonance.GG;
+            GF      = resonance.GFA;
+            PER     =
+            ENDFSLBWPenetrationFactor
+            (l, rho_max);
+            GC      = resonance.GFB;
+            A1      = sqrt(GN*PE/PER);
+            if (GF != 0) {
+                A2  = sqrt(fabs(GF));
+                if (GF < 0) A2=-A2;
+            } else {
+                A2  = 0;
+            }
+            if (GC != 0) {
+                A3  = sqrt(fabs(GC));
+                if (GC < 0) A3=-A3;
+            } else {
+                A3  = 0;
+            }
+            DIFF = ER - E;
+            DEN  = DIFF*DIFF + 0.25*GG*GG;
+            DE2  = 0.5*DIFF/DEN;
+            GG4  = 0.25*GG/DEN;
+            
+            // Channel 1 takes positive, channel 2 negative spins
+            for (long KCHANL=1; KCHANL<3; KCHANL++) {
+                if ((KCHANL == 1 && AJPM < 0) ||
+                    (KCHANL == 2 && AJPM > 0)) {
+                    continue;
+                }
+                double* R = s + (2*j + KCHANL-1)*12;
+                double* S = R + 6;
+                
+                // Calculate upper triangular matrix terms
+                R[0] += GG4*A1*A1;
+                S[0] -= DE2*A1*A1;
+                // Check whether contains fission channels
+                if (GF != 0 || GC != 0) {
+                    R[1] += GG4*A1*A2;
+                    S[1] -= DE2*A1*A2;
+                    R[2] += GG4*A1*A3;
+                    S[2] -= DE2*A1*A3;
+                    R[3] += GG4*A2*A2;
+                    S[3] -= DE2*A2*A2;
+                    R[5] += GG4*A3*A3;
+                    S[5] -= DE2*A3*A3;
+                    R[4] += GG4*A2*A3;
+                    S[4] -= DE2*A2*A3;
+                }
+            }
+        }
+    }
+}
+
+// Reich-Moore channel counts, which do not depend on energy
+// Per angular momentum, J value and channel spin: the number of
+// positive and negative spin resonances, and the fission flag
+static void ENDFResonanceCountLRF3
+(const ENDFResonanceRange& range, std::vector<long>& counts) {
+    double I = range.SPI, AJMIN, AJC, AJPM;
+    long NUMJ, IFIS = -1;
+    
+    counts.clear();
+    for (auto& momentum : range.moments) {
+        NUMJ = ENDFResonanceNumJ(I, momentum.L, AJMIN);
+        AJC  = AJMIN-1;
+        for (long j=0; j<NUMJ; j++) {
+            AJC++;
+            for (long KCHANL=1; KCHANL<3; KCHANL++) {
+                long KPSTV = 0, KNGTV = 0;
+                for (auto& resonance : momentum.RMTables) {
+                    AJPM = resonance.AJ;
+                    if (fabs(fabs(AJPM)-AJC) > 0.01) {
+                        continue;
+                    }
+                    if (AJPM < 0) {
+                        KNGTV ++;
+                    } else if (AJPM > 0) {
+                        KPSTV ++;
+                    }
+                    if ((KCHANL == 1 && AJPM < 0) ||
+                        (KCHANL == 2 && AJPM > 0)) {
+                        continue;
+                    }
+                    if (resonance.GFA == 0 && resonance.GFB == 0) {
+                        IFIS = 0;
+                    } else {
+                        IFIS = 1;
+                    }
+                }
+                counts.push_back(KPSTV);
+                counts.push_back(KNGTV);
+                counts.push_back(IFIS);
+            }
+        }
+    }
+}
+
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceFinishLRF3
+(const ENDFResonanceRange& range, double E,
+ const double* sums, const long* counts) {
     ENDFNeutronData::Resonance::Xsec xsec;
     
     // Reich-Moore
     double
-    A, I, k, rho=0, rho_hat=0, l,
-    a, phi_l, gJ, kr, rho_max;
+    I, k, rho=0, rho_hat=0, l, phi_l, gJ;
     // Reference to the subroutine CSRMAT
     double
-    SE, PE, ER, GN, GG, GF,
-    PER, GC, DIFF, DEN,
-    A1, A2, A3, DE2, GG4,
-    SIGNNI, SIGNGI, SIGNFI, SIGNTI,
-    AJMIN, AJMAX, AJC, AJ, AJPM;
+    DEN, SIGNNI, SIGNGI, SIGNFI, SIGNTI, AJMIN, AJC;
     long
-    NUMJ, JJL, KPSTV, KNGTV,
-    ISKIP, IFIS=-1, KKKKKK, JJ;
+    NUMJ, JJL, KPSTV, KNGTV, IFIS, KKKKKK, JJ;
     double
     P1, P2, U11R, U11I, TERMT, TERMN,
     TERMF, TERMG, T1, T2, T3, T4;
-    std::vector< std::vector<double> > R, S, RI, SI;
-    R.resize(3,{0,0,0});
-    S.resize(3,{0,0,0});
-    RI.resize(3,{0,0,0});
-    SI.resize(3,{0,0,0});
+    ENDFMatrix3 R, S, RI = {}, SI = {};
+    
+    I = range.SPI;
+    
+    // Initialize partial cross sections
+    SIGNNI = 0;
+    SIGNGI = 0;
+    SIGNFI = 0;
+    SIGNTI = 0;
+    
+    for (auto& momentum : range.moments) {
+        l = momentum.L;
+        ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
+        phi_l = ENDFSLBWPhaseShift(l, rho_hat);
+        P1    = cos(2*phi_l);
+        P2    = sin(2*phi_l);
+        
+        // Loop ober possible J values
+        NUMJ  = ENDFResonanceNumJ(I, l, AJMIN);
+        AJC   = AJMIN-1;
+        
+        if (l != 0 && (l > I-0.5 && l <= I)) {
+            JJL = 0;
+        } else {
+            JJL = 1;
+        }
+        for (long j=0; j<NUMJ; j++) {
+            JJ = j+1;
+            AJC++;
+            gJ = (2*AJC+1)/(2*(2*I+1));
+            
+            // Loop over possible channel spins
+            // KCHANL = 1,2
+            // Channel 1, skip negative, consider positive
+            // Channel 2, skip positive, consider negative
+            for (long KCHANL=1; KCHANL<3; KCHANL++) {
+                KPSTV = counts[0]; // Positive
+                KNGTV = counts[1]; // Negative
+                IFIS  = counts[2];
+                counts += 3;
+                
+                // Initialize matrix from the sums
+                const double* RS = sums;
+                const double* SS = sums + 6;
+                sums += 12;
+                R[0][0] = 1 + RS[0];
+                R[0][1] = RS[1];
+                R[0][2] = RS[2];
+                R[1][1] = 1 + RS[3];
+                R[1][2] = RS[4];
+                R[2][2] = 1 + RS[5];
+                S[0][0] = SS[0];
+                S[0][1] = SS[1];
+                S[0][2] = SS[2];
+                S[1][1] = SS[3];
+                S[1][2] = SS[4];
+                S[2][2] = SS[5];
+                R[1][0] = R[2][0] = R[2][1] = 0;
+                S[1][0] = S[2][0] = S[2][1] = 0;
+                
+                // Number of potential scatterings
+                KKKKKK = 0;
+                if (KCHANL == 1) {
+                    if (KPSTV > 0) {
+                        if (KNGTV == 0) {
+                            if (JJ > JJL && JJ < NUMJ) {
+                                KKKKKK = 2;
+                            } else {
+                                KKKKKK = 1;
+                            }
+                        } else if (KNGTV > 0) {
+                            KKKKKK = 0;
+                        }
+                    } else if (KPSTV == 0) {
+                        if (KNGTV == 0) {
+                            if (JJ > JJL && JJ < NUMJ) {
+                                KKKKKK = 2;
+                            } else {
+                                KKKKKK = 1;
+                            }
+                        } else if (KNGTV > 0) {
+                            KKKKKK = 0;
+                        }
+                    }
+                }else if (KCHANL == 2) {
+                    if (KPSTV > 0) {
+                        if (KNGTV > 0) {
+                            KKKKKK = 1;
+                        }
+                    } else if (KPSTV == 0) {
+                        if (KNGTV > 0) {
+                            if (JJ > JJL && JJ < NUMJ) {
+                                KKKKKK = 2;
+                            } else {
+                                KKKKKK = 1;
+                            }
+                        }
+                    }
+                }
+                
+                // Prepare to calculate the cross section
+                if (KKKKKK != 0) {
+                    if (IFIS == 0) {
+                        // Special case of no fission
+                        DEN      = R[0][0]*R[0][0] + S[0][0]*S[0][0];
+                        RI[0][0] = R[0][0]/DEN;
+                        SI[0][0] = -S[0][0]/DEN;
+                    } else {
+                        // Make symmetric marix
+                        R[1][0] = R[0][1];
+                        S[1][0] = S[0][1];
+                        R[2][0] = R[0][2];
+                        S[2][0] = S[0][2];
+                        R[2][1] = R[1][2];
+                        S[2][1] = S[1][2];
+                        // Invert the complex matrix
+                        ENDFFROBNS(R, S, RI, SI, 3);
+                    }
+                    
+                    // Calculate the cross sections
+                    U11R  = P1*(2*RI[0][0]-1) + 2*P2*SI[0][0];
+                    U11I  = P2*(1-2*RI[0][0]) + 2*P1*SI[0][0];
+                    TERMT = 2*gJ*(1-U11R);
+                    TERMN = gJ*(ENDFSqr(1-U11R) + ENDFSqr(U11I));
+                    // Add potential scattering
+                    if (KKKKKK == 2) {
+                        TERMN += 2*gJ*(1-P1);
+                        TERMT += 2*gJ*(1-P1);
+                    }
+                    if (IFIS == 0) {
+                        TERMF = 0;
+                    } else {
+                        T1    = RI[0][1];
+                        T2    = SI[0][1];
+                        T3    = RI[0][2];
+                        T4    = SI[0][2];
+                        TERMF = 4*gJ*(T1*T1+T2*T2+T3*T3+T4*T4);
+                    }
+                    TERMG  = TERMT-TERMF-TERMN;
+                    SIGNNI += TERMN*M_PI/(k*k);
+                    SIGNGI += TERMG*M_PI/(k*k);
+                    SIGNFI += TERMF*M_PI/(k*k);
+                    SIGNTI += TERMT*M_PI/(k*k);
+                }
+            }
+        }
+    }
+    
+    // Calculate cross section and store for return
+    xsec.total   = SIGNTI;
+    xsec.elastic = SIGNNI;
+    xsec.fission = SIGNFI;
+    xsec.capture = SIGNGI;
+    
+    return xsec;
+}
+
+// Compiled kernels
+// The constants of each resonance are computed once by Range::compile, the
+// per energy work is a loop over flat arrays, in blocks of ENDFLanes
+// resonances with one accumulator per lane, which the compiler can map
+// onto SIMD registers
+
+// Number of lanes of the compiled kernels
+static const long ENDFLanes = 4;
+
+// Constants of SLBW and MLBW resonances
+enum ENDFCompiledBW {
+    BW_GJ = 0, // Statistical factor gJ
+    BW_GNP,    // GN/P(ER), neutron width over penetration at ER
+    BW_ER,     // Resonance energy
+    BW_SMX,    // S(ER), shift factor at ER
+    BW_SHF,    // GN/(2*P(ER)), shift per shift factor
+    BW_GX,     // GG + GF
+    BW_GG,     // Radiation width
+    BW_GF,     // Fission width
+    BW_CMP,    // Competitive width over its penetration at ER
+    BW_NPARAMS
+};
+
+// Constants of Reich-Moore resonances
+enum ENDFCompiledRM {
+    RM_ER = 0, // Resonance energy
+    RM_GGQ,    // GG^2/4
+    RM_GGH,    // GG/4
+    RM_A11,    // Channel products, without the penetration at E
+    RM_A12,
+    RM_A13,
+    RM_A22,
+    RM_A23,
+    RM_A33,
+    RM_NPARAMS
+};
+
+// Constants of Adler-Adler resonances
+enum ENDFCompiledAA {
+    AA_MUT = 0, AA_INUT, AA_GT, AA_HT,
+    AA_MUF, AA_INUF, AA_GF, AA_HF,
+    AA_MUC, AA_INUC, AA_GC, AA_HC,
+    AA_NPARAMS
+};
+
+// Sum a group of SLBW or MLBW resonances, at positions list[b, e) or
+// [b, e) if not G. P and S are the penetration and shift at E, pc the
+// competitive penetration. The sums are of f, c, t*psi, t*(1-u)*psi,
+// t*chi, u*psi and u*chi, with u = GN/G and t = gJ*u
+template <bool G>
+static void ENDFCompiledGroupBW
+(const ENDFNeutronData::Resonance::Range::Compiled& c,
+ const long* list, long b, long e,
+ double E, double P, double S, double pc, double* acc) {
+    const double* GJ  = &c.params[BW_GJ *c.size];
+    const double* GNP = &c.params[BW_GNP*c.size];
+    const double* ER  = &c.params[BW_ER *c.size];
+    const double* SMX = &c.params[BW_SMX*c.size];
+    const double* SHF = &c.params[BW_SHF*c.size];
+    const double* GX  = &c.params[BW_GX *c.size];
+    const double* GG  = &c.params[BW_GG *c.size];
+    const double* GF  = &c.params[BW_GF *c.size];
+    const double* CMP = &c.params[BW_CMP*c.size];
+    
+    double a[7][ENDFLanes] = {};
+    auto add = [&] (long p, long l) {
+        double gn  = GNP[p]*P;
+        double igr = 1./(gn + GX[p] + pc*CMP[p]);
+        double u   = gn*igr;
+        double t   = GJ[p]*u;
+        double x   = 2*(E - (ER[p] + (SMX[p] - S)*SHF[p]))*igr;
+        double psi = 1./(1. + x*x);
+        double chi = x*psi;
+        a[0][l] += t*igr*GF[p]*psi;
+        a[1][l] += t*igr*GG[p]*psi;
+        a[2][l] += t*psi;
+        a[3][l] += t*(1-u)*psi;
+        a[4][l] += t*chi;
+        a[5][l] += u*psi;
+        a[6][l] += u*chi;
+    };
+    long i = b;
+    for (; i+ENDFLanes<=e; i+=ENDFLanes) {
+        for (long l=0; l<ENDFLanes; l++) {
+            add(G ? list[i+l] : i+l, l);
+        }
+    }
+    for (; i<e; i++) {
+        add(G ? list[i] : i, 0);
+    }
+    for (long k=0; k<7; k++) {
+        acc[k] = 0.;
+        for (long l=0; l<ENDFLanes; l++) {
+            acc[k] += a[k][l];
+        }
+    }
+}
+
+// Sum a group of Reich-Moore resonances, the R and S terms without the
+// penetration factors at E
+template <bool G>
+static void ENDFCompiledGroupRM
+(const ENDFNeutronData::Resonance::Range::Compiled& c,
+ const long* list, long b, long e, double E, double* acc) {
+    const double* ER  = &c.params[RM_ER *c.size];
+    const double* GGQ = &c.params[RM_GGQ*c.size];
+    const double* GGH = &c.params[RM_GGH*c.size];
+    const double* AIJ[6] = {
+        &c.params[RM_A11*c.size], &c.params[RM_A12*c.size],
+        &c.params[RM_A13*c.size], &c.params[RM_A22*c.size],
+        &c.params[RM_A23*c.size], &c.params[RM_A33*c.size]
+    };
+    
+    double a[12][ENDFLanes] = {};
+    auto add = [&] (long p, long l) {
+        double DIFF = ER[p] - E;
+        double DEN  = 1./(DIFF*DIFF + GGQ[p]);
+        double DE2  = 0.5*DIFF*DEN;
+        double GG4  = GGH[p]*DEN;
+        for (long k=0; k<6; k++) {
+            a[k  ][l] += GG4*AIJ[k][p];
+            a[k+6][l] -= DE2*AIJ[k][p];
+        }
+    };
+    long i = b;
+    for (; i+ENDFLanes<=e; i+=ENDFLanes) {
+        for (long l=0; l<ENDFLanes; l++) {
+            add(G ? list[i+l] : i+l, l);
+        }
+    }
+    for (; i<e; i++) {
+        add(G ? list[i] : i, 0);
+    }
+    for (long k=0; k<12; k++) {
+        acc[k] = 0.;
+        for (long l=0; l<ENDFLanes; l++) {
+            acc[k] += a[k][l];
+        }
+    }
+}
+
+// Penetration P and shift S at E, and the competitive penetration pc
+static void ENDFCompiledChannel
+(const ENDFResonanceRange& range,
+ const ENDFNeutronData::Resonance::AngularMomentum& momentum,
+ double E, double& P, double& S, double& pc) {
+    double k, rho, rho_hat;
+    double l = momentum.L, A = momentum.AWRI;
+    ENDFResonanceRadii(range, momentum, E, k, rho, rho_hat);
+    P  = ENDFSLBWPenetrationFactor(l, rho);
+    S  = ENDFSLBWShiftFactor(l, rho);
+    pc = 0.;
+    if (range.LRF != 3 && momentum.LRX != 0 &&
+        !(E < -A/(A+1)*momentum.QX)) {
+        double rho_c = (2.196771E-3)*A/(A+1)*
+        sqrt(fabs(E+A/(A+1)*momentum.QX));
+        pc = ENDFSLBWPenetrationFactor(l, rho_c);
+    }
+}
+
+// Resonance sums of a compiled LRF=1,2,3 range, over the positions in
+// list (sorted), or over all resonances if list is nullptr
+static void ENDFCompiledSum
+(const ENDFResonanceRange& range, double E,
+ const long* list, long nlist, double* sums) {
+    auto& c = range.compiled;
+    
+    // Offsets of the sums of each angular momentum
+    std::vector<long> offsets(range.moments.size() + 1, 0);
+    std::vector<long> numj(range.moments.size());
+    for (long m=0; m<range.moments.size(); m++) {
+        double AJMIN;
+        numj[m] = ENDFResonanceNumJ(range.SPI, range.moments[m].L, AJMIN);
+        long n  = (range.LRF == 1) ? 5 :
+        ((range.LRF == 2) ? 2 + 2*numj[m] : 24*numj[m]);
+        offsets[m+1] = offsets[m] + n;
+    }
+    for (long i=0; i<offsets.back(); i++) {
+        sums[i] = 0.;
+    }
+    
+    double P = 0., S = 0., pc = 0., sqrtP = 0.;
+    long   cursor = 0, mlast = -1;
+    double acc[12];
+    long   ngroups = c.groupMoment.size();
+    for (long g=0; g<ngroups; g++) {
+        long m    = c.groupMoment[g];
+        long last = (g+1 < ngroups) ? c.groupBegin[g+1] : c.size;
+        long b, e;
+        if (list == nullptr) {
+            b = c.groupBegin[g];
+            e = last;
+        } else {
+            b = cursor;
+            while (cursor < nlist && list[cursor] < last) {
+                cursor ++;
+            }
+            e = cursor;
+        }
+        if (b == e) {
+            continue;
+        }
+        
+        // Channel quantities of the angular momentum
+        if (m != mlast) {
+            mlast = m;
+            ENDFCompiledChannel(range, range.moments[m], E, P, S, pc);
+            sqrtP = sqrt(P);
+        }
+        
+        double* s = sums + offsets[m];
+        long    j = c.groupJ[g];
+        if (range.LRF == 3) {
+            if (list == nullptr) {
+                ENDFCompiledGroupRM<false>(c, list, b, e, E, acc);
+            } else {
+                ENDFCompiledGroupRM<true>(c, list, b, e, E, acc);
+            }
+            double factor[6] = {P, sqrtP, sqrtP, 1., 1., 1.};
+            for (long KCHANL=1; KCHANL<3; KCHANL++) {
+                if (!(c.groupMask[g] & KCHANL)) {
+                    continue;
+                }
+                double* R = s + (2*j + KCHANL-1)*12;
+                for (long q=0; q<6; q++) {
+                    R[q]   += factor[q]*acc[q];
+                    R[q+6] += factor[q]*acc[q+6];
+                }
+            }
+        } else {
+            if (list == nullptr) {
+                ENDFCompiledGroupBW<false>(c, list, b, e, E, P, S, pc, acc);
+            } else {
+                ENDFCompiledGroupBW<true>(c, list, b, e, E, P, S, pc, acc);
+            }
+            s[0] += acc[0];
+            s[1] += acc[1];
+            if (range.LRF == 1) {
+                s[2] += acc[2];
+                s[3] += acc[3];
+                s[4] += acc[4];
+            } else {
+                s[2 + j]          += 2*acc[5];
+                s[2 + numj[m] + j] += 2*acc[6];
+            }
+        }
+    }
+}
+
+// Resonance sums of a compiled LRF=1,2,3 range over all resonances, for
+// a block of ENDFLanes energies. Here the lanes run over the energies, so
+// the constants of each resonance are loaded once for the whole block.
+// offsets are the offsets of the sums of each angular momentum, the sums
+// of lane l are stored from sums[l*nsums]
+static void ENDFCompiledSumBlock
+(const ENDFResonanceRange& range, const double* E,
+ const long* offsets, const long* numj, double* sums) {
+    auto& c = range.compiled;
+    long nsums = offsets[range.moments.size()];
+    for (long i=0; i<ENDFLanes*nsums; i++) {
+        sums[i] = 0.;
+    }
+    
+    double P[ENDFLanes], S[ENDFLanes], pc[ENDFLanes], sqrtP[ENDFLanes];
+    double a[12][ENDFLanes];
+    long   mlast = -1;
+    long   ngroups = c.groupMoment.size();
+    for (long g=0; g<ngroups; g++) {
+        long m = c.groupMoment[g];
+        long b = c.groupBegin[g];
+        long e = (g+1 < ngroups) ? c.groupBegin[g+1] : c.size;
+        if (b == e) {
+            continue;
+        }
+        
+        // Channel quantities of the angular momentum
+        if (m != mlast) {
+            mlast = m;
+            for (long l=0; l<ENDFLanes; l++) {
+                ENDFCompiledChannel
+                (range, range.moments[m], E[l], P[l], S[l], pc[l]);
+                sqrtP[l] = sqrt(P[l]);
+            }
+        }
+        
+        for (long k=0; k<12; k++) {
+            for (long l=0; l<ENDFLanes; l++) {
+                a[k][l] = 0.;
+            }
+        }
+        
+        long j = c.groupJ[g];
+        if (range.LRF == 3) {
+            const double* ER  = &c.params[RM_ER *c.size];
+            const double* GGQ = &c.params[RM_GGQ*c.size];
+            const double* GGH = &c.params[RM_GGH*c.size];
+            const double* A11 = &c.params[RM_A11*c.size];
+            const double* A12 = &c.params[RM_A12*c.size];
+            const double* A13 = &c.params[RM_A13*c.size];
+            const double* A22 = &c.params[RM_A22*c.size];
+            const double* A23 = &c.params[RM_A23*c.size];
+            const double* A33 = &c.params[RM_A33*c.size];
+            for (long p=b; p<e; p++) {
+                for (long l=0; l<ENDFLanes; l++) {
+                    double DIFF = ER[p] - E[l];
+                    double DEN  = 1./(DIFF*DIFF + GGQ[p]);
+                    double DE2  = 0.5*DIFF*DEN;
+                    double GG4  = GGH[p]*DEN;
+                    a[ 0][l] += GG4*A11[p];
+                    a[ 1][l] += GG4*A12[p];
+                    a[ 2][l] += GG4*A13[p];
+                    a[ 3][l] += GG4*A22[p];
+                    a[ 4][l] += GG4*A23[p];
+                    a[ 5][l] += GG4*A33[p];
+                    a[ 6][l] -= DE2*A11[p];
+                    a[ 7][l] -= DE2*A12[p];
+                    a[ 8][l] -= DE2*A13[p];
+                    a[ 9][l] -= DE2*A22[p];
+                    a[10][l] -= DE2*A23[p];
+                    a[11][l] -= DE2*A33[p];
+                }
+            }
+            for (long l=0; l<ENDFLanes; l++) {
+                double* s = sums + l*nsums + offsets[m];
+                double factor[6] = {P[l], sqrtP[l], sqrtP[l], 1., 1., 1.};
+                for (long KCHANL=1; KCHANL<3; KCHANL++) {
+                    if (!(c.groupMask[g] & KCHANL)) {
+                        continue;
+                    }
+                    double* R = s + (2*j + KCHANL-1)*12;
+                    for (long q=0; q<6; q++) {
+                        R[q]   += factor[q]*a[q][l];
+                        R[q+6] += factor[q]*a[q+6][l];
+                    }
+                }
+            }
+        } else {
+            const double* GJ  = &c.params[BW_GJ *c.size];
+            const double* GNP = &c.params[BW_GNP*c.size];
+            const double* ER  = &c.params[BW_ER *c.size];
+            const double* SMX = &c.params[BW_SMX*c.size];
+            const double* SHF = &c.params[BW_SHF*c.size];
+            const double* GX  = &c.params[BW_GX *c.size];
+            const double* GG  = &c.params[BW_GG *c.size];
+            const double* GF  = &c.params[BW_GF *c.size];
+            const double* CMP = &c.params[BW_CMP*c.size];
+            for (long p=b; p<e; p++) {
+                for (long l=0; l<ENDFLanes; l++) {
+                    double gn  = GNP[p]*P[l];
+                    double igr = 1./(gn + GX[p] + pc[l]*CMP[p]);
+                    double u   = gn*igr;
+                    double t   = GJ[p]*u;
+                    double x   =
+                    2*(E[l] - (ER[p] + (SMX[p] - S[l])*SHF[p]))*igr;
+                    double psi = 1./(1. + x*x);
+                    double chi = x*psi;
+                    a[0][l] += t*igr*GF[p]*psi;
+                    a[1][l] += t*igr*GG[p]*psi;
+                    a[2][l] += t*psi;
+                    a[3][l] += t*(1-u)*psi;
+                    a[4][l] += t*chi;
+                    a[5][l] += u*psi;
+                    a[6][l] += u*chi;
+                }
+            }
+            for (long l=0; l<ENDFLanes; l++) {
+                double* s = sums + l*nsums + offsets[m];
+                s[0] += a[0][l];
+                s[1] += a[1][l];
+                if (range.LRF == 1) {
+                    s[2] += a[2][l];
+                    s[3] += a[3][l];
+                    s[4] += a[4][l];
+                } else {
+                    s[2 + j]           += 2*a[5][l];
+                    s[2 + numj[m] + j] += 2*a[6][l];
+                }
+            }
+        }
+    }
+}
+
+// R-Matrix Limited kernels (LRF=7)
+// Per spin group the R-matrix of the explicit channels is summed over the
+// resonances, R = sum g_c g_c' / (ER - E - iGG/2), GG the eliminated
+// capture width (KRM=3), and (I - R L) Z = R is solved with L = S - B + iP.
+// The collision matrix is U = W (I + 2i P^1/2 Z P^1/2) W, W = exp(-i phi).
+// The solves are made for blocks of energies at once, each element of the
+// small complex matrices holding one value per lane
+
+// Particle pair of the elastic channels
+static long ENDFRMLEntrance(const ENDFResonanceRange& range) {
+    for (long p=0; p<range.pairs.size(); p++) {
+        if (range.pairs[p].MT == 2) {
+            return p;
+        }
+    }
+    throw std::logic_error("no elastic particle pair for LRF=7!");
+}
+
+static bool ENDFRMLPenetrable
+(const ENDFNeutronData::Resonance::ParticlePair& pair) {
+    return pair.PNT == 1 || (pair.PNT == 0 && pair.MA > 0.);
+}
+
+// Energy in the center of mass of a pair, and its wave number
+static double ENDFRMLWaveNumber
+(const ENDFResonanceRange& range, long entrance, long p, double E,
+ double& Ecm) {
+    auto& in   = range.pairs[entrance];
+    auto& pair = range.pairs[p];
+    Ecm = E*in.MB/(in.MA + in.MB) + pair.Q;
+    double mu = pair.MA*pair.MB/(pair.MA + pair.MB);
+    return (Ecm > 0. && mu > 0.) ? (2.196771E-3)*sqrt(mu*Ecm) : 0.;
+}
+
+// The compiled spin groups: constants ER, GG and the amplitudes of the
+// explicit channels. The widths are converted with the penetrabilities
+// at the resonance energies, Gamma = 2 g^2 P
+static void ENDFCompileLRF7
+(const ENDFResonanceRange& range,
+ ENDFNeutronData::Resonance::Range::Compiled& c) {
+    if (range.KRM != 3 && range.KRM != 4) {
+        throw std::logic_error("unsupport KRM for LRF = 7");
+    }
+    long entrance = ENDFRMLEntrance(range);
+    
+    // The explicit channels of each group
+    long nmax = 0;
+    std::vector< std::vector<long> > explicits(range.spinGroups.size());
+    for (long g=0; g<range.spinGroups.size(); g++) {
+        auto& group = range.spinGroups[g];
+        for (long ch=0; ch<group.channels.size(); ch++) {
+            auto& pair = range.pairs.at(group.channels[ch].PPI - 1);
+            if (range.KRM != 3 || pair.MT != 102) {
+                explicits[g].push_back(ch);
+            }
+        }
+        nmax = std::max(nmax, (long)explicits[g].size());
+        c.size += group.ER.size();
+    }
+    
+    c.nparams = 2 + nmax;
+    c.params.assign(c.nparams*c.size, 0.);
+    c.counts.assign(nmax*range.spinGroups.size(), -1);
+    long pos = 0;
+    for (long g=0; g<range.spinGroups.size(); g++) {
+        auto& group = range.spinGroups[g];
+        long nch = group.channels.size();
+        c.groupMoment.push_back(0);
+        c.groupJ.push_back(g);
+        c.groupMask.push_back(explicits[g].size());
+        c.groupBegin.push_back(pos);
+        for (long i=0; i<explicits[g].size(); i++) {
+            c.counts[g*nmax + i] = explicits[g][i];
+        }
+        for (long r=0; r<group.ER.size(); r++, pos++) {
+            double ER = group.ER[r], GG = 0.;
+            c.params[pos] = ER;
+            for (long ch=0; ch<nch; ch++) {
+                auto& channel = group.channels[ch];
+                auto& pair = range.pairs[channel.PPI - 1];
+                double GAM = group.GAM[r*nch + ch];
+                if (range.KRM == 3 && pair.MT == 102) {
+                    GG += (range.IFG == 1) ? 2.*GAM*GAM : fabs(GAM);
+                }
+            }
+            c.params[c.size + pos] = GG;
+            for (long i=0; i<explicits[g].size(); i++) {
+                long ch = explicits[g][i];
+                auto& channel = group.channels[ch];
+                auto& pair = range.pairs[channel.PPI - 1];
+                double GAM = group.GAM[r*nch + ch], amp;
+                if (range.IFG == 1) {
+                    amp = GAM;
+                } else {
+                    double P = 1., Ecm;
+                    if (ENDFRMLPenetrable(pair)) {
+                        double k = ENDFRMLWaveNumber
+                        (range, entrance, channel.PPI - 1, fabs(ER), Ecm);
+                        P = ENDFSLBWPenetrationFactor
+                        (channel.L, k*channel.APE);
+                    }
+                    amp = (P > 0.) ? sqrt(0.5*fabs(GAM)/P) : 0.;
+                    if (GAM < 0.) amp = -amp;
+                }
+                c.params[(2 + i)*c.size + pos] = amp;
+            }
+        }
+    }
+    c.groupBegin.push_back(c.size);
+    
+    // A range without spin groups, keep it valid
+    if (range.spinGroups.empty()) {
+        c.groupMoment.push_back(0);
+        c.groupJ.push_back(0);
+        c.groupMask.push_back(0);
+    }
+}
+
+// Cross sections of a compiled LRF=7 range at the NB energies E. Closed
+// channels do not carry flux, charged particle channels use the hard
+// sphere functions, the background R-matrices (KBK) and the tabulated
+// phase shifts (KPS) are not included
+template <long NB>
+static void ENDFRMLBlock
+(const ENDFResonanceRange& range, const double* E,
+ ENDFNeutronData::Resonance::Xsec* xsec) {
+    auto& c = range.compiled;
+    long entrance = ENDFRMLEntrance(range);
+    auto& in = range.pairs[entrance];
+    double gI = (2.*in.IA + 1.)*(2.*in.IB + 1.);
+    long nmax = c.nparams - 2;
+    
+    // Wave numbers and energies of the particle pairs
+    long npp = range.pairs.size();
+    std::vector<double> kp(npp*NB), Ecm(npp*NB);
+    for (long p=0; p<npp; p++) {
+        for (long l=0; l<NB; l++) {
+            kp[p*NB + l] = ENDFRMLWaveNumber
+            (range, entrance, p, E[l], Ecm[p*NB + l]);
+        }
+    }
+    
+    // Scratch of the groups: per channel P, S - B and phi, the matrices
+    // R, I - RL and Z, real and imaginary parts
+    long nn = nmax*nmax;
+    std::vector<double> scratch((3*nmax + 6*nn)*NB);
+    double* P   = scratch.data();
+    double* SB  = P   + nmax*NB;
+    double* phi = SB  + nmax*NB;
+    double* Rr  = phi + nmax*NB;
+    double* Ri  = Rr  + nn*NB;
+    double* Mr  = Ri  + nn*NB;
+    double* Mi  = Mr  + nn*NB;
+    double* Zr  = Mi  + nn*NB;
+    double* Zi  = Zr  + nn*NB;
+    
+    double total[NB] = {}, elastic[NB] = {}, fission[NB] = {},
+    other[NB] = {}, potential[NB] = {};
+    for (long g=0; g+1<c.groupBegin.size(); g++) {
+        if (range.spinGroups.empty()) {
+            break;
+        }
+        auto& group = range.spinGroups[c.groupJ[g]];
+        long nc = c.groupMask[g];
+        const long* chs = &c.counts[g*nmax];
+        double gJ = (2.*fabs(group.AJ) + 1.)/gI;
+        
+        // Channel functions
+        for (long i=0; i<nc; i++) {
+            auto& channel = group.channels[chs[i]];
+            long p = channel.PPI - 1;
+            auto& pair = range.pairs[p];
+            bool penetrable = ENDFRMLPenetrable(pair);
+            for (long l=0; l<NB; l++) {
+                double k = kp[p*NB + l];
+                P[i*NB + l] = 1.;
+                SB[i*NB + l] = 0.;
+                phi[i*NB + l] = 0.;
+                if (penetrable && (Ecm[p*NB + l] <= 0. || k <= 0.)) {
+                    P[i*NB + l] = 0.;
+                } else if (penetrable) {
+                    double rho = k*channel.APE;
+                    P[i*NB + l] =
+                    ENDFSLBWPenetrationFactor(channel.L, rho);
+                    if (pair.SHF == 1) {
+                        SB[i*NB + l] =
+                        ENDFSLBWShiftFactor(channel.L, rho) - channel.BND;
+                    }
+                    phi[i*NB + l] =
+                    ENDFSLBWPhaseShift(channel.L, k*channel.APT);
+                }
+            }
+        }
+        
+        // R-matrix, upper triangle
+        for (long i=0; i<nn*NB; i++) {
+            Rr[i] = 0.;
+            Ri[i] = 0.;
+        }
+        for (long r=c.groupBegin[g]; r<c.groupBegin[g+1]; r++) {
+            double ER = c.params[r];
+            double G2 = 0.5*c.params[c.size + r];
+            double re[NB], im[NB];
+            for (long l=0; l<NB; l++) {
+                double d = ER - E[l];
+                double den = 1./(d*d + G2*G2);
+                re[l] = d*den;
+                im[l] = G2*den;
+            }
+            for (long i=0; i<nc; i++) {
+                double gi = c.params[(2 + i)*c.size + r];
+                if (gi == 0.) {
+                    continue;
+                }
+                for (long j=i; j<nc; j++) {
+                    double gg = gi*c.params[(2 + j)*c.size + r];
+                    double* rr = Rr + (i*nc + j)*NB;
+                    double* ri = Ri + (i*nc + j)*NB;
+                    for (long l=0; l<NB; l++) {
+                        rr[l] += gg*re[l];
+                        ri[l] += gg*im[l];
+                    }
+                }
+            }
+        }
+        
+        // M = I - R L and the right hand side Z = R
+        for (long i=0; i<nc; i++) {
+            for (long j=0; j<nc; j++) {
+                long u = (std::min(i, j)*nc + std::max(i, j))*NB;
+                double* mr = Mr + (i*nc + j)*NB;
+                double* mi = Mi + (i*nc + j)*NB;
+                double* zr = Zr + (i*nc + j)*NB;
+                double* zi = Zi + (i*nc + j)*NB;
+                for (long l=0; l<NB; l++) {
+                    double a = Rr[u + l], b = Ri[u + l];
+                    double x = SB[j*NB + l], y = P[j*NB + l];
+                    mr[l] = ((i == j) ? 1. : 0.) - (a*x - b*y);
+                    mi[l] = -(a*y + b*x);
+                    zr[l] = a;
+                    zi[l] = b;
+                }
+            }
+        }
+        
+        // Gaussian elimination without pivoting, the Hermitian part of
+        // the similar matrix I - iP^1/2 R P^1/2 is positive definite
+        for (long k=0; k<nc; k++) {
+            double* pr = Mr + (k*nc + k)*NB;
+            double* pi = Mi + (k*nc + k)*NB;
+            double ir[NB], ii[NB];
+            for (long l=0; l<NB; l++) {
+                double den = 1./(pr[l]*pr[l] + pi[l]*pi[l]);
+                ir[l] =  pr[l]*den;
+                ii[l] = -pi[l]*den;
+            }
+            for (long i=k+1; i<nc; i++) {
+                double* ar = Mr + (i*nc + k)*NB;
+                double* ai = Mi + (i*nc + k)*NB;
+                double fr[NB], fi[NB];
+                for (long l=0; l<NB; l++) {
+                    fr[l] = ar[l]*ir[l] - ai[l]*ii[l];
+                    fi[l] = ar[l]*ii[l] + ai[l]*ir[l];
+                }
+                for (long j=k+1; j<nc; j++) {
+                    double* br = Mr + (k*nc + j)*NB;
+                    double* bi = Mi + (k*nc + j)*NB;
+                    double* cr = Mr + (i*nc + j)*NB;
+                    double* ci = Mi + (i*nc + j)*NB;
+                    for (long l=0; l<NB; l++) {
+                        cr[l] -= fr[l]*br[l] - fi[l]*bi[l];
+                        ci[l] -= fr[l]*bi[l] + fi[l]*br[l];
+                    }
+                }
+                for (long j=0; j<nc; j++) {
+                    double* br = Zr + (k*nc + j)*NB;
+                    double* bi = Zi + (k*nc + j)*NB;
+                    double* cr = Zr + (i*nc + j)*NB;
+                    double* ci = Zi + (i*nc + j)*NB;
+                    for (long l=0; l<NB; l++) {
+                        cr[l] -= fr[l]*br[l] - fi[l]*bi[l];
+                        ci[l] -= fr[l]*bi[l] + fi[l]*br[l];
+                    }
+                }
+            }
+        }
+        for (long k=nc-1; k>=0; k--) {
+            double* pr = Mr + (k*nc + k)*NB;
+            double* pi = Mi + (k*nc + k)*NB;
+            double ir[NB], ii[NB];
+            for (long l=0; l<NB; l++) {
+                double den = 1./(pr[l]*pr[l] + pi[l]*pi[l]);
+                ir[l] =  pr[l]*den;
+                ii[l] = -pi[l]*den;
+            }
+            for (long j=0; j<nc; j++) {
+                double* zr = Zr + (k*nc + j)*NB;
+                double* zi = Zi + (k*nc + j)*NB;
+                for (long i=k+1; i<nc; i++) {
+                    double* ar = Mr + (k*nc + i)*NB;
+                    double* ai = Mi + (k*nc + i)*NB;
+                    double* br = Zr + (i*nc + j)*NB;
+                    double* bi = Zi + (i*nc + j)*NB;
+                    for (long l=0; l<NB; l++) {
+                        zr[l] -= ar[l]*br[l] - ai[l]*bi[l];
+                        zi[l] -= ar[l]*bi[l] + ai[l]*br[l];
+                    }
+                }
+                for (long l=0; l<NB; l++) {
+                    double x = zr[l], y = zi[l];
+                    zr[l] = x*ir[l] - y*ii[l];
+                    zi[l] = x*ii[l] + y*ir[l];
+                }
+            }
+        }
+        
+        // Cross sections from the rows of the elastic channels,
+        // X = P^1/2 Z P^1/2 and U = W (I + 2iX) W
+        for (long i=0; i<nc; i++) {
+            auto& channel = group.channels[chs[i]];
+            if (channel.PPI - 1 != entrance) {
+                continue;
+            }
+            for (long j=0; j<nc; j++) {
+                long q = group.channels[chs[j]].PPI - 1;
+                long MT = range.pairs[q].MT;
+                const double* zr = Zr + (i*nc + j)*NB;
+                const double* zi = Zi + (i*nc + j)*NB;
+                for (long l=0; l<NB; l++) {
+                    double s = sqrt(P[i*NB + l]*P[j*NB + l]);
+                    double xr = s*zr[l], xi = s*zi[l];
+                    double U2;
+                    if (i == j) {
+                        // 1 - U = 1 - exp(-2i phi) (1 - 2 Im X + 2i Re X)
+                        double ph = 2.*phi[i*NB + l];
+                        double cs = cos(ph), sn = sin(ph);
+                        double ur = 1. - 2.*xi, ui = 2.*xr;
+                        double dr = 1. - (cs*ur + sn*ui);
+                        double di = -(cs*ui - sn*ur);
+                        total[l] += gJ*2.*dr;
+                        U2 = dr*dr + di*di;
+                        double s1 = sin(phi[i*NB + l]);
+                        potential[l] += gJ*4.*s1*s1;
+                    } else {
+                        U2 = 4.*(xr*xr + xi*xi);
+                    }
+                    if (q == entrance) {
+                        elastic[l] += gJ*U2;
+                    } else if (MT == 18) {
+                        fission[l] += gJ*U2;
+                    } else if (MT != 102) {
+                        other[l] += gJ*U2;
+                    }
+                }
+            }
+        }
+    }
+    
+    // Capture is the remainder, the eliminated and explicit photon
+    // channels
+    for (long l=0; l<NB; l++) {
+        double k = kp[entrance*NB + l];
+        double f = (k > 0.) ? M_PI/(k*k) : 0.;
+        xsec[l].total     = f*total[l];
+        xsec[l].elastic   = f*elastic[l];
+        xsec[l].fission   = f*fission[l];
+        xsec[l].capture   =
+        f*(total[l] - elastic[l] - fission[l] - other[l]);
+        xsec[l].potential = f*potential[l];
+    }
+}
+
+void ENDFNeutronData::Resonance::Range::compile() {
+    
+    compiled = Compiled();
+    
+    try {
+        
+        if (LRU == 1 && LRF == 7) {
+            ENDFCompileLRF7(*this, compiled);
+            return;
+        }
+        if (LRU != 1 || LRF < 1 || LRF > 4) {
+            return;
+        }
+        
+        // The channel radius need be energy independent
+        if (LRF != 4 && NRO == 1 && NAPS == 1) {
+            return;
+        }
+        
+        // Group key and constants of each resonance
+        struct Entry {
+            long   m, r, j, mask;
+            double params[AA_NPARAMS];
+        };
+        std::vector<Entry> entries;
+        
+        double I = SPI;
+        for (long m=0; m<moments.size(); m++) {
+            auto& momentum = moments[m];
+            double A = momentum.AWRI, l = momentum.L, AJMIN;
+            long   NUMJ = ENDFResonanceNumJ(I, l, AJMIN);
+            
+            // The radius of rho, from the radius at any energy
+            double k, rho, rho_hat;
+            if (LRF != 4) {
+                ENDFResonanceRadii(*this, momentum, 1., k, rho, rho_hat);
+            }
+            double radius = (LRF != 4) ? rho/k : 0.;
+            
+            if (LRF == 1 || LRF == 2) {
+                for (long r=0; r<momentum.BWTables.size(); r++) {
+                    auto& res = momentum.BWTables[r];
+                    Entry en;
+                    en.m    = m;
+                    en.r    = r;
+                    en.j    = lround(res.AJ-AJMIN);
+                    en.mask = 0;
+                    if (LRF == 2 && (en.j < 0 || en.j >= NUMJ)) {
+                        // Not a J value of the angular momentum
+                        return;
+                    }
+                    double kr    = (2.196771E-3)*A/(A+1)*sqrt(fabs(res.ER));
+                    double Pmax  = ENDFSLBWPenetrationFactor(l, radius*kr);
+                    double Smax  = ENDFSLBWShiftFactor(l, radius*kr);
+                    double* p    = en.params;
+                    p[BW_GJ ] = (2*res.AJ+1)/(2*(2*I+1));
+                    p[BW_GNP] = res.GN/Pmax;
+                    p[BW_ER ] = res.ER;
+                    p[BW_SMX] = Smax;
+                    p[BW_SHF] = res.GN/(2*Pmax);
+                    p[BW_GX ] = res.GG + res.GF;
+                    p[BW_GG ] = res.GG;
+                    p[BW_GF ] = res.GF;
+                    p[BW_CMP] = 0.;
+                    if (momentum.LRX != 0) {
+                        double rho_c_max = (2.196771E-3)*A/(A+1)*
+                        sqrt(fabs(res.ER+A/(A+1)*momentum.QX));
+                        p[BW_CMP] = (res.GT - p[BW_GX] - res.GN)/
+                        ENDFSLBWPenetrationFactor(l, rho_c_max);
+                    }
+                    entries.push_back(en);
+                }
+            } else if (LRF == 3) {
+                for (long r=0; r<momentum.RMTables.size(); r++) {
+                    auto& res = momentum.RMTables[r];
+                    double AJ = fabs(res.AJ);
+                    Entry en;
+                    en.m    = m;
+                    en.r    = r;
+                    en.j    = lround(AJ-AJMIN);
+                    en.mask = (res.AJ > 0) ? 1 : ((res.AJ < 0) ? 2 : 3);
+                    if (en.j < 0 || en.j >= NUMJ ||
+                        fabs(AJ-(AJMIN+en.j)) > 0.01) {
+                        // Not a J value of the angular momentum, ignored
+                        continue;
+                    }
+                    double kr  = (2.196771E-3)*A/(A+1)*sqrt(fabs(res.ER));
+                    double PER = ENDFSLBWPenetrationFactor(l, radius*kr);
+                    double A1  = sqrt(res.GN/PER);
+                    double A2  = (res.GFA < 0) ?
+                    -sqrt(fabs(res.GFA)) : sqrt(fabs(res.GFA));
+                    double A3  = (res.GFB < 0) ?
+                    -sqrt(fabs(res.GFB)) : sqrt(fabs(res.GFB));
+                    double* p  = en.params;
+                    p[RM_ER ] = res.ER;
+                    p[RM_GGQ] = 0.25*res.GG*res.GG;
+                    p[RM_GGH] = 0.25*res.GG;
+                    p[RM_A11] = A1*A1;
+                    p[RM_A12] = A1*A2;
+                    p[RM_A13] = A1*A3;
+                    p[RM_A22] = A2*A2;
+                    p[RM_A23] = A2*A3;
+                    p[RM_A33] = A3*A3;
+                    entries.push_back(en);
+                }
+            } else if (LRF == 4) {
+                // Consider only L=0 case
+                if (l != 0) {
+                    continue;
+                }
+                for (long j=0; j<momentum.AATables.size(); j++) {
+                    auto& spin = momentum.AATables[j];
+                    for (long r=0; r<spin.coefficients.size(); r++) {
+                        auto& res = spin.coefficients[r];
+                        Entry en;
+                        en.m    = m;
+                        en.r    = r;
+                        en.j    = j;
+                        en.mask = 0;
+                        double* p = en.params;
+                        p[AA_MUT ] = res.DET;
+                        p[AA_INUT] = 1/res.DWT;
+                        p[AA_GT  ] = res.GRT;
+                        p[AA_HT  ] = res.GIT;
+                        p[AA_MUF ] = res.DEF;
+                        p[AA_INUF] = 1/res.DWF;
+                        p[AA_GF  ] = res.GRF;
+                        p[AA_HF  ] = res.GIF;
+                        p[AA_MUC ] = res.DEC;
+                        p[AA_INUC] = 1/res.DWC;
+                        p[AA_GC  ] = res.GRC;
+                        p[AA_HC  ] = res.GIC;
+                        entries.push_back(en);
+                    }
+                }
+            }
+        }
+        
+        // Group by angular momentum, J value and channel spins
+        std::stable_sort(entries.begin(), entries.end(),
+                         [] (const Entry& a, const Entry& b) {
+            if (a.m != b.m) return a.m < b.m;
+            if (a.j != b.j) return a.j < b.j;
+            return a.mask < b.mask;
+        });
+        
+        Compiled c;
+        if (LRF == 3) {
+            ENDFResonanceCountLRF3(*this, c.counts);
+        }
+        c.size    = entries.size();
+        c.nparams = (LRF == 3) ? (long)RM_NPARAMS :
+        ((LRF == 4) ? (long)AA_NPARAMS : (long)BW_NPARAMS);
+        c.params.resize(c.nparams*c.size);
+        c.position.resize(moments.size());
+        for (long m=0; m<moments.size(); m++) {
+            long size = (LRF == 3) ? moments[m].RMTables.size() :
+            ((LRF == 4) ? 0 : moments[m].BWTables.size());
+            c.position[m].assign(size, -1);
+        }
+        for (long p=0; p<c.size; p++) {
+            auto& en = entries[p];
+            for (long k=0; k<c.nparams; k++) {
+                c.params[k*c.size + p] = en.params[k];
+            }
+            if (LRF != 4) {
+                c.position[en.m][en.r] = p;
+            }
+            if (p == 0 || en.m != entries[p-1].m || en.j != entries[p-1].j ||
+                en.mask != entries[p-1].mask) {
+                c.groupMoment.push_back(en.m);
+                c.groupJ.push_back(en.j);
+                c.groupMask.push_back(en.mask);
+                c.groupBegin.push_back(p);
+            }
+        }
+        
+        // A range without resonances, keep it valid
+        if (c.size == 0) {
+            c.groupBegin.push_back(0);
+            c.groupMoment.push_back(0);
+            c.groupJ.push_back(0);
+            c.groupMask.push_back(0);
+        }
+        
+        compiled = std::move(c);
+        
+    } catch (std::exception& e) {
+        // Unsupported parameters, generate reports them
+        std::cerr << "[ENDF]: warning range not compiled - " << e.what()
+        << std::endl;
+        compiled = Compiled();
+    }
+}
+
+// Adler-Adler sums of a compiled range, for the total the sums of
+// (GT*psi + HT*chi)/nu and (HT*psi - GT*chi)/nu
+static void ENDFCompiledSumAA
+(const ENDFNeutronData::Resonance::Range::Compiled& c, double E,
+ double* acc) {
+    const double* p[AA_NPARAMS];
+    for (long k=0; k<AA_NPARAMS; k++) {
+        p[k] = &c.params[k*c.size];
+    }
+    
+    double a[4][ENDFLanes] = {};
+    auto add = [&] (long i, long l) {
+        double x, psi, chi;
+        // Total
+        x   = (p[AA_MUT][i] - E)*p[AA_INUT][i];
+        psi = 1./(1. + x*x);
+        chi = x*psi;
+        a[0][l] += p[AA_INUT][i]*(p[AA_GT][i]*psi + p[AA_HT][i]*chi);
+        a[1][l] += p[AA_INUT][i]*(p[AA_HT][i]*psi - p[AA_GT][i]*chi);
+        // Fission
+        x   = (p[AA_MUF][i] - E)*p[AA_INUF][i];
+        psi = 1./(1. + x*x);
+        chi = x*psi;
+        a[2][l] += p[AA_INUF][i]*(p[AA_GF][i]*psi + p[AA_HF][i]*chi);
+        // Capture
+        x   = (p[AA_MUC][i] - E)*p[AA_INUC][i];
+        psi = 1./(1. + x*x);
+        chi = x*psi;
+        a[3][l] += p[AA_INUC][i]*(p[AA_GC][i]*psi + p[AA_HC][i]*chi);
+    };
+    long i = 0;
+    for (; i+ENDFLanes<=c.size; i+=ENDFLanes) {
+        for (long l=0; l<ENDFLanes; l++) {
+            add(i+l, l);
+        }
+    }
+    for (; i<c.size; i++) {
+        add(i, 0);
+    }
+    for (long k=0; k<4; k++) {
+        acc[k] = 0.;
+        for (long l=0; l<ENDFLanes; l++) {
+            acc[k] += a[k][l];
+        }
+    }
+}
+
+// Resonance sums of a LRF=1,2,3 range, over the resonances listed in
+// members for each angular momentum, or over all if members is nullptr
+static void ENDFResonanceSum
+(const ENDFResonanceRange& range, double E,
+ const std::vector<long>* members, double* sums) {
+    if (range.compiled.valid()) {
+        if (members == nullptr) {
+            ENDFCompiledSum(range, E, nullptr, 0, sums);
+            return;
+        }
+        // Positions of the members in the compiled arrays
+        std::vector<long> list;
+        for (long m=0; m<range.moments.size(); m++) {
+            for (auto r : members[m]) {
+                long p = range.compiled.position[m][r];
+                if (p >= 0) {
+                    list.push_back(p);
+                }
+            }
+        }
+        std::sort(list.begin(), list.end());
+        ENDFCompiledSum(range, E, list.data(), list.size(), sums);
+    } else if (range.LRF == 1) {
+        ENDFResonanceSumLRF1(range, E, members, sums);
+    } else if (range.LRF == 2) {
+        ENDFResonanceSumLRF2(range, E, members, sums);
+    } else if (range.LRF == 3) {
+        ENDFResonanceSumLRF3(range, E, members, sums);
+    } else {
+        throw std::logic_error("no resonance sums for LRF!");
+    }
+}
+
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceFinish
+(const ENDFResonanceRange& range, double E,
+ const double* sums, const long* counts) {
+    if (range.LRF == 1) {
+        return ENDFResonanceFinishLRF1(range, E, sums);
+    } else if (range.LRF == 2) {
+        return ENDFResonanceFinishLRF2(range, E, sums);
+    } else if (range.LRF == 3) {
+        return ENDFResonanceFinishLRF3(range, E, sums, counts);
+    } else {
+        throw std::logic_error("no resonance sums for LRF!");
+    }
+}
+
+// Cross sections with all resonances summed
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceGenerate
+(const ENDFResonanceRange& range, double E) {
+    std::vector<double> sums(ENDFResonanceNumSums(range));
+    std::vector<long>   counts;
+    const long* pcounts = counts.data();
+    if (range.LRF == 3) {
+        if (range.compiled.valid()) {
+            pcounts = range.compiled.counts.data();
+        } else if (range.index.valid()) {
+            pcounts = range.index.counts.data();
+        } else {
+            ENDFResonanceCountLRF3(range, counts);
+            pcounts = counts.data();
+        }
+    }
+    ENDFResonanceSum(range, E, nullptr, sums.data());
+    return ENDFResonanceFinish(range, E, sums.data(), pcounts);
+}
+
+// SLBW and MLBW cross sections at E of the resonances in members, with
+// the line shapes Doppler broadened at tempK (0K for tempK = 0)
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceGenerateMembers
+(const ENDFResonanceRange& range, double E,
+ const std::vector<long>* members, double tempK) {
+    std::vector<double> sums(ENDFResonanceNumSums(range));
+    if (range.LRF == 1) {
+        ENDFResonanceSumLRF1(range, E, members, sums.data(), tempK);
+        return ENDFResonanceFinishLRF1(range, E, sums.data());
+    } else if (range.LRF == 2) {
+        long ndiag = 0;
+        double AJMIN;
+        for (auto& momentum : range.moments) {
+            ndiag += ENDFResonanceNumJ(range.SPI, momentum.L, AJMIN);
+        }
+        std::vector<double> diagonal(ndiag);
+        ENDFResonanceSumLRF2
+        (range, E, members, sums.data(), tempK, diagonal.data());
+        return ENDFResonanceFinishLRF2
+        (range, E, sums.data(), diagonal.data());
+    } else {
+        throw std::logic_error("no broadened line shapes for LRF!");
+    }
+}
+
+// Gauss-Legendre nodes and weights of order 8 on [-1, 1]
+static const long   ENDFGaussPoints = 8;
+static const double ENDFGaussX[ENDFGaussPoints] = {
+    -0.9602898564975363, -0.7966664774136267,
+    -0.5255324099163290, -0.1834346424956498,
+     0.1834346424956498,  0.5255324099163290,
+     0.7966664774136267,  0.9602898564975363
+};
+static const double ENDFGaussW[ENDFGaussPoints] = {
+    0.1012285362903763, 0.2223810344533745,
+    0.3137066458778873, 0.3626837833783620,
+    0.3626837833783620, 0.3137066458778873,
+    0.2223810344533745, 0.1012285362903763
+};
+
+// Doppler widths covered by the free gas kernel
+static const double ENDFFreeGasWidths = 6.;
+
+// Free gas broadening at E of the resonance parts of the members at 0K,
+// the cross sections less the potential scattering, as E*sigma in
+// u = sqrt(E) with the kernel of width du. The panels of the quadrature
+// are cut at the resonances and at geometric distances from them, and
+// are not wider than a quarter of du
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceFreeGas
+(const ENDFResonanceRange& range, double E,
+ const std::vector<long>* members, double du) {
+    ENDFNeutronData::Resonance::Xsec xsec;
+    
+    double u  = sqrt(E);
+    double ua = std::max(0., u - ENDFFreeGasWidths*du);
+    double ub = u + ENDFFreeGasWidths*du;
+    std::vector<double> cuts = {ua, ub};
+    for (long m=0; m<range.moments.size(); m++) {
+        auto& momentum = range.moments[m];
+        for (auto r : members[m]) {
+            auto& res = momentum.BWTables[r];
+            if (res.ER <= 0.) {
+                continue;
+            }
+            double ur = sqrt(res.ER);
+            double h  = std::max(0.25*fabs(res.GT)/ur, 1E-12*ur);
+            for (double c=0.; c*h<ub-ua; c=(c == 0.) ? 1. : 4*c) {
+                if (ur - c*h > ua && ur - c*h < ub) {
+                    cuts.push_back(ur - c*h);
+                }
+                if (ur + c*h > ua && ur + c*h < ub) {
+                    cuts.push_back(ur + c*h);
+                }
+            }
+        }
+    }
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+    
+    std::vector<double> zeros(ENDFResonanceNumSums(range));
+    for (long k=0; k+1<cuts.size(); k++) {
+        double width = cuts[k+1] - cuts[k];
+        long   n     = std::max(1L, lround(ceil(width/(0.25*du))));
+        double panel = width/n;
+        for (long p=0; p<n; p++) {
+            for (long i=0; i<ENDFGaussPoints; i++) {
+                double v  = cuts[k] + panel*(p + 0.5 + 0.5*ENDFGaussX[i]);
+                double Ev = v*v;
+                double a  = (v - u)/du, b = (v + u)/du;
+                double kernel = 0.5*panel*ENDFGaussW[i]*Ev*
+                (exp(-a*a) - exp(-b*b))/(sqrt(M_PI)*du);
+                auto xs = ENDFResonanceGenerateMembers(range, Ev, members, 0.);
+                auto x0 = (range.LRF == 1) ?
+                ENDFResonanceFinishLRF1(range, Ev, zeros.data()) :
+                ENDFResonanceFinishLRF2(range, Ev, zeros.data());
+                xsec.elastic += kernel*(xs.elastic - x0.elastic);
+                xsec.capture += kernel*(xs.capture - x0.capture);
+                xsec.fission += kernel*(xs.fission - x0.fission);
+            }
+        }
+    }
+    xsec.elastic /= E;
+    xsec.capture /= E;
+    xsec.fission /= E;
+    xsec.total    = xsec.elastic + xsec.capture + xsec.fission;
+    return xsec;
+}
+
+// SLBW and MLBW cross sections at tempK. The s-wave resonances are
+// summed with the Doppler broadened line shapes. The line shapes do not
+// hold the rise of the elastic scattering at energies below kT/A, where
+// it is nearly constant, it is broadened as a constant cross section.
+// For l >= 1 the neutron width and the shift vary over the Doppler
+// width, the penetration as rho^(2l+1), so the line shapes do not hold:
+// these resonances are broadened from their 0K cross sections with the
+// free gas kernel by quadrature
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceGenerateBroadened
+(const ENDFResonanceRange& range, double E, double tempK) {
+    
+    // The s-wave resonances and the others
+    long nm = range.moments.size();
+    std::vector< std::vector<long> > swave(nm), others(nm);
+    bool hasOthers = false;
+    for (long m=0; m<nm; m++) {
+        auto& momentum = range.moments[m];
+        auto& members  = (momentum.L > 0) ? others[m] : swave[m];
+        for (long r=0; r<momentum.BWTables.size(); r++) {
+            members.push_back(r);
+        }
+        hasOthers = hasOthers || (momentum.L > 0 && !members.empty());
+    }
+    
+    ENDFNeutronData::Resonance::Xsec xsec =
+    ENDFResonanceGenerateMembers(range, E, swave.data(), tempK);
+    if (range.moments.empty()) {
+        return xsec;
+    }
+    
+    // Free gas broadening of a constant cross section
+    double y = sqrt(range.moments[0].AWRI*E/(CMS::BoltzmannEvK*tempK));
+    double f = (1 + 0.5/(y*y))*erf(y) + exp(-y*y)/(y*sqrt(M_PI)) - 1;
+    xsec.total     += f*xsec.elastic;
+    xsec.elastic   += f*xsec.elastic;
+    xsec.potential += f*xsec.potential;
+    
+    if (hasOthers) {
+        double du = ENDFDopplerWidth(range.moments[0].AWRI, tempK);
+        auto   xs = ENDFResonanceFreeGas(range, E, others.data(), du);
+        xsec.elastic += xs.elastic;
+        xsec.capture += xs.capture;
+        xsec.fission += xs.fission;
+        xsec.total   += xs.total;
+    }
+    return xsec;
+}
+
+// Order of the background polynomials of the window index
+static const long ENDFWindowOrder = 12;
+
+// Number of resonances between the initial bin boundaries
+static const long ENDFWindowBinSize = 16;
+
+// Maximum number of halvings of an initial bin
+static const long ENDFWindowMaxDepth = 20;
+
+// Chebyshev series of order n at t in [-1, 1], Clenshaw's recurrence
+static double ENDFChebyshev(const double* c, long n, double t) {
+    double b0, b1 = 0., b2 = 0.;
+    for (long j=n; j>=1; j--) {
+        b0 = 2*t*b1 - b2 + c[j];
+        b2 = b1;
+        b1 = b0;
+    }
+    return t*b1 - b2 + 0.5*c[0];
+}
+
+// Cross sections with the resonances of the bin of E summed, and the
+// background of the others added to the sums
+static ENDFNeutronData::Resonance::Xsec ENDFResonanceGenerateWindowed
+(const ENDFResonanceRange& range, double E) {
+    auto& index = range.index;
+    auto& edges = index.lnEdges;
+    
+    // Outside the bins, sum all resonances
+    double u = (E > 0.) ? log(E) : -HUGE_VAL;
+    if (u < edges.front() || u > edges.back()) {
+        return ENDFResonanceGenerate(range, E);
+    }
+    long b = std::upper_bound(edges.begin(), edges.end(), u)
+    - edges.begin() - 1;
+    b = std::min(b, long(edges.size()) - 2);
+    auto& bg = index.background[b];
+    if (bg.empty()) {
+        return ENDFResonanceGenerate(range, E);
+    }
+    
+    std::vector<double> sums(index.nsums);
+    ENDFResonanceSum
+    (range, E, &index.members[b*range.moments.size()], sums.data());
+    double t = (2*u - edges[b] - edges[b+1]) / (edges[b+1] - edges[b]);
+    for (long i=0; i<index.nsums; i++) {
+        sums[i] += ENDFChebyshev
+        (&bg[i*(ENDFWindowOrder+1)], ENDFWindowOrder, t);
+    }
+    return ENDFResonanceFinish(range, E, sums.data(), index.counts.data());
+}
+
+void ENDFNeutronData::Resonance::Range::
+indexResonances(double tol, double widths) {
+    
+    if (tol <= 0. || widths <= 0.) {
+        throw std::logic_error("invalid window index parameters!");
+    }
+    
+    index = WindowIndex();
+    if (LRU != 1 || LRF < 1 || LRF > 3 || EL <= 0. || EH <= EL) {
+        return;
+    }
+    
+    // Sorted resonance energies, and the total width of each resonance
+    std::vector<double> energies;
+    std::vector< std::vector<double> > totalWidths(moments.size());
+    for (long m=0; m<moments.size(); m++) {
+        auto& momentum = moments[m];
+        if (LRF == 3) {
+            for (auto& r : momentum.RMTables) {
+                energies.push_back(r.ER);
+                totalWidths[m].push_back
+                (fabs(r.GN) + fabs(r.GG) + fabs(r.GFA) + fabs(r.GFB));
+            }
+        } else {
+            for (auto& r : momentum.BWTables) {
+                energies.push_back(r.ER);
+                totalWidths[m].push_back
+                ((r.GT > 0.) ? r.GT : fabs(r.GN) + fabs(r.GG) + fabs(r.GF));
+            }
+        }
+    }
+    long N = energies.size();
+    if (N <= 4*ENDFWindowBinSize) {
+        return;
+    }
+    std::sort(energies.begin(), energies.end());
+    
+    WindowIndex idx;
+    idx.nsums = ENDFResonanceNumSums(*this);
+    if (LRF == 3) {
+        ENDFResonanceCountLRF3(*this, idx.counts);
+    }
+    
+    // Initial bin boundaries, every few resonances
+    std::vector<double> lnInit(1, log(EL));
+    for (long i=ENDFWindowBinSize; i<N; i+=ENDFWindowBinSize) {
+        if (energies[i] > EL && energies[i] < EH &&
+            log(energies[i]) > lnInit.back()) {
+            lnInit.push_back(log(energies[i]));
+        }
+    }
+    lnInit.push_back(log(EH));
+    idx.lnEdges.push_back(lnInit.front());
+    
+    const long   n  = ENDFWindowOrder;
+    const long   nm = moments.size();
+    const double thres = CMS::zeroThres;
+    std::vector<double> full(idx.nsums), local(idx.nsums);
+    
+    // Whether the fitted cross section is within tolerance
+    auto accurate = [&] (double ref, double fit) -> bool {
+        return fabs(fit - ref) <= 0.5*tol*fabs(ref) + thres;
+    };
+    
+    // Fit the background of the bin [ua, ub], halve it on failure
+    std::function<void(double, double, long)> fitBin;
+    fitBin = [&] (double ua, double ub, long depth) {
+        double Ea = exp(ua), Eb = exp(ub);
+        
+        // The resonances within the window of the bin
+        std::vector< std::vector<long> > members(nm);
+        long nlocal = 0;
+        for (long m=0; m<nm; m++) {
+            auto& momentum = moments[m];
+            long size = (LRF == 3) ?
+            momentum.RMTables.size() : momentum.BWTables.size();
+            for (long r=0; r<size; r++) {
+                double ER = (LRF == 3) ?
+                momentum.RMTables[r].ER : momentum.BWTables[r].ER;
+                double W  = widths*totalWidths[m][r];
+                if (ER >= Ea - W && ER <= Eb + W) {
+                    members[m].push_back(r);
+                    nlocal ++;
+                }
+            }
+        }
+        
+        // Background from the sums at the Chebyshev nodes
+        std::vector<double> bg;
+        if (nlocal < N) {
+            bg.assign(idx.nsums*(n+1), 0.);
+            for (long i=0; i<=n; i++) {
+                double theta = M_PI*(i+0.5)/(n+1);
+                double u = 0.5*(ua+ub) + 0.5*(ub-ua)*cos(theta);
+                double E = exp(u);
+                ENDFResonanceSum(*this, E, nullptr, full.data());
+                ENDFResonanceSum(*this, E, members.data(), local.data());
+                for (long s=0; s<idx.nsums; s++) {
+                    double f = (full[s] - local[s]) * 2./(n+1);
+                    for (long j=0; j<=n; j++) {
+                        bg[s*(n+1) + j] += f*cos(j*theta);
+                    }
+                }
+            }
+            
+            // Check the cross sections between the nodes and at the ends
+            bool passed = true;
+            for (long i=0; i<=n+1 && passed; i++) {
+                double t = cos(M_PI*i/(n+1));
+                double u = 0.5*(ua+ub) + 0.5*(ub-ua)*t;
+                double E = exp(u);
+                ENDFResonanceSum(*this, E, nullptr, full.data());
+                ENDFResonanceSum(*this, E, members.data(), local.data());
+                for (long s=0; s<idx.nsums; s++) {
+                    local[s] += ENDFChebyshev(&bg[s*(n+1)], n, t);
+                }
+                auto ref = ENDFResonanceFinish
+                (*this, E, full.data(), idx.counts.data());
+                auto fit = ENDFResonanceFinish
+                (*this, E, local.data(), idx.counts.data());
+                passed =
+                accurate(ref.total,   fit.total)   &&
+                accurate(ref.elastic, fit.elastic) &&
+                accurate(ref.fission, fit.fission) &&
+                accurate(ref.capture, fit.capture);
+            }
+            if (!passed) {
+                if (depth < ENDFWindowMaxDepth) {
+                    fitBin(ua, 0.5*(ua+ub), depth+1);
+                    fitBin(0.5*(ua+ub), ub, depth+1);
+                    return;
+                }
+                // Sum all resonances in the bin
+                bg.clear();
+            }
+        }
+        
+        idx.lnEdges.push_back(ub);
+        for (auto& mem : members) {
+            idx.members.push_back(std::move(mem));
+        }
+        idx.background.push_back(std::move(bg));
+    };
+    
+    for (long i=0; i+1<lnInit.size(); i++) {
+        fitBin(lnInit[i], lnInit[i+1], 0);
+    }
+    
+    index = std::move(idx);
+}
+
+typedef std::complex<double> ENDFComplex;
+
+// Number of neighbours on each side in the level matrix of a Reich-Moore
+// pole
+static const long ENDFPoleNeighbours = 6;
+
+// Maximum Newton iterations of a pole
+static const long ENDFPoleMaxIterations = 50;
+
+// Determinant of the n x n complex matrix a, LU decomposed in place with
+// partial pivoting
+static ENDFComplex ENDFDeterminant(ENDFComplex* a, long n) {
+    ENDFComplex det = 1.;
+    for (long c=0; c<n; c++) {
+        long pivot = c;
+        for (long r=c+1; r<n; r++) {
+            if (std::abs(a[r*n+c]) > std::abs(a[pivot*n+c])) {
+                pivot = r;
+            }
+        }
+        if (a[pivot*n+c] == 0.) {
+            return 0.;
+        }
+        if (pivot != c) {
+            for (long k=0; k<n; k++) {
+                std::swap(a[c*n+k], a[pivot*n+k]);
+            }
+            det = -det;
+        }
+        det *= a[c*n+c];
+        for (long r=c+1; r<n; r++) {
+            ENDFComplex f = a[r*n+c] / a[c*n+c];
+            for (long k=c+1; k<n; k++) {
+                a[r*n+k] -= f*a[c*n+k];
+            }
+        }
+    }
+    return det;
+}
+
+// Zero of f near E0 by Newton's method, with the derivative by central
+// differences. width is the expected size of Im(E), if the iterations
+// leave the interval of half size bound around E0, E0 is returned
+static ENDFComplex ENDFPoleNewton
+(const std::function<ENDFComplex(ENDFComplex)>& f,
+ ENDFComplex E0, double width, double bound) {
+    ENDFComplex E = E0;
+    for (long it=0; it<ENDFPoleMaxIterations; it++) {
+        double      h  = 1E-5*width;
+        ENDFComplex fE = f(E);
+        ENDFComplex df = (f(E + h) - f(E - h)) / (2*h);
+        if (fE == 0. || df == 0.) {
+            break;
+        }
+        ENDFComplex step = fE / df;
+        E -= step;
+        if (!std::isfinite(E.real()) || !std::isfinite(E.imag()) ||
+            std::abs(E - E0) > bound) {
+            return E0;
+        }
+        if (std::abs(step) <= 1E-13*std::max(std::abs(E), width)) {
+            break;
+        }
+    }
+    return E;
+}
+
+std::vector<ENDFComplex> ENDFNeutronData::Resonance::Range::poles() const {
     
-    I = SPI;
+    std::vector<ENDFComplex> result;
+    if (LRU != 1 || LRF < 1 || LRF > 3) {
+        return result;
+    }
     
-    // Initialize partial cross sections
-    SIGNNI = 0;
-    SIGNGI = 0;
-    SIGNFI = 0;
-    SIGNTI = 0;
+    // The pole in u of the energy pole E, Im(E) < 0
+    auto toU = [] (ENDFComplex E) {
+        return std::conj(std::sqrt(E));
+    };
+    
+    // The channel counts of ENDFResonanceFinishLRF3
+    std::vector<long> counts;
+    if (LRF == 3) {
+        ENDFResonanceCountLRF3(*this, counts);
+    }
+    const long* count = counts.data();
     
+    const ENDFComplex I(0., 1.);
     for (auto& momentum : moments) {
-        A = momentum.AWRI;
-        l = momentum.L;
-        a = 0.123*pow(A, 1.0/3.0)+0.08;
-        k = (2.196771E-3)*A/(A+1)*sqrt(fabs(E));
-        if (NRO == 0) {
-            if (NAPS == 0) {
-                rho     = k * a;
-            } else if (NAPS == 1) {
-                rho     = k *
-                ((momentum.APL==0)?AP:momentum.APL);
-            }
-            rho_hat = k *
-            ((momentum.APL==0)?AP:momentum.APL);
-        } else if (NRO == 1) {
-            if (NAPS == 0) {
-                rho     = k * a;
-            } else if (NAPS == 1) {
-                rho     = k * APE.evaluate(E);
-            } else if (NAPS == 2) {
-                rho     = k * AP;
-            }
-            rho_hat = k * APE.evaluate(E);
-        }
-        SE    = ENDFSLBWShiftFactor(l, rho);
-        PE    = ENDFSLBWPenetrationFactor(l, rho);
-        phi_l = ENDFSLBWPhaseShift(l, rho_hat);
-        P1    = cos(2*phi_l);
-        P2    = sin(2*phi_l);
+        double A = momentum.AWRI;
+        long   l = momentum.L;
+        double c = (2.196771E-3)*A/(A+1);
         
-        // Loop ober possible J values
-        AJMIN = fabs(fabs(I-l)-0.5);
-        AJMAX = I+l+0.5;
-        NUMJ  = lround(AJMAX-AJMIN) + 1;
-        AJC   = AJMIN-1;
+        // The radius of rho at the resonance energy
+        auto radius = [&] (double ER) {
+            double E = (ER != 0.) ? fabs(ER) : 1.;
+            double k, rho, rho_hat;
+            ENDFResonanceRadii(*this, momentum, E, k, rho, rho_hat);
+            return rho/k;
+        };
         
-        if (l != 0 && (l > I-0.5 && l <= I)) {
-            JJL = 0;
-        } else {
-            JJL = 1;
-        }
-        for (long j=0; j<NUMJ; j++) {
-            JJ = j+1;
-            AJC++;
-            gJ = (2*AJC+1)/(2*(2*I+1));
-            
-            // Loop over possible channel spins
-            // KCHANL = 1,2
-            // Channel 1, skip negative, consider positive
-            // Channel 2, skip positive, consider negative
-            for (long KCHANL=1; KCHANL<3; KCHANL++) {
-                KPSTV = 0; // Positive
-                KNGTV = 0; // Negative
-                
-                // Initialize matrix
-                for (long ii=0; ii<3; ii++) {
-                    for (long jj=0; jj<3; jj++) {
-                        S[ii][jj] = 0;
-                        R[ii][jj] = 0;
-                    }
+        if (LRF == 1 || LRF == 2) {
+            for (auto& res : momentum.BWTables) {
+                double a   = radius(res.ER);
+                double rr  = a*c*sqrt(fabs(res.ER));
+                double Pr  = ENDFSLBWPenetrationFactor(l, rr);
+                double Sr  = ENDFSLBWShiftFactor(l, rr);
+                double GX  = res.GG + res.GF;
+                if (momentum.LRX != 0) {
+                    GX = res.GT - res.GN;
                 }
-                for (long ii=0; ii<3; ii++) {
-                    R[ii][ii] = 1;
+                double width = 0.5*(fabs(res.GN) + fabs(GX));
+                ENDFComplex E0(res.ER, -width);
+                if (Pr == 0. || width == 0.) {
+                    result.push_back(toU(E0));
+                    continue;
                 }
                 
-                // Loop over all resonances
-                for (auto& resonance : momentum.RMTables) {
-                    AJPM = resonance.AJ; // Signed quantivity
-                    AJ   = fabs(AJPM);
+                // The level denominator E'r - E - i*G(E)/2
+                auto level = [&] (ENDFComplex E) {
+                    ENDFComplex rho = a*c*std::sqrt(E);
+                    ENDFComplex P   = ENDFSLBWPenetrationFactor(l, rho);
+                    ENDFComplex S   = ENDFSLBWShiftFactor(l, rho);
+                    return res.ER + (Sr - S)*res.GN/(2*Pr) - E -
+                    0.5*I*(res.GN*P/Pr + GX);
+                };
+                double bound = std::max(10*width, 1E-3*fabs(res.ER));
+                result.push_back
+                (toU(ENDFPoleNewton(level, E0, width, bound)));
+            }
+        } else {
+            double AJMIN;
+            long   NUMJ = ENDFResonanceNumJ(SPI, l, AJMIN);
+            for (long j=0; j<NUMJ; j++) {
+                for (long KCHANL=1; KCHANL<3; KCHANL++) {
+                    long KNGTV = count[1];
+                    long IFIS  = count[2];
+                    count += 3;
                     
-                    // Select only resonances with current J value
-                    if (fabs(AJ-AJC) <= 0.01) {
-                        if (AJPM < 0) {
-                            KNGTV ++;
-                        } else if (AJPM > 0) {
-                            KPSTV ++;
-                        }
-                        if (KCHANL == 1 && AJPM < 0) {
-                            ISKIP = 1;
-                        } else if (KCHANL == 2 && AJPM >0) {
-                            ISKIP = 1;
-                        } else {
-                            ISKIP = 0;
-                        }
-                        
-                        // Process resonance
-                        
-                        if (ISKIP == 0) {
-                            ER      = resonance.ER;
-                            kr      =
-                            (2.196771E-3)*A/(A+1)*
-                            sqrt(fabs(ER));
-                            rho_max = rho/k*kr;
-                            GN      = resonance.GN;
-                            GG      = resonance.GG;
-                            GF      = resonance.GFA;
-                            PER     =
-                            ENDFSLBWPenetrationFactor
-                            (l, rho_max);
-                            GC      = resonance.GFB;
-                            A1      = sqrt(GN*PE/PER);
-                            if (GF != 0) {
-                                A2  = sqrt(fabs(GF));
-                                if (GF < 0) A2=-A2;
-                            } else {
-                                A2  = 0;
-                            }
-                            if (GC != 0) {
-                                A3  = sqrt(fabs(GC));
-                                if (GC < 0) A3=-A3;
-                            } else {
-                                A3  = 0;
-                            }
-                            DIFF = ER - E;
-                            DEN  = DIFF*DIFF + 0.25*GG*GG;
-                            DE2  = 0.5*DIFF/DEN;
-                            GG4  = 0.25*GG/DEN;
-                            if (GF == 0 && GC == 0) {
-                                IFIS = 0;
-                            } else {
-                                IFIS = 1;
-                            }
-                            
-                            // Calculate upper triangular matrix terms
-                            R[0][0] += GG4*A1*A1;
-                            S[0][0] -= DE2*A1*A1;
-                            // Check whether contains fission channels
-                            if (IFIS > 0) {
-                                R[0][1] += GG4*A1*A2;
-                                S[0][1] -= DE2*A1*A2;
-                                R[0][2] += GG4*A1*A3;
-                                S[0][2] -= DE2*A1*A3;
-                                R[1][1] += GG4*A2*A2;
-                                S[1][1] -= DE2*A2*A2;
-                                R[2][2] += GG4*A3*A3;
-                                S[2][2] -= DE2*A3*A3;
-                                R[1][2] += GG4*A2*A3;
-                                S[1][2] -= DE2*A2*A3;
-                            }
-                        }
-                        
+                    // Skip the channels without cross sections
+                    if ((KCHANL == 1 && KNGTV > 0) ||
+                        (KCHANL == 2 && KNGTV == 0)) {
+                        continue;
                     }
-                }
-                
-                // Number of potential scatterings
-                KKKKKK = 0;
-                if (KCHANL == 1) {
-                    if (KPSTV > 0) {
-                        if (KNGTV == 0) {
-                            if (JJ > JJL && JJ < NUMJ) {
-                                KKKKKK = 2;
-                            } else {
-                                KKKKKK = 1;
-                            }
-                        } else if (KNGTV > 0) {
-                            KKKKKK = 0;
+                    
+                    // The resonances of the spin group, by energy
+                    std::vector<const ReichMoore*> group;
+                    for (auto& res : momentum.RMTables) {
+                        double AJ   = fabs(res.AJ);
+                        long   mask = (res.AJ > 0) ? 1 :
+                        ((res.AJ < 0) ? 2 : 3);
+                        if (lround(AJ-AJMIN) == j &&
+                            fabs(AJ-(AJMIN+j)) <= 0.01 &&
+                            (mask & KCHANL)) {
+                            group.push_back(&res);
                         }
-                    } else if (KPSTV == 0) {
-                        if (KNGTV == 0) {
-                            if (JJ > JJL && JJ < NUMJ) {
-                                KKKKKK = 2;
-                            } else {
-                                KKKKKK = 1;
-                            }
-                        } else if (KNGTV > 0) {
-                            KKKKKK = 0;
+                    }
+                    std::stable_sort
+                    (group.begin(), group.end(),
+                     [] (const ReichMoore* a, const ReichMoore* b) {
+                        return a->ER < b->ER;
+                    });
+                    
+                    // Channel amplitudes, the neutron one without the
+                    // penetration at E, the fission ones only if the
+                    // channel has fission
+                    long n = group.size();
+                    std::vector<double> A1(n), A2(n), A3(n);
+                    for (long r=0; r<n; r++) {
+                        auto& res = *group[r];
+                        double PER = ENDFSLBWPenetrationFactor
+                        (l, radius(res.ER)*c*sqrt(fabs(res.ER)));
+                        A1[r] = (PER > 0.) ? sqrt(fabs(res.GN)/PER) : 0.;
+                        if (IFIS != 0) {
+                            A2[r] = (res.GFA < 0) ?
+                            -sqrt(fabs(res.GFA)) : sqrt(fabs(res.GFA));
+                            A3[r] = (res.GFB < 0) ?
+                            -sqrt(fabs(res.GFB)) : sqrt(fabs(res.GFB));
                         }
                     }
-                }else if (KCHANL == 2) {
-                    if (KPSTV > 0) {
-                        if (KNGTV > 0) {
-                            KKKKKK = 1;
+                    
+                    for (long r=0; r<n; r++) {
+                        auto&  res   = *group[r];
+                        long   b     = std::max(0L, r - ENDFPoleNeighbours);
+                        long   e     = std::min(n, r + ENDFPoleNeighbours + 1);
+                        long   m     = e - b;
+                        double a     = radius(res.ER);
+                        double width = 0.5*(fabs(res.GG) + fabs(res.GN) +
+                                            A2[r]*A2[r] + A3[r]*A3[r]);
+                        ENDFComplex E0(res.ER, -width);
+                        if (width == 0.) {
+                            result.push_back(toU(E0));
+                            continue;
                         }
-                    } else if (KPSTV == 0) {
-                        if (KNGTV > 0) {
-                            if (JJ > JJL && JJ < NUMJ) {
-                                KKKKKK = 2;
-                            } else {
-                                KKKKKK = 1;
+                        
+                        // Determinant of the level matrix
+                        std::vector<ENDFComplex> mat(m*m);
+                        auto level = [&] (ENDFComplex E) {
+                            ENDFComplex P = ENDFSLBWPenetrationFactor
+                            (l, a*c*std::sqrt(E));
+                            for (long p=0; p<m; p++) {
+                                for (long q=0; q<m; q++) {
+                                    long u = b+p, v = b+q;
+                                    mat[p*m+q] = -0.5*I*
+                                    (A1[u]*A1[v]*P + A2[u]*A2[v] +
+                                     A3[u]*A3[v]);
+                                }
+                                mat[p*m+p] += group[b+p]->ER - E -
+                                0.5*I*group[b+p]->GG;
                             }
+                            return ENDFDeterminant(mat.data(), m);
+                        };
+                        
+                        // Keep the pole closer to its resonance than to
+                        // the neighbours
+                        double bound = 10*width;
+                        if (r > 0) {
+                            bound = std::min
+                            (bound, 0.5*(res.ER - group[r-1]->ER));
                         }
+                        if (r+1 < n) {
+                            bound = std::min
+                            (bound, 0.5*(group[r+1]->ER - res.ER));
+                        }
+                        bound = std::max(bound, width);
+                        result.push_back
+                        (toU(ENDFPoleNewton(level, E0, width, bound)));
                     }
                 }
-                
-                // Prepare to calculate the cross section
-                if (KKKKKK != 0) {
-                    if (IFIS == 0) {
-                        // Special case of no fission
-                        DEN      = R[0][0]*R[0][0] + S[0][0]*S[0][0];
-                        RI[0][0] = R[0][0]/DEN;
-                        SI[0][0] = -S[0][0]/DEN;
-                    } else {
-                        // Make symmetric marix
-                        R[1][0] = R[0][1];
-                        S[1][0] = S[0][1];
-                        R[2][0] = R[0][2];
-                        S[2][0] = S[0][2];
-                        R[2][1] = R[1][2];
-                        S[2][1] = S[1][2];
-                        // Invert the complex matrix
-                        ENDFFROBNS(R, S, RI, SI, 3);
-                    }
-                    
-                    // Calculate the cross sections
-                    U11R  = P1*(2*RI[0][0]-1) + 2*P2*SI[0][0];
-                    U11I  = P2*(1-2*RI[0][0]) + 2*P1*SI[0][0];
-                    TERMT = 2*gJ*(1-U11R);
-                    TERMN = gJ*(ENDFSqr(1-U11R) + ENDFSqr(U11I));
-                    // Add potential scattering
-                    if (KKKKKK == 2) {
-                        TERMN += 2*gJ*(1-P1);
-                        TERMT += 2*gJ*(1-P1);
-                    }
-                    if (IFIS == 0) {
-                        TERMF = 0;
-                    } else {
-                        T1    = RI[0][1];
-                        T2    = SI[0][1];
-                        T3    = RI[0][2];
-                        T4    = SI[0][2];
-                        TERMF = 4*gJ*(T1*T1+T2*T2+T3*T3+T4*T4);
-                    }
-                    TERMG  = TERMT-TERMF-TERMN;
-                    SIGNNI += TERMN*M_PI/(k*k);
-                    SIGNGI += TERMG*M_PI/(k*k);
-                    SIGNFI += TERMF*M_PI/(k*k);
-                    SIGNTI += TERMT*M_PI/(k*k);
-                }
             }
         }
     }
     
-    // Calculate cross section and store for return
-    xsec.total   = SIGNTI;
-    xsec.elastic = SIGNNI;
-    xsec.fission = SIGNFI;
-    xsec.capture = SIGNGI;
-    
+    return result;
+}
+
+ENDFNeutronData::Resonance::Xsec
+ENDFNeutronData::Resonance::Range::
+generateLRU1LRF1(double E) const {
+    // Implementation of Resonance reconstruction of SLBW representation
+    return ENDFResonanceGenerate(*this, E);
+}
+
+ENDFNeutronData::Resonance::Xsec
+ENDFNeutronData::Resonance::Range::
+generateLRU1LRF2(double E) const {
+    // Implementation of Resonance reconstruction of MLBW representation
+    return ENDFResonanceGenerate(*this, E);
+}
+
+ENDFNeutronData::Resonance::Xsec
+ENDFNeutronData::Resonance::Range::
+generateLRU1LRF3(double E) const {
+    // Implementation of Resonance reconstruction of RM representation
+    return ENDFResonanceGenerate(*this, E);
+}
+
+ENDFNeutronData::Resonance::Xsec
+ENDFNeutronData::Resonance::Range::
+generateLRU1LRF7(double E) const {
+    // Implementation of Resonance reconstruction of RML representation
+    Xsec xsec;
+    if (E <= 0.) {
+        return xsec;
+    }
+    if (compiled.valid()) {
+        ENDFRMLBlock<1>(*this, &E, &xsec);
+    } else {
+        // Unsupported parameters throw here
+        Range range = *this;
+        ENDFCompileLRF7(range, range.compiled);
+        ENDFRMLBlock<1>(range, &E, &xsec);
+    }
     return xsec;
 }
 
@@ -2066,43 +4289,51 @@ generateLRU1LRF4(double E) const {
     AC1 + AC2/E + AC3/(E*E) +
     AC4/(E*E*E) + BC1*E + BC2*E*E;
     
-    for (auto& momentum : moments) {
-        l = momentum.L;
-        if (l != 0) continue; // Consider only L=0 case
-        
-        for (auto& spin : momentum.AATables) {
-            J = spin.AJ;
+    if (compiled.valid()) {
+        double acc[4];
+        ENDFCompiledSumAA(compiled, E, acc);
+        xsec.total   = cos(2*phi_0)*acc[0] + sin(2*phi_0)*acc[1];
+        xsec.fission = acc[2];
+        xsec.capture = acc[3];
+    } else {
+        for (auto& momentum : moments) {
+            l = momentum.L;
+            if (l != 0) continue; // Consider only L=0 case
             
-            for (auto& resonance : spin.coefficients) {
-                muT_r = resonance.DET;
-                muF_r = resonance.DEF;
-                muC_r = resonance.DEC;
-                nuT_r = resonance.DWT;
-                nuF_r = resonance.DWF;
-                nuC_r = resonance.DWC;
-                GT_r  = resonance.GRT;
-                GF_r  = resonance.GRF;
-                GC_r  = resonance.GRC;
-                HT_r  = resonance.GIT;
-                HF_r  = resonance.GIF;
-                HC_r  = resonance.GIC;
-                // Total
-                x     = (muT_r - E)/nuT_r;
-                psi   = ENDFSLBWPsi0(x);
-                chi   = ENDFSLBWChi0(x);
-                xsec.total += 1/nuT_r*
-                ((GT_r*cos(2*phi_0)+HT_r*sin(2*phi_0))*psi
-                 +(HT_r*cos(2*phi_0)-GT_r*sin(2*phi_0))*chi);
-                // Fission
-                x     = (muF_r - E)/nuF_r;
-                psi   = ENDFSLBWPsi0(x);
-                chi   = ENDFSLBWChi0(x);
-                xsec.fission += 1/nuF_r*(GF_r*psi+HT_r*chi);
-                // Capture
-                x     = (muC_r - E)/nuC_r;
-                psi   = ENDFSLBWPsi0(x);
-                chi   = ENDFSLBWChi0(x);
-                xsec.capture += 1/nuC_r*(GC_r*psi+HC_r*chi);
+            for (auto& spin : momentum.AATables) {
+                J = spin.AJ;
+                
+                for (auto& resonance : spin.coefficients) {
+                    muT_r = resonance.DET;
+                    muF_r = resonance.DEF;
+                    muC_r = resonance.DEC;
+                    nuT_r = resonance.DWT;
+                    nuF_r = resonance.DWF;
+                    nuC_r = resonance.DWC;
+                    GT_r  = resonance.GRT;
+                    GF_r  = resonance.GRF;
+                    GC_r  = resonance.GRC;
+                    HT_r  = resonance.GIT;
+                    HF_r  = resonance.GIF;
+                    HC_r  = resonance.GIC;
+                    // Total
+                    x     = (muT_r - E)/nuT_r;
+                    psi   = ENDFSLBWPsi0(x);
+                    chi   = ENDFSLBWChi0(x);
+                    xsec.total += 1/nuT_r*
+                    ((GT_r*cos(2*phi_0)+HT_r*sin(2*phi_0))*psi
+                     +(HT_r*cos(2*phi_0)-GT_r*sin(2*phi_0))*chi);
+                    // Fission
+                    x     = (muF_r - E)/nuF_r;
+                    psi   = ENDFSLBWPsi0(x);
+                    chi   = ENDFSLBWChi0(x);
+                    xsec.fission += 1/nuF_r*(GF_r*psi+HF_r*chi);
+                    // Capture
+                    x     = (muC_r - E)/nuC_r;
+                    psi   = ENDFSLBWPsi0(x);
+                    chi   = ENDFSLBWChi0(x);
+                    xsec.capture += 1/nuC_r*(GC_r*psi+HC_r*chi);
+                }
             }
         }
     }
@@ -2125,7 +4356,7 @@ generateLRU1LRF4(double E) const {
         xsec.fission + xsec.capture;
     }
     
-    return ENDFNeutronData::Resonance::Xsec();
+    return xsec;
 }
 
 ENDFNeutronData::Resonance::Xsec
@@ -2374,7 +4605,7 @@ generateLRU2LRF2(double E, long LFW) const {
     auto& records = moments[0].URRTables.ctable[0].records;
     
     ES.resize(records.size());
-    for (long i=0; i<records.size();) {
+    for (long i=0; i<records.size(); i++) {
         ES[i] = records[i].ES;
     }
     INTT = moments[0].URRTables.ctable[0].INT;
@@ -2511,13 +4742,157 @@ generateLRU2LRF2(double E, long LFW) const {
     xsec.total = xsec.elastic +
     xsec.fission + xsec.capture;
     
-    return ENDFNeutronData::Resonance::Xsec();
+    return xsec;
+}
+
+double ENDFNeutronData::Resonance::Range::
+sequences(double E, long LFW, std::vector<Sequence>& seqs) const {
+    
+    seqs.clear();
+    double SPOT = 0.;
+    if (LRU != 2) {
+        return SPOT;
+    }
+    
+    // Interpolate y given at the energies X
+    auto interpolate =
+    [E] (const std::vector<double>& X, const std::vector<double>& Y,
+         long INTT) {
+        std::vector<double> EG(2,0);
+        long NUME = 1, IDG = -1;
+        EG[0] = E;
+        ENDFFINDE(E, X, EG, NUME, IDG);
+        if (NUME == 1) {
+            return Y[IDG];
+        }
+        double y;
+        ENDFTERP1(EG[0], Y[IDG], EG[1], Y[IDG+1], E, y, INTT);
+        return y;
+    };
+    
+    double ER2 = sqrt(E);
+    for (auto& momentum : moments) {
+        long   LL  = momentum.L;
+        double RAT = momentum.AWRI/(momentum.AWRI+1);
+        double K   = 2.196771E-3*RAT*ER2;
+        double a   = 0.123*pow(momentum.AWRI, 1.0/3.0)+0.08;
+        double A = 0, AA = 0;
+        // Retrieve nuclide information
+        if (NRO == 0) {
+            if (NAPS == 0) {
+                AA = a;
+                A  = AP;
+            } else if (NAPS == 1) {
+                AA = AP;
+                A  = AP;
+            }
+        } else if (NRO == 1) {
+            if (NAPS == 0) {
+                AA = a;
+                A  = APE.evaluate(E);
+            } else if (NAPS == 1) {
+                AA = APE.evaluate(E);
+                A  = APE.evaluate(E);
+            } else if (NAPS == 2) {
+                AA =  AP;
+                A  = APE.evaluate(E);
+            }
+        }
+        double RHO  = K*AA;
+        double PS   = ENDFSLBWPhaseShift(LL, K*A);
+        SPOT += 4*M_PI*(2*LL+1)*ENDFSqr(sin(PS)/K);
+        // Penetrability without the degrees of freedom
+        double VL = ENDFSLBWPenetrationFactor(LL, RHO)/RHO*ER2;
+        
+        Sequence seq;
+        seq.L    = LL;
+        seq.AWRI = momentum.AWRI;
+        seq.K    = K;
+        seq.PS   = PS;
+        auto& tables = momentum.URRTables;
+        if (LRF == 1 && LFW == 0) {
+            for (auto& table : tables.atable) {
+                seq.GJ   = (2*table.AJ+1)/(4*SPI+2);
+                seq.D    = table.D;
+                seq.AMUN = table.AMUN;
+                seq.GN   = table.GNO*VL*table.AMUN;
+                seq.GG   = table.GG;
+                seqs.push_back(seq);
+            }
+        } else if (LRF == 1) {
+            for (auto& table : tables.btable) {
+                seq.GJ   = (2*table.AJ+1)/(4*SPI+2);
+                seq.D    = table.D;
+                seq.AMUN = table.AMUN;
+                seq.GN   = table.GNO*VL*table.AMUN;
+                seq.GG   = table.GG;
+                seq.AMUF = table.MUF;
+                seq.GF   = interpolate(URRBES, table.GF, 2);
+                seqs.push_back(seq);
+            }
+        } else if (LRF == 2) {
+            for (auto& table : tables.ctable) {
+                std::vector<double> ES, D, GX, GNO, GG, GF;
+                for (auto& record : table.records) {
+                    ES.push_back(record.ES);
+                    D.push_back(record.D);
+                    GX.push_back(record.GX);
+                    GNO.push_back(record.GNO);
+                    GG.push_back(record.GG);
+                    GF.push_back(record.GF);
+                }
+                seq.GJ   = (2*table.AJ+1)/(4*SPI+2);
+                seq.D    = interpolate(ES, D, table.INT);
+                seq.AMUN = table.AMUN;
+                seq.AMUG = table.AMUG;
+                seq.AMUF = table.AMUF;
+                seq.AMUX = table.AMUX;
+                seq.GN   = interpolate(ES, GNO, table.INT)*VL*table.AMUN;
+                seq.GG   = interpolate(ES, GG, table.INT);
+                seq.GF   = interpolate(ES, GF, table.INT);
+                seq.GX   = interpolate(ES, GX, table.INT);
+                seqs.push_back(seq);
+            }
+        }
+    }
+    
+    return SPOT;
+}
+
+std::vector<double>
+ENDFNeutronData::Resonance::Range::parameterEnergies(long LFW) const {
+    
+    std::vector<double> energies;
+    if (LRU != 2) {
+        return energies;
+    }
+    if (LRF == 1 && LFW != 0) {
+        energies = URRBES;
+    } else if (LRF == 2) {
+        for (auto& momentum : moments) {
+            for (auto& table : momentum.URRTables.ctable) {
+                for (auto& record : table.records) {
+                    energies.push_back(record.ES);
+                }
+            }
+        }
+    }
+    energies.erase
+    (std::remove_if(energies.begin(), energies.end(),
+                    [this] (double e) {return e < EL || e > EH;}),
+     energies.end());
+    std::sort(energies.begin(), energies.end());
+    energies.erase
+    (std::unique(energies.begin(), energies.end()), energies.end());
+    return energies;
 }
 
 ENDFNeutronData::Resonance::Xsec
 ENDFNeutronData::Resonance::Range::generate(double E, long LFW) const {
     if (LRU == 1) {
-        if (LRF == 1) {
+        if (index.valid()) {
+            return ENDFResonanceGenerateWindowed(*this, E);
+        } else if (LRF == 1) {
             return generateLRU1LRF1(E);
         } else if (LRF == 2) {
             return generateLRU1LRF2(E);
@@ -2525,6 +4900,8 @@ ENDFNeutronData::Resonance::Range::generate(double E, long LFW) const {
             return generateLRU1LRF3(E);
         } else if (LRF == 4) {
             return generateLRU1LRF4(E);
+        } else if (LRF == 7) {
+            return generateLRU1LRF7(E);
         } else {
             throw std::logic_error("unsupport LRF for LRU = 1");
         }
@@ -2541,5 +4918,72 @@ ENDFNeutronData::Resonance::Range::generate(double E, long LFW) const {
     }
 }
 
+ENDFNeutronData::Resonance::Xsec
+ENDFNeutronData::Resonance::Range::
+generate(double E, long LFW, double tempK) const {
+    if (tempK <= 0. || LRU != 1) {
+        return generate(E, LFW);
+    }
+    return ENDFResonanceGenerateBroadened(*this, E, tempK);
+}
+
+void ENDFNeutronData::Resonance::Range::
+generate(const double* E, long n, long LFW, Xsec* xsec) const {
+    
+    // The block kernels cover the compiled LRF=7 ranges and compiled
+    // LRF=1,2,3 ranges summing all resonances, the others are evaluated
+    // point by point
+    if (LRU == 1 && LRF == 7 && compiled.valid()) {
+        double block[ENDFLanes];
+        Xsec out[ENDFLanes];
+        for (long i=0; i<n; i+=ENDFLanes) {
+            long nb = std::min(ENDFLanes, n - i);
+            for (long l=0; l<ENDFLanes; l++) {
+                block[l] = E[i + std::min(l, nb - 1)];
+            }
+            ENDFRMLBlock<ENDFLanes>(*this, block, out);
+            for (long l=0; l<nb; l++) {
+                xsec[i+l] = out[l];
+            }
+        }
+        return;
+    }
+    if (LRU != 1 || LRF < 1 || LRF > 3 ||
+        !compiled.valid() || index.valid()) {
+        for (long i=0; i<n; i++) {
+            xsec[i] = generate(E[i], LFW);
+        }
+        return;
+    }
+    
+    // Layout of the sums, shared by all blocks
+    std::vector<long> offsets(moments.size() + 1, 0);
+    std::vector<long> numj(moments.size());
+    for (long m=0; m<moments.size(); m++) {
+        double AJMIN;
+        numj[m] = ENDFResonanceNumJ(SPI, moments[m].L, AJMIN);
+        long ns = (LRF == 1) ? 5 :
+        ((LRF == 2) ? 2 + 2*numj[m] : 24*numj[m]);
+        offsets[m+1] = offsets[m] + ns;
+    }
+    long nsums = offsets.back();
+    std::vector<double> sums(ENDFLanes*nsums);
+    
+    // The last block is padded with its last energy
+    double block[ENDFLanes];
+    for (long i=0; i<n; i+=ENDFLanes) {
+        long nb = std::min(ENDFLanes, n - i);
+        for (long l=0; l<ENDFLanes; l++) {
+            block[l] = E[i + std::min(l, nb - 1)];
+        }
+        ENDFCompiledSumBlock
+        (*this, block, offsets.data(), numj.data(), sums.data());
+        for (long l=0; l<nb; l++) {
+            xsec[i+l] = ENDFResonanceFinish
+            (*this, block[l], &sums[l*nsums], compiled.counts.data());
+        }
+    }
+}
+
 //} // End of namespace ibhe
 //} // End of namespace com
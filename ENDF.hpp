@@ -25,6 +25,7 @@
 #ifndef ENDF_HPP
 #define ENDF_HPP
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
@@ -33,6 +34,8 @@
 #include <cmath>
 #include <map>
 #include <fstream>
+#include <new>
+#include <stdexcept>
 
 #include "NRS.hpp"
 #include "CMS.hpp"
@@ -261,10 +264,522 @@ struct ENDFEmpty {
     void clear() {}
 };
 
+// Allocator of arrays aligned to 64 bytes, a cache line and an AVX-512
+// register, so the columns of the SoA storage load in whole vectors.
+// Without aligned new (before C++17) it falls back to std::allocator,
+// which only aligns to alignof(V): the columns stay correct, they only
+// lose the whole vector loads
+template <typename V>
+struct ENDFAlignedAllocator {
+    typedef V value_type;
+    
+    static const size_t alignment = 64;
+    
+    ENDFAlignedAllocator() {}
+    
+    template <typename U>
+    ENDFAlignedAllocator(const ENDFAlignedAllocator<U>&) {}
+    
+    V* allocate(size_t n) {
+#if defined(__cpp_aligned_new)
+        return static_cast<V*>
+        (::operator new(n * sizeof(V), std::align_val_t(alignment)));
+#else
+        return std::allocator<V>().allocate(n);
+#endif
+    }
+    
+    void deallocate(V* p, size_t n) {
+#if defined(__cpp_aligned_new)
+        ::operator delete(p, n * sizeof(V), std::align_val_t(alignment));
+#else
+        std::allocator<V>().deallocate(p, n);
+#endif
+    }
+    
+    template <typename U>
+    bool operator==(const ENDFAlignedAllocator<U>&) const {
+        return true;
+    }
+    
+    template <typename U>
+    bool operator!=(const ENDFAlignedAllocator<U>&) const {
+        return false;
+    }
+};
+
+template <typename V>
+using ENDFAlignedVector = std::vector< V, ENDFAlignedAllocator<V> >;
+
+// The y columns of the SoA storage. By default y is kept whole in one
+// column. A specialization may split the fields of T into columns of
+// their own, with Ref and ConstRef giving access to the fields of one
+// point by reference, see CFSMainRxnDataPoint
+template <typename T>
+struct ENDFSoAColumns {
+    typedef T&       Ref;
+    typedef const T& ConstRef;
+    
+    ENDFAlignedVector<T> y;
+    
+    void clear() {
+        y.clear();
+    }
+    
+    void resize(size_t n) {
+        y.resize(n);
+    }
+    
+    void reserve(size_t n) {
+        y.reserve(n);
+    }
+    
+    void push_back(const T& v) {
+        y.push_back(v);
+    }
+    
+    Ref ref(size_t i) {
+        return y[i];
+    }
+    
+    ConstRef ref(size_t i) const {
+        return y[i];
+    }
+};
+
+// A data point of the SoA storage by reference, with x and y as the
+// members of ENDFObjectDataPoint. Assignment writes through
+template <typename T>
+struct ENDFSoARef {
+    double& x;
+    typename ENDFSoAColumns<T>::Ref y;
+    
+    ENDFSoARef(double& _x, typename ENDFSoAColumns<T>::Ref _y)
+    : x(_x), y(_y) {}
+    
+    ENDFSoARef& operator=(const ENDFObjectDataPoint<T>& d) {
+        x = d.x;
+        y = d.y;
+        return *this;
+    }
+    
+    ENDFSoARef& operator=(const ENDFSoARef& d) {
+        return *this = ENDFObjectDataPoint<T>(d);
+    }
+    
+    operator ENDFObjectDataPoint<T>() const {
+        return ENDFObjectDataPoint<T>(x, y);
+    }
+};
+
+template <typename T>
+struct ENDFSoAConstRef {
+    const double& x;
+    typename ENDFSoAColumns<T>::ConstRef y;
+    
+    ENDFSoAConstRef
+    (const double& _x, typename ENDFSoAColumns<T>::ConstRef _y)
+    : x(_x), y(_y) {}
+    
+    operator ENDFObjectDataPoint<T>() const {
+        return ENDFObjectDataPoint<T>(x, y);
+    }
+};
+
+// Iterator over the points of the SoA storage, dereferenced to a point
+// by reference
+template <typename V, typename R>
+struct ENDFSoAIterator {
+    V*   v;
+    long i;
+    
+    R operator*() const {
+        return (*v)[i];
+    }
+    
+    ENDFSoAIterator& operator++() {
+        i++;
+        return *this;
+    }
+    
+    bool operator==(const ENDFSoAIterator& o) const {
+        return i == o.i;
+    }
+    
+    bool operator!=(const ENDFSoAIterator& o) const {
+        return i != o.i;
+    }
+};
+
+// Structure of arrays storage of the data points, x in one contiguous
+// aligned array and y in the columns of ENDFSoAColumns, so a search
+// only loads the x values. It has the interface of the vector of
+// ENDFObjectDataPoint used by ENDFObjectInterpolationFunction, but a
+// point is accessed by value through ENDFSoARef, so it binds to auto
+// or auto&& instead of auto&
+template <typename T>
+class ENDFSoAVector {
+    
+    ENDFAlignedVector<double> _x;
+    ENDFSoAColumns<T>         _y;
+    
+public:
+    
+    typedef ENDFObjectDataPoint<T> value_type;
+    typedef ENDFSoARef<T>          reference;
+    typedef ENDFSoAConstRef<T>     const_reference;
+    typedef ENDFSoAIterator<ENDFSoAVector, reference>       iterator;
+    typedef ENDFSoAIterator<const ENDFSoAVector, const_reference>
+    const_iterator;
+    
+    ENDFSoAVector() {}
+    
+    explicit ENDFSoAVector(size_t n) {
+        resize(n);
+    }
+    
+    // From the interleaved points
+    ENDFSoAVector(const std::vector<value_type>& data) {
+        reserve(data.size());
+        for (auto& d : data) {
+            push_back(d);
+        }
+    }
+    
+    size_t size() const {
+        return _x.size();
+    }
+    
+    bool empty() const {
+        return _x.empty();
+    }
+    
+    void clear() {
+        _x.clear();
+        _y.clear();
+    }
+    
+    void resize(size_t n) {
+        _x.resize(n, 0.);
+        _y.resize(n);
+    }
+    
+    void reserve(size_t n) {
+        _x.reserve(n);
+        _y.reserve(n);
+    }
+    
+    void push_back(const value_type& d) {
+        _x.push_back(d.x);
+        _y.push_back(d.y);
+    }
+    
+    reference operator[](size_t i) {
+        return reference(_x[i], _y.ref(i));
+    }
+    
+    const_reference operator[](size_t i) const {
+        return const_reference(_x[i], _y.ref(i));
+    }
+    
+    reference at(size_t i) {
+        if (i >= size()) {
+            throw std::out_of_range("SoA data point out of range!");
+        }
+        return (*this)[i];
+    }
+    
+    const_reference at(size_t i) const {
+        if (i >= size()) {
+            throw std::out_of_range("SoA data point out of range!");
+        }
+        return (*this)[i];
+    }
+    
+    reference front() {
+        return (*this)[0];
+    }
+    
+    const_reference front() const {
+        return (*this)[0];
+    }
+    
+    reference back() {
+        return (*this)[size()-1];
+    }
+    
+    const_reference back() const {
+        return (*this)[size()-1];
+    }
+    
+    iterator begin() {
+        return iterator{this, 0};
+    }
+    
+    iterator end() {
+        return iterator{this, (long)size()};
+    }
+    
+    const_iterator begin() const {
+        return const_iterator{this, 0};
+    }
+    
+    const_iterator end() const {
+        return const_iterator{this, (long)size()};
+    }
+    
+    // The x column
+    const double* xs() const {
+        return _x.data();
+    }
+    
+    // The y columns
+    const ENDFSoAColumns<T>& ys() const {
+        return _y;
+    }
+    
+};
+
+// Storage policies of the data points of ENDFObjectInterpolationFunction,
+// Container<T> is the container of ENDFObjectDataPoint<T>
+struct ENDFAoSStorage {
+    template <typename T>
+    using Container = std::vector< ENDFObjectDataPoint<T> >;
+};
+
+struct ENDFSoAStorage {
+    template <typename T>
+    using Container = ENDFSoAVector<T>;
+};
+
+// Search policies of the tabulated functions. locate(data, x) gives the
+// interval i with data[i].x <= x < data[i+1].x, clamped to the first and
+// the last interval, the same as ENDFTabLocateIdx. A policy with its own
+// structure builds it by build(data) and falls back to the binary search
+// until then
+
+// Binary search over the data points
+struct ENDFBinarySearch {
+    
+    void clear() {}
+    
+    template <typename C>
+    void build(const C&) {}
+    
+    template <typename C>
+    long locate(const C& data, double x) const {
+        long i = 0;
+        long j = (long)data.size() - 1;
+        // Binary search
+        while ( i + 1 < j ) {
+            long m = ( i + j )/2;
+            
+            if (x >= data[m].x) {
+                i = m;
+            } else {
+                j = m;
+            }
+        }
+        return i;
+    }
+    
+};
+
+// Eytzinger layout of the x values, a contiguous copy in the breadth
+// first order of a complete binary tree, node k has the children 2k and
+// 2k+1. The search is branch free, so it does not depend on the
+// branch predictor, and the nodes four levels down are prefetched, so
+// the cache misses of the top levels overlap
+struct ENDFEytzingerSearch {
+    
+    // The x values of the nodes 1 .. n, node 0 is unused
+    std::vector<double> tree;
+    
+    // The data index of every node
+    std::vector<long>   index;
+    
+    void clear() {
+        tree.clear();
+        index.clear();
+    }
+    
+    template <typename C>
+    void build(const C& data) {
+        long n = data.size();
+        tree.assign(n + 1, 0.);
+        index.assign(n + 1, 0);
+        long i = 0;
+        fill(data, i, 1);
+    }
+    
+    template <typename C>
+    long locate(const C& data, double x) const {
+        long n = (long)tree.size() - 1;
+        if (n != (long)data.size() || n < 2) {
+            return ENDFBinarySearch().locate(data, x);
+        }
+        const double* t = tree.data();
+        long k = 1;
+        while (k <= n) {
+#if defined(__GNUC__)
+            __builtin_prefetch(t + 16*k);
+#endif
+            k = 2*k + (t[k] <= x);
+        }
+        // Back to the first node above x, 0 if there is none
+        k >>= trailingOnes(k) + 1;
+        long i = (k == 0 ? n : index[k]) - 1;
+        return std::max(0L, std::min(i, n - 2));
+    }
+    
+private:
+    
+    // Number of trailing one bits
+    static long trailingOnes(long k) {
+#if defined(__GNUC__)
+        return __builtin_ctzl(~static_cast<unsigned long>(k));
+#else
+        long c = 0;
+        while (k & 1) {
+            k >>= 1;
+            c++;
+        }
+        return c;
+#endif
+    }
+    
+    // In order traversal gives the sorted order
+    template <typename C>
+    void fill(const C& data, long& i, long k) {
+        if (k >= (long)tree.size()) {
+            return;
+        }
+        fill(data, i, 2*k);
+        tree[k]  = data[i].x;
+        index[k] = i++;
+        fill(data, i, 2*k + 1);
+    }
+    
+};
+
+// Cursor of a sequence of lookups at nearby x, such as the energies of
+// a slowing down history or of a sweep. It keeps the interval of the
+// last lookup, from which the next lookup gallops. The hint is checked
+// against the data, so one cursor may be shared by all functions on the
+// same grid, and is only slower, never wrong, on other grids
+struct ENDFCursor {
+    
+    // The interval of the last lookup
+    long i = 0;
+    
+    // Doublings of the gallop step before giving up to the full search
+    static const long maxSteps = 6;
+    
+    void reset() {
+        i = 0;
+    }
+    
+    // The interval of x as ENDFBinarySearch::locate, found by steps of
+    // 1, 2, 4, ... from the interval i and a binary search within the
+    // last step. Returns -1 if i is not an interval of the data or x is
+    // more than maxSteps doublings away
+    template <typename C>
+    long gallop(const C& data, double x) const {
+        long n = data.size();
+        if (n < 2 || i < 0 || i > n - 2) {
+            return -1;
+        }
+        // The interval lies in [lo, hi), data[lo].x <= x < data[hi].x
+        // unless clamped to the first or the last interval
+        long lo = i;
+        long hi = i;
+        long step = 1;
+        if (x >= data[i].x) {
+            for (long k=0; ; k++) {
+                hi = lo + step;
+                if (hi >= n - 1) {
+                    hi = n - 1;
+                    break;
+                }
+                if (x < data[hi].x) {
+                    break;
+                }
+                if (k == maxSteps) {
+                    return -1;
+                }
+                lo = hi;
+                step *= 2;
+            }
+        } else {
+            for (long k=0; ; k++) {
+                lo = hi - step;
+                if (lo <= 0) {
+                    lo = 0;
+                    break;
+                }
+                if (x >= data[lo].x) {
+                    break;
+                }
+                if (k == maxSteps) {
+                    return -1;
+                }
+                hi = lo;
+                step *= 2;
+            }
+        }
+        // Binary search
+        while ( lo + 1 < hi ) {
+            long m = ( lo + hi )/2;
+            
+            if (x >= data[m].x) {
+                lo = m;
+            } else {
+                hi = m;
+            }
+        }
+        return lo;
+    }
+    
+};
+
+// Lookup acceleration of a tabulated function of positive x. The range
+// of log(x) is cut into bins of equal width, start[b] is the first point
+// of bin b or above, so an x in bin b lies between the points
+// start[b]-1 and start[b+1]. laws[i] is the law of the interval
+// between the points i and i+1
+struct ENDFTabLookup {
+    double lnMin    = 0.;
+    double invWidth = 0.;
+    std::vector<long> start;
+    std::vector<char> laws;
+    
+    bool valid() const {
+        return !start.empty();
+    }
+    
+    void clear() {
+        start.clear();
+        laws.clear();
+    }
+    
+    // The bin of x > 0, clamped to the bins
+    long bin(double x) const {
+        long nb = (long)start.size() - 1;
+        double b = (log(x) - lnMin)*invWidth;
+        if (!(b > 0.)) {
+            return 0;
+        }
+        return b >= nb ? nb - 1 : (long)b;
+    }
+};
+
 // The ENDF object interpolation function is assumed to be always valid
 // We enforce a strong gurantee interface to ensure the data
 // capsualation.
-template <typename T, typename H = ENDFEmpty>
+// S is the search policy, see ENDFBinarySearch
+// P is the storage policy of the data, see ENDFAoSStorage
+template <typename T, typename H = ENDFEmpty,
+typename S = ENDFBinarySearch, typename P = ENDFAoSStorage>
 struct ENDFObjectInterpolationFunction {
     
 protected:
@@ -275,7 +790,13 @@ protected:
     std::vector< ENDFInterpLaw > _interp;
     
     // Interpolation data
-    std::vector< ENDFObjectDataPoint<T> > _data;
+    typename P::template Container<T> _data;
+    
+    // Lookup acceleration, empty unless built
+    ENDFTabLookup _lookup;
+    
+    // Search structure, empty unless built
+    S _search;
     
 public:
     
@@ -298,7 +819,7 @@ public:
         return _interp.at(i);
     }
     
-    const ENDFObjectDataPoint<T>& data(long i) const {
+    typename decltype(_data)::const_reference data(long i) const {
         // Exception will be thrown for out of range value
         return _data.at(i);
     }
@@ -308,7 +829,7 @@ public:
         return _info;
     }
     
-    ENDFObjectDataPoint<T>& data(long i) {
+    typename decltype(_data)::reference data(long i) {
         return _data.at(i);
     }
     
@@ -550,6 +1071,93 @@ public:
     void clear() {
         _interp.clear();
         _data.clear();
+        _lookup.clear();
+        _search.clear();
+    }
+    
+    // Build the lookup acceleration with about pointsPerBin points per
+    // bin, only possible if all x are positive. It is dropped by init,
+    // clear and transform, and needs a rebuild after changes through
+    // data(i). Returns false if not built
+    bool buildLookup(double pointsPerBin = 4.) {
+        _lookup.clear();
+        long n = _data.size();
+        if (n < 2 || _interp.empty() || !(_data.front().x > 0.)) {
+            return false;
+        }
+        long nb = std::max(1L, (long)(n / pointsPerBin));
+        double lnMin = log(_data.front().x);
+        double lnMax = log(_data.back().x);
+        _lookup.lnMin    = lnMin;
+        _lookup.invWidth = lnMax > lnMin ? nb / (lnMax - lnMin) : 0.;
+        
+        // The first point of every bin, then of every bin or above
+        _lookup.start.assign(nb + 1, n);
+        for (long i=n-1; i>=0; i--) {
+            _lookup.start[_lookup.bin(_data[i].x)] = i;
+        }
+        for (long b=nb-1; b>=0; b--) {
+            _lookup.start[b] = std::min
+            (_lookup.start[b], _lookup.start[b+1]);
+        }
+        
+        // The law of every interval
+        _lookup.laws.assign(n - 1, 2);
+        long i = 0;
+        for (auto& law : _interp) {
+            for (; i<law.NBT-1 && i<n-1; i++) {
+                _lookup.laws[i] = law.INT;
+            }
+        }
+        
+        return true;
+    }
+    
+    // Whether the lookup acceleration is built
+    bool hasLookup() const {
+        return _lookup.valid();
+    }
+    
+    // Build the structure of the search policy, with the same life
+    // cycle as the lookup acceleration
+    void buildSearch() {
+        _search.build(_data);
+    }
+    
+    // The interval i with data(i).x <= x < data(i+1).x, the same as
+    // ENDFTabLocateIdx, through the lookup acceleration if built,
+    // otherwise through the search policy
+    long locate(double x) const {
+        long n = _data.size();
+        if (!_lookup.valid() ||
+            !(x > _data.front().x && x < _data.back().x)) {
+            return _search.locate(_data, x);
+        }
+        long b = _lookup.bin(x);
+        long i = std::max(_lookup.start[b] - 1, 0L);
+        long j = std::min(_lookup.start[b+1], n - 1);
+        // Binary search
+        while ( i + 1 < j ) {
+            long m = ( i + j )/2;
+            
+            if (x >= _data[m].x) {
+                i = m;
+            } else {
+                j = m;
+            }
+        }
+        return i;
+    }
+    
+    // The same as locate, galloping from the interval of the cursor if
+    // x is near it, and the cursor is moved to the interval found
+    long locate(double x, ENDFCursor& cursor) const {
+        long i = cursor.gallop(_data, x);
+        if (i < 0) {
+            i = locate(x);
+        }
+        cursor.i = i;
+        return i;
     }
     
     // Here are a few linearization test
@@ -568,9 +1176,11 @@ public:
     
     // Iterate and transform data
     void transform
-    (std::function<void(ENDFObjectDataPoint<T>&)> action) {
+    (std::function<void(typename decltype(_data)::reference)> action) {
         
-        for (auto& d : _data) {
+        _lookup.clear();
+        _search.clear();
+        for (auto&& d : _data) {
             action(d);
         }
         
@@ -586,6 +1196,15 @@ ENDFObjectInterpolationFunction<double> {
     // Evaluate the interpolation function at point x
     double evaluate(double x) const;
     
+    // Evaluate at point x, located from the cursor, see ENDFCursor
+    double evaluate(double x, ENDFCursor& cursor) const;
+    
+    // Evaluate at the n points xs into ys, the same as evaluate on each
+    // of them. Sorted points are located by one walk along the data,
+    // others by locate, and the linear-linear intervals are evaluated
+    // in a vectorized loop
+    void evaluate(const double* xs, double* ys, long n) const;
+    
     // Check whether a constant
     bool isConst() const {
         if (_interp.size() != 1) {
@@ -608,6 +1227,11 @@ ENDFObjectInterpolationFunction<double> {
         return _data[0].y;
     }
     
+protected:
+    
+    // Interpolate at x in the interval i
+    double interpolate(long i, double x) const;
+    
 };
 
 // Some widely used interpolation functions
@@ -687,6 +1311,138 @@ inline double ENDFInterpEval
     
 };
 
+// The law of an interval of a prepared function, with the branch of
+// ENDFInterpEval for non-positive values already taken
+enum class ENDFPreparedLaw : char {
+    CONST  = 1, // y = y1
+    LINLIN = 2, // y = y1 + (x - x1)*b
+    LOGLIN = 3, // y = y1 + log(x/x1)*b
+    LINLOG = 4, // y = y1*exp((x - x1)*b)
+    LOGLOG = 5  // y = y1*exp(log(x/x1)*b)
+};
+
+// An interpolation function prepared for evaluation, the points are kept
+// in contiguous arrays and every interval keeps its law and coefficient
+// b, so log(x2/x1), log(y2/y1) and the division are done once. The
+// values agree with ENDFInterpolationFunction::evaluate to rounding.
+// A function of a single lin-lin region is evaluated without the law
+// dispatch
+struct ENDFPreparedFunction {
+    
+    // The points
+    std::vector<double> x;
+    std::vector<double> y;
+    
+    // The coefficient and the law of the interval i, from x[i] to x[i+1]
+    std::vector<double> b;
+    std::vector<ENDFPreparedLaw> laws;
+    
+    // Whether all intervals are lin-lin
+    bool linlin = false;
+    
+    // Prepare from a function, returns false if not valid
+    bool init(const ENDFInterpolationFunction& func);
+    
+    void clear() {
+        x.clear();
+        y.clear();
+        b.clear();
+        laws.clear();
+        linlin = false;
+    }
+    
+    bool valid() const {
+        return !x.empty();
+    }
+    
+    // The interval i with x[i] <= xv < x[i+1], the same as
+    // ENDFTabLocateIdx
+    long locate(double xv) const {
+        long i = 0;
+        long j = (long)x.size() - 1;
+        // Binary search
+        while ( i + 1 < j ) {
+            long m = ( i + j )/2;
+            
+            if (xv >= x[m]) {
+                i = m;
+            } else {
+                j = m;
+            }
+        }
+        return i;
+    }
+    
+    // The value at xv within the interval i
+    template <bool LinLin>
+    double evaluateAt(long i, double xv) const {
+        if (LinLin) {
+            return y[i] + (xv - x[i])*b[i];
+        }
+        switch (laws[i]) {
+            case ENDFPreparedLaw::CONST:
+                return y[i];
+            case ENDFPreparedLaw::LINLIN:
+                return y[i] + (xv - x[i])*b[i];
+            case ENDFPreparedLaw::LOGLIN:
+                return y[i] + log(xv / x[i])*b[i];
+            case ENDFPreparedLaw::LINLOG:
+                return y[i]*exp((xv - x[i])*b[i]);
+            case ENDFPreparedLaw::LOGLOG:
+                return y[i]*exp(log(xv / x[i])*b[i]);
+        }
+        return 0.;
+    }
+    
+    // Evaluate at xv, the end values out of range
+    double evaluate(double xv) const {
+        if (xv < x.front()) {
+            return y.front();
+        }
+        if (xv >= x.back()) {
+            return y.back();
+        }
+        long i = locate(xv);
+        return linlin ? evaluateAt<true>(i, xv) : evaluateAt<false>(i, xv);
+    }
+    
+    // Evaluate at the n points xs into ys, sorted points are located by
+    // one walk along the points
+    void evaluate(const double* xs, double* ys, long n) const {
+        if (linlin) {
+            evaluate<true>(xs, ys, n);
+        } else {
+            evaluate<false>(xs, ys, n);
+        }
+    }
+    
+private:
+    
+    template <bool LinLin>
+    void evaluate(const double* xs, double* ys, long n) const {
+        bool sorted = std::is_sorted(xs, xs + n);
+        long i = 0;
+        for (long k=0; k<n; k++) {
+            double xv = xs[k];
+            if (xv < x.front()) {
+                ys[k] = y.front();
+            } else if (xv >= x.back()) {
+                ys[k] = y.back();
+            } else {
+                if (sorted) {
+                    while (x[i+1] <= xv) {
+                        i++;
+                    }
+                } else {
+                    i = locate(xv);
+                }
+                ys[k] = evaluateAt<LinLin>(i, xv);
+            }
+        }
+    }
+    
+};
+
 struct ENDFPolynomialFunction {
     std::vector<double> coefficents;
     
@@ -829,7 +1585,9 @@ struct ENDFObjectTabularDistributionDataPoint {
 // The distribution model a map from a value to its probability
 // The data are normalized to be 1.
 // Function values to zero for points out of range
-template <typename T = ENDFEmpty, typename H = ENDFEmpty>
+// S is the search policy, see ENDFBinarySearch
+template <typename T = ENDFEmpty, typename H = ENDFEmpty,
+typename S = ENDFBinarySearch>
 struct ENDFObjectTabularDistribution {
     
 protected:
@@ -843,6 +1601,9 @@ protected:
     // The distribution data
     std::vector< ENDFObjectTabularDistributionDataPoint<T> > _data;
     
+    // Search structure, rebuilt by normalize
+    S _search;
+    
     void normalize() {
         
         // Skip empty data
@@ -882,24 +1643,42 @@ protected:
             _data[i].cdf = c1 + ENDFTabularDistributionAddFunc
             (x1, x2, y1, y2, this->_type);
         }
+        
+        _search.build(_data);
     }
     
     long locateIdx(double x) const {
-        long i = 0;
-        long j = (long)_data.size() - 1;
-        // Binary search
-        while ( i + 1 < j ) {
-            long m = ( i + j )/2;
-            
-            if (x >= _data[m].x) {
-                i = m;
-            } else {
-                j = m;
-            }
+        return _search.locate(_data, x);
+    }
+    
+    long locateIdx(double x, ENDFCursor& cursor) const {
+        long i = cursor.gallop(_data, x);
+        if (i < 0) {
+            i = locateIdx(x);
         }
+        cursor.i = i;
         return i;
     }
     
+    // Interpolate the cdf at x in the interval i
+    double interpolateCDF(long i, double x) const {
+        
+        double y = 0.;
+        
+        long law = static_cast<long>(_type);
+        
+        // Perform intepolation
+        y = ENDFInterpEval
+        (this->_data[i].x, this->_data[i].cdf,
+         this->_data[i+1].x, this->_data[i+1].cdf, x, law);
+        
+        if (isinf(y) || isnan(y)) {
+            throw std::logic_error("evaluate data error!");
+        }
+        
+        return y;
+    }
+    
 public:
     
     // a special interfaces for initialization from
@@ -949,8 +1728,6 @@ public:
     
     double evaluateCDF(double x) const {
         
-        double y = 0.;
-        
         if (x < this->_data.front().x) {
             return this->_data.front().cdf;
         }
@@ -959,25 +1736,28 @@ public:
             return this->_data.back().cdf;
         }
         
-        long i   = locateIdx(x);
-        long law = static_cast<long>(_type);
+        return interpolateCDF(locateIdx(x), x);
+    }
+    
+    // Evaluate the cdf at x, located from the cursor, see ENDFCursor
+    double evaluateCDF(double x, ENDFCursor& cursor) const {
         
-        // Perform intepolation
-        y = ENDFInterpEval
-        (this->_data[i].x, this->_data[i].cdf,
-         this->_data[i+1].x, this->_data[i+1].cdf, x, law);
+        if (x < this->_data.front().x) {
+            return this->_data.front().cdf;
+        }
         
-        if (isinf(y) || isnan(y)) {
-            throw std::logic_error("evaluate data error!");
+        if (x >= this->_data.back().x) {
+            return this->_data.back().cdf;
         }
         
-        return y;
+        return interpolateCDF(locateIdx(x, cursor), x);
     }
     
     // Clear function
     void clear() {
         _type = static_cast<ENDFTabularDistributionType>(0);
         _data.clear();
+        _search.clear();
     }
     
     // Obtain access to info
@@ -1059,8 +1839,13 @@ struct ENDFLegendreDistribution {
     std::vector<double> coefficents;
     
     // Evaluate the legendre polynomial function value at x
+    // Reentrant, the recurrence is kept in local variables
     double evaluate(double x) const;
     
+    // Evaluate at the n cosines x into y, the same as evaluate on each
+    // of them, the points are run through the recurrence in blocks
+    void evaluate(const double* x, double* y, long n) const;
+    
     // Isotropic, if all coeffs. are 0.
     bool isIsotropic() const;
     
@@ -1385,6 +2170,62 @@ struct ENDFNeutronData {
             double BF2 = 0.;
         };
         
+        // Particle pair of the R-Matrix Limited representation (LRF=7)
+        struct ParticlePair {
+            // Masses of the two particles, in units of neutron mass
+            double MA  = 0.;
+            double MB  = 0.;
+            // Charges of the two particles
+            double ZA  = 0.;
+            double ZB  = 0.;
+            // Spins of the two particles
+            double IA  = 0.;
+            double IB  = 0.;
+            // Q-value of the reaction, in unit of eV
+            double Q   = 0.;
+            // Flag whether the penetrability is calculated, 1 yes, -1 no,
+            // 0 for the default (yes unless MA is zero)
+            long   PNT = 0;
+            // Flag whether the shift factor is calculated, 1 yes, 0 no
+            long   SHF = 0;
+            // The reaction MT number, 2 for the elastic pair
+            long   MT  = 0;
+            // Parities of the two particles
+            double PA  = 0.;
+            double PB  = 0.;
+        };
+        
+        // Spin group of the R-Matrix Limited representation (LRF=7)
+        struct SpinGroup {
+            
+            struct Channel {
+                // Particle pair index, starting from 1
+                long   PPI = 0;
+                // Orbital angular momentum
+                long   L   = 0;
+                // Channel spin
+                double SCH = 0.;
+                // Boundary condition
+                double BND = 0.;
+                // Effective and true channel radii, in units of 1E-12 cm
+                double APE = 0.;
+                double APT = 0.;
+            };
+            
+            // Spin and parity
+            double AJ  = 0.;
+            double PJ  = 0.;
+            // Flags for background R-matrix and tabulated phase shifts
+            long   KBK = 0;
+            long   KPS = 0;
+            // The channels
+            std::vector<Channel> channels;
+            // Resonance energies in eV, and the widths, the width of
+            // resonance r in channel c is at r*channels.size() + c
+            std::vector<double> ER;
+            std::vector<double> GAM;
+        };
+        
         struct Range {
             // Lower limit for an energy range
             double   EL   = 0.;
@@ -1425,6 +2266,19 @@ struct ENDFNeutronData {
             /* AA paramters */
             AAParams aaParams;
             
+            /* Parameters for R-Matrix Limited representation (LRF=7) */
+            
+            // Flag whether GAM are reduced width amplitudes (1) or
+            // partial widths (0)
+            long     IFG  = -1;
+            // Formula, 3 for Reich-Moore and 4 for full R-matrix
+            long     KRM  = -1;
+            // Flag for relativistic kinematics
+            long     KRL  = -1;
+            // Particle pairs and spin groups
+            std::vector<ParticlePair> pairs;
+            std::vector<SpinGroup> spinGroups;
+            
             /* Table of angular moments parameters */
             std::vector<AngularMomentum> moments;
             
@@ -1446,13 +2300,153 @@ struct ENDFNeutronData {
             // fission: neutron fission cross section
             // capture: neutron capture cross section
             // potential: neutron potential scattering cross section
+            // The LRF=7 total also contains the reactions to the particle
+            // pairs other than elastic, capture and fission
             Xsec generate(double E, long LFW) const;
             
+            // Evaluated cross sections at the n energies E, stored in xsec
+            // Compiled ranges are summed in blocks of energies sharing the
+            // loads of the resonance constants
+            void generate(const double* E, long n, long LFW, Xsec* xsec) const;
+            
+            // Evaluated cross sections at temperature tempK, the line
+            // shapes psi and chi of the s-wave SLBW and MLBW resonances
+            // (LRF=1,2) are Doppler broadened directly, summing all
+            // resonances. The line shapes take the neutron width and
+            // the shift at E, which vary too fast over the Doppler width
+            // for l >= 1, so these resonances are broadened from their
+            // 0K cross sections by quadrature over the free gas kernel.
+            // The unresolved averages are those at 0K, other resolved
+            // representations throw
+            Xsec generate(double E, long LFW, double tempK) const;
+            
+            /* Energy window index of resolved resonances (LRF=1,2,3) */
+            
+            // With the index, generate sums exactly only the resonances
+            // near E, the sum over the other resonances is smooth in E and
+            // replaced by a polynomial background. The energy range is cut
+            // into bins in ln(E), a resonance is summed exactly in a bin
+            // if it lies within the window of some widths of its total
+            // width around the bin
+            struct WindowIndex {
+                // Number of resonance sums
+                long nsums = 0;
+                // Bin boundaries in ln(E), in increasing order
+                std::vector<double> lnEdges;
+                // Resonances summed exactly in each bin, per angular
+                // momentum, at bin*moments.size() + moment
+                std::vector< std::vector<long> > members;
+                // Chebyshev coefficients in ln(E) of the background sums
+                // of each bin, the same number for each sum.
+                // Empty if all resonances are summed in the bin
+                std::vector< std::vector<double> > background;
+                // Energy independent channel counts (LRF=3)
+                std::vector<long> counts;
+                
+                bool valid() const {return !lnEdges.empty();}
+            };
+            WindowIndex index;
+            
+            /* Compiled resonance parameters (LRF=1,2,3,4,7) */
+            
+            // The energy independent constants of the resonances in flat
+            // arrays, one array per constant, grouped by angular momentum
+            // and J value (and channel spins for Reich-Moore). The LRF=7
+            // groups are the spin groups, the constants the energy, the
+            // eliminated width and the reduced width amplitudes of the
+            // explicit channels
+            struct Compiled {
+                // Number of resonances and of constants per resonance
+                long size    = 0;
+                long nparams = 0;
+                // Constant k of the resonance at position p is at
+                // k*size + p
+                std::vector<double> params;
+                // Per group of resonances: the angular momentum index,
+                // J index, channel spin mask and the first position,
+                // the last group is followed by size
+                std::vector<long> groupMoment;
+                std::vector<long> groupJ;
+                std::vector<long> groupMask;
+                std::vector<long> groupBegin;
+                // Position of each resonance of each angular momentum,
+                // -1 for resonances not contributing
+                std::vector< std::vector<long> > position;
+                // Energy independent channel counts (LRF=3), or the
+                // explicit channels of each group, nparams-2 per group,
+                // and the group mask is their number (LRF=7)
+                std::vector<long> counts;
+                
+                bool valid() const {return !groupBegin.empty();}
+            };
+            Compiled compiled;
+            
+            // Compile the resonance parameters, generate then uses the
+            // compiled kernels. Ranges with energy dependent channel
+            // radius (NRO=1, NAPS=1) are not compiled, and unsupported
+            // parameters leave the range not compiled with a warning
+            void compile();
+            
+            /* Poles of resolved resonances (LRF=1,2,3) */
+            
+            // The poles p of the cross sections in u = sqrt(E), one per
+            // resonance of the channels with cross sections, Im(p) > 0,
+            // so that the cross sections times E are sums of
+            // Re[r/(p - u)] and smooth terms near the real axis. The SLBW
+            // and MLBW poles are the zeros of the level denominators, the
+            // Reich-Moore ones the zeros of the level matrix of the
+            // neighbouring resonances of the spin group
+            std::vector< std::complex<double> > poles() const;
+            
+            // Build the index, the background reproduces the cross sections
+            // within the relative tolerance tol, widths is the window size
+            // in total widths. Ranges of other types, or with few
+            // resonances, are not indexed
+            void indexResonances(double tol, double widths);
+            
+            /* Statistics of unresolved resonances (LRU=2) */
+            
+            // The average parameters of the resonances of one spin
+            // sequence (l, J) at an energy, widths in eV. The neutron
+            // width is the reduced width times the penetrability, the
+            // widths are chi-square distributed with the given degrees
+            // of freedom, zero for widths without fluctuation
+            struct Sequence {
+                long   L    = 0;
+                double AWRI = 0.;
+                // Statistical spin factor
+                double GJ   = 0.;
+                // Average level spacing and widths
+                double D    = 0.;
+                double GN   = 0.;
+                double GG   = 0.;
+                double GF   = 0.;
+                double GX   = 0.;
+                double AMUN = 0.;
+                double AMUG = 0.;
+                double AMUF = 0.;
+                double AMUX = 0.;
+                // Wave number in units of 1E12 cm^-1 and phase shift
+                double K    = 0.;
+                double PS   = 0.;
+            };
+            
+            // The spin sequences at energy E in seqs, the parameters are
+            // interpolated between the tabulated energies. Returns the
+            // potential scattering cross section
+            double sequences
+            (double E, long LFW, std::vector<Sequence>& seqs) const;
+            
+            // The energies within [EL, EH] at which parameters are
+            // tabulated, empty if they are energy independent
+            std::vector<double> parameterEnergies(long LFW) const;
+            
             // Specific function for different cases
             Xsec generateLRU1LRF1(double E) const;
             Xsec generateLRU1LRF2(double E) const;
             Xsec generateLRU1LRF3(double E) const;
             Xsec generateLRU1LRF4(double E) const;
+            Xsec generateLRU1LRF7(double E) const;
             Xsec generateLRU2LRF1(double E, long LFW) const;
             Xsec generateLRU2LRF2(double E, long LFW) const;
         };
@@ -1799,7 +2793,20 @@ struct ENDFNeutronData {
     std::pair<double, double> getResolvedResonanceRange() const;
     
     // Generate the resolved resonance cross section at existing temperature
-    Resonance::Xsec getResolvedResonanceXsec(double energy) const;
+    // With tempK > 0 the SLBW and MLBW ranges are Doppler broadened,
+    // with s-wave resonances only, see Resonance::Range::generate
+    Resonance::Xsec getResolvedResonanceXsec
+    (double energy, double tempK = 0.) const;
+    
+    // Generate the resolved resonance cross sections at a list of energies
+    // The resolved ranges are selected once, the energies are evaluated in
+    // chunks on nthreads threads (nthreads <= 0 means all hardware threads)
+    std::vector<Resonance::Xsec> getResolvedResonanceXsec
+    (const std::vector<double>& energies, long nthreads = 1) const;
+    
+    // Index the resolved resonance ranges for energy windowed summation,
+    // see Resonance::Range::indexResonances
+    void indexResolvedResonance(double tol, double widths = 100.);
     
 };
 
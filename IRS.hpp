@@ -0,0 +1,102 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+// Inverted-stack Refinement System (IRS)
+
+#ifndef IRS_HPP
+#define IRS_HPP
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+//namespace com {
+//namespace ibhe {
+
+// Bisection refinement of a function on an interval by the inverted stack
+// method. An interval is split at its middle point until conv(y1, y2, ym)
+// accepts the middle value ym against the end values y1 and y2, or the
+// interval has no number left between its ends.
+// T is the value type (double, XRSRRXsec, a column vector, ...).
+// The stack is contiguous and kept between calls, and the output is
+// reserved to the size of the previous run, so a refinement does not
+// allocate once the engine has warmed up
+template <typename T>
+class IRSEngine {
+public:
+    
+    typedef std::pair<double, T> Point;
+    
+    // Refine between p1 and p2, eval(x) gives the value at x
+    // The points are appended to out in increasing order,
+    // p1 included and p2 excluded. Returns the number of points added
+    template <typename Eval, typename Conv>
+    long refine
+    (const Point& p1, const Point& p2, Eval&& eval, Conv&& conv,
+     std::vector<Point>& out) {
+        
+        long size0 = out.size();
+        if (out.capacity() < size0 + _lastCount) {
+            out.reserve(size0 + _lastCount);
+        }
+        
+        // The top of the stack is the lowest point
+        _stack.clear();
+        _stack.push_back(p2);
+        _stack.push_back(p1);
+        
+        while (_stack.size() >= 2) {
+            auto& lo = _stack[_stack.size() - 1];
+            auto& hi = _stack[_stack.size() - 2];
+            double xm = 0.5*(lo.first + hi.first);
+            
+            // An interval of adjacent numbers can not be split
+            if (xm == lo.first || xm == hi.first) {
+                out.push_back(lo);
+                _stack.pop_back();
+                continue;
+            }
+            
+            T      ym = eval(xm);
+            if (!conv(lo.second, hi.second, ym)) {
+                // Insert the middle point below the top
+                _stack.push_back(lo);
+                _stack[_stack.size() - 2] = Point(xm, ym);
+            } else {
+                out.push_back(lo);
+                _stack.pop_back();
+            }
+        }
+        
+        _lastCount = out.size() - size0;
+        return _lastCount;
+    }
+    
+private:
+    
+    // Working stack, lowest point on top
+    std::vector<Point> _stack;
+    
+    // Number of points of the last refinement
+    long _lastCount = 0;
+    
+};
+
+//}
+//}
+
+#endif /* IRS_HPP */
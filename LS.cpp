@@ -17,16 +17,61 @@
 
 #include "LS.hpp"
 #include "ENDF.hpp"
+#include "IRS.hpp"
+#include "PRS.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <list>
+#include <limits>
 #include <cassert>
 
 //namespace com {
 //namespace ibhe {
 
+// Number of intervals handed out to a worker thread at once
+static const long lsIntervalsPerChunk = 16;
+
+// An interval of interpolation law 3, 4 or 5, the branch of the law and
+// its constants are those of ENDFInterpEval, found once, so the values
+// are the same
+struct LSInterval {
+    std::pair<double, double> p1, p2;
+    // Position of the end point on the stack
+    long   pos  = 0;
+    // Whether log is taken in x and y
+    bool   logx = false;
+    bool   logy = false;
+    // x2 - x1 or log(x2/x1), and y2 - y1 or y2/y1
+    double dx   = 0.;
+    double dy   = 0.;
+    
+    LSInterval
+    (const std::pair<double, double>& _p1,
+     const std::pair<double, double>& _p2, long INT, long _pos):
+    p1(_p1), p2(_p2), pos(_pos) {
+        double x1 = p1.first, y1 = p1.second;
+        double x2 = p2.first, y2 = p2.second;
+        bool xcond = x1 <= 0. || x2 <= 0.;
+        bool ycond = y1 <= 0. || y2 <= 0.;
+        logx = (INT == 3 || INT == 5) && !xcond && !(INT == 5 && ycond);
+        logy = (INT == 4 || INT == 5) && !ycond;
+        if (INT == 5 && ycond) {
+            logx = !xcond;
+        }
+        dx = logx ? log(x2 / x1) : (x2 - x1);
+        dy = logy ? (y2 / y1) : (y2 - y1);
+    }
+    
+    double evaluate(double x) const {
+        double r = logx ? log(x / p1.first) / dx : (x - p1.first) / dx;
+        return logy ? p1.second * pow(dy, r) : p1.second + r * dy;
+    }
+};
+
 ENDFInterpolationFunction LS::linearize
-(const ENDFInterpolationFunction& ifunc, double tol, double zeroThres) {
+(const ENDFInterpolationFunction& ifunc, double tol, double zeroThres,
+ long nthreads) {
     
     // Create data structure
     ENDFInterpolationFunction func;
@@ -56,7 +101,12 @@ ENDFInterpolationFunction LS::linearize
     try {
         
         // Provide a stack for work with
-        std::list< std::pair<double, double> > stack;
+        std::vector< std::pair<double, double> > stack;
+        
+        // The intervals to refine are independent, they are collected
+        // with the position of their end point on the stack, refined
+        // concurrently and then inserted in order
+        std::vector<LSInterval> intervals;
         
         // Loop over all regions
         long iend = 0;
@@ -66,7 +116,7 @@ ENDFInterpolationFunction LS::linearize
             iend        = info.NBT - 1;
             
             // Local energy stack
-            std::list< std::pair<double, double> > lstack;
+            std::vector< std::pair<double, double> > lstack;
             
             // Lambda function
             auto int1func = [&] () {
@@ -167,7 +217,7 @@ ENDFInterpolationFunction LS::linearize
                         
                         // An interval in-between
                         // Last data point
-                        auto& pm = lstack.back();
+                        auto  pm = lstack.back();
                         
                         // Current data point
                         auto  p  = std::make_pair(d.x, d.y);
@@ -182,49 +232,13 @@ ENDFInterpolationFunction LS::linearize
                             continue;
                         }
                         
-                        // Define inverted stack
-                        std::list< std::pair<double, double> > istack;
-                        
-                        // Add boundary points into istack
-                        istack.push_back(pm);
-                        istack.push_back(p);
-                        
-                        // Begin inverted stack loop
-                        decltype(istack)::iterator it, next;
-                        while (istack.size() >= 2) {
-                            
-                            // Initialize iterator
-                            it = istack.begin();
-                            next = std::next(it);
-                            
-                            // Obtain middle point values
-                            double xmid = 0.5*(it->first + next->first);
-                            auto   ymid = ENDFInterpEval
-                            (it->first, it->second,
-                             next->first, next->second,
-                             xmid, info.INT);
-                            
-                            // Check ymid evaluation
-                            if (std::isnan(ymid) || std::isinf(ymid)) {
-                                throw std::logic_error("numeric error!");
-                            }
-                            
-                            // Check convergence
-                            if (!converged(it->second, next->second, ymid)) {
-                                istack.insert
-                                (next, std::make_pair(xmid, ymid));
-                            } else {
-                                // Do not put the sub region begining point
-                                if (istack.size() > 2) {
-                                    lstack.push_back(istack.front());
-                                }
-                                istack.pop_front();
-                            }
-                        }
+                        // The interval is refined later, its points go
+                        // before the last data point
+                        intervals.emplace_back
+                        (pm, p, info.INT, stack.size() + lstack.size());
                         
                         // Add the last data point
-                        lstack.push_back(istack.front());
-                        istack.pop_front();
+                        lstack.push_back(p);
                         
                     }
                     
@@ -258,41 +272,394 @@ ENDFInterpolationFunction LS::linearize
             }
             
             // Local stack to global stack
-            for (auto& p : lstack) {
-                stack.push_back(p);
-            }
+            stack.insert(stack.end(), lstack.begin(), lstack.end());
             
         }
         
+        // Refine the intervals, each gives its points with the beginning
+        // point, which is on the stack already
+        std::vector< std::vector< std::pair<double, double> > >
+        refined(intervals.size());
+        PRS::parallelFor
+        (intervals.size(), nthreads, lsIntervalsPerChunk,
+         [&] (long b, long e) {
+            IRSEngine<double> engine;
+            for (long k=b; k<e; k++) {
+                auto& in = intervals[k];
+                
+                // Evaluate by the interpolation law
+                auto eval = [&] (double x) {
+                    double y = in.evaluate(x);
+                    
+                    // Check y evaluation
+                    if (std::isnan(y) || std::isinf(y)) {
+                        throw std::logic_error("numeric error!");
+                    }
+                    return y;
+                };
+                engine.refine(in.p1, in.p2, eval, converged, refined[k]);
+            }
+        });
+        if (!intervals.empty()) {
+            std::vector< std::pair<double, double> > merged;
+            long size = stack.size();
+            for (auto& part : refined) {
+                size += part.size() - 1;
+            }
+            merged.reserve(size);
+            long i = 0;
+            for (long k=0; k<intervals.size(); k++) {
+                merged.insert
+                (merged.end(), stack.begin() + i,
+                 stack.begin() + intervals[k].pos);
+                merged.insert
+                (merged.end(), refined[k].begin() + 1, refined[k].end());
+                std::vector< std::pair<double, double> >().swap(refined[k]);
+                i = intervals[k].pos;
+            }
+            merged.insert(merged.end(), stack.begin() + i, stack.end());
+            stack.swap(merged);
+        }
+        
         // Post processing:
         // 1) Make zero below thres and
         // 2) Eliminate duplicated points
-        auto it = stack.begin();
-        for (; it != stack.end(); ) {
-            if (fabs(it->second) <= thres) {
-                it->second = 0.;
+        long n = 0;
+        for (long i=0; i<stack.size(); i++) {
+            auto p = stack[i];
+            if (fabs(p.second) <= thres) {
+                p.second = 0.;
             }
-            if (it == stack.begin()) {
-                // Need to move iterator manually
-                it ++;
+            if (n > 0 &&
+                p.first == stack[n-1].first &&
+                fabs(p.second - stack[n-1].second) < thres) {
                 continue;
             }
-            auto itprev = std::prev(it);
-            if (it->first == itprev->first &&
-                fabs(it->second - itprev->second) < thres) {
-                it = stack.erase(it);
+            stack[n++] = p;
+        }
+        
+        // Add points on the stack to grid
+        func.init(n);
+        for (long i=0; i<n; i++) {
+            func.data(i).x = stack[i].first;
+            func.data(i).y = stack[i].second;
+        }
+        
+    } catch (std::exception& e) {
+        std::cerr << "[LS]: error msg - " << e.what() << std::endl;
+        
+        // Return an empty func
+        func.clear();
+        return func;
+    }
+    
+    return func;
+}
+
+// The interpolation law of the interval between the points i and i+1
+static long LSIntervalLaw(const ENDFInterpolationFunction& f, long i) {
+    for (auto& law : f.interp()) {
+        if (i + 1 <= law.NBT - 1) {
+            return law.INT;
+        }
+    }
+    return 2;
+}
+
+// The piece of a function over an interval of the joint grid, the law 0
+// is linear between the grid values, out of the range of the function
+struct LSJointPiece {
+    double x1  = 0.;
+    double y1  = 0.;
+    double x2  = 0.;
+    double y2  = 0.;
+    long   INT = 0;
+};
+
+LSJointTable LS::linearize
+(const std::vector<const ENDFInterpolationFunction*>& ifuncs,
+ double tol, double zeroThres, long nthreads) {
+    
+    // Create data structure
+    LSJointTable table;
+    
+    // Set zero threshold
+    const double thres = zeroThres;
+    
+    // Number of functions
+    const long C = ifuncs.size();
+    
+    // Every function converges as it does in the linearization alone
+    auto converged = [&]
+    (const double* s1, const double* s2, const double* s3) -> bool {
+        for (long c=0; c<C; c++) {
+            if (fabs(s1[c]) <= thres && fabs(s2[c]) <= thres) {
+                continue;
+            }
+            if (fabs(s3[c] - 0.5*(s1[c] + s2[c])) > tol) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    // Try-Catch, will capture exceptions
+    try {
+        
+        // Union of the energies
+        std::vector<double> xs;
+        for (auto f : ifuncs) {
+            if (f == nullptr || !f->valid()) {
+                throw std::logic_error("invalid function!");
+            }
+            table.pointsIn += f->data().size();
+            for (auto& d : f->data()) {
+                xs.push_back(d.x);
+            }
+        }
+        if (xs.empty()) {
+            throw std::logic_error("no functions!");
+        }
+        std::sort(xs.begin(), xs.end());
+        xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+        const long K = xs.size();
+        table.pointsUnion = K;
+        
+        // The values from the left and from the right at every energy,
+        // they differ at a jump, and the pieces over every interval
+        std::vector<double> left(K*C), right(K*C);
+        std::vector<LSJointPiece> pieces((K-1)*C);
+        for (long c=0; c<C; c++) {
+            auto& f    = *ifuncs[c];
+            auto& data = f.data();
+            long  n    = data.size();
+            long  j    = 0;
+            for (long k=0; k<K; k++) {
+                double x = xs[k];
+                while (j < n && data[j].x < x) {
+                    j++;
+                }
+                double& yl = left[k*C+c];
+                double& yr = right[k*C+c];
+                LSJointPiece dummy;
+                auto& piece = (k + 1 < K) ? pieces[k*C+c] : dummy;
+                
+                if (j == n || x < data[0].x) {
+                    
+                    // Out of range
+                    yl = yr = 0.;
+                    
+                } else if (data[j].x == x) {
+                    
+                    // A point of the function, the last of a jump
+                    // gives the right value, and the histogram law
+                    // the left one. The ends of the function inside
+                    // the union jump from and to zero
+                    long h = j;
+                    while (h + 1 < n && data[h+1].x == x) {
+                        h++;
+                    }
+                    yl = data[j].y;
+                    if (j > 0 && LSIntervalLaw(f, j-1) == 1) {
+                        yl = data[j-1].y;
+                    }
+                    if (j == 0 && k > 0) {
+                        yl = 0.;
+                    }
+                    yr = data[h].y;
+                    if (h + 1 < n) {
+                        piece = {data[h].x, data[h].y,
+                            data[h+1].x, data[h+1].y, LSIntervalLaw(f, h)};
+                    } else if (k + 1 < K) {
+                        yr = 0.;
+                    }
+                    
+                } else {
+                    
+                    // Between the points j-1 and j
+                    piece = {data[j-1].x, data[j-1].y,
+                        data[j].x, data[j].y, LSIntervalLaw(f, j-1)};
+                    yl = yr = ENDFInterpEval
+                    (piece.x1, piece.y1, piece.x2, piece.y2, x, piece.INT);
+                    if (std::isnan(yl) || std::isinf(yl)) {
+                        throw std::logic_error("numeric error!");
+                    }
+                    
+                }
+            }
+        }
+        for (long k=0; k+1<K; k++) {
+            for (long c=0; c<C; c++) {
+                auto& piece = pieces[k*C+c];
+                if (piece.INT == 0) {
+                    piece = {xs[k], right[k*C+c],
+                        xs[k+1], left[(k+1)*C+c], 2};
+                }
+            }
+        }
+        
+        // Refine the intervals, all functions are evaluated at every
+        // middle point. The values of the points of an interval are kept
+        // C by C in one array, the engine only moves their offsets, so
+        // the middle points do not allocate
+        typedef IRSEngine<long>::Point Point;
+        std::vector< std::vector<Point> > refined(K-1);
+        std::vector< std::vector<double> > values(K-1);
+        PRS::parallelFor
+        (K-1, nthreads, lsIntervalsPerChunk, [&] (long b, long e) {
+            IRSEngine<long> engine;
+            for (long k=b; k<e; k++) {
+                const LSJointPiece* pk = &pieces[k*C];
+                auto& v = values[k];
+                v.assign(right.begin() + k*C, right.begin() + (k+1)*C);
+                v.insert(v.end(),
+                         left.begin() + (k+1)*C, left.begin() + (k+2)*C);
+                auto eval = [&] (double x) -> long {
+                    long o = v.size();
+                    v.resize(o + C);
+                    for (long c=0; c<C; c++) {
+                        auto& p = pk[c];
+                        v[o+c] = ENDFInterpEval
+                        (p.x1, p.y1, p.x2, p.y2, x, p.INT);
+                        
+                        // Check y evaluation
+                        if (std::isnan(v[o+c]) || std::isinf(v[o+c])) {
+                            throw std::logic_error("numeric error!");
+                        }
+                    }
+                    return o;
+                };
+                auto conv = [&] (long o1, long o2, long o3) -> bool {
+                    return converged(&v[o1], &v[o2], &v[o3]);
+                };
+                engine.refine
+                (Point(xs[k], 0), Point(xs[k+1], C), eval, conv, refined[k]);
+            }
+        });
+        
+        // Post processing:
+        // 1) Make zero below thres and
+        // 2) Eliminate duplicated points
+        table.columns.resize(C);
+        auto push = [&] (double x, const double* y) {
+            long n = table.energies.size();
+            if (n > 0 && x == table.energies.back()) {
+                bool same = true;
+                for (long c=0; c<C && same; c++) {
+                    double v = fabs(y[c]) <= thres ? 0. : y[c];
+                    same = fabs(v - table.columns[c][n-1]) < thres;
+                }
+                if (same) {
+                    return;
+                }
+            }
+            table.energies.push_back(x);
+            for (long c=0; c<C; c++) {
+                table.columns[c].push_back(fabs(y[c]) <= thres ? 0. : y[c]);
+            }
+        };
+        for (long k=0; k<K; k++) {
+            bool jump = !std::equal
+            (left.begin() + k*C, left.begin() + (k+1)*C,
+             right.begin() + k*C);
+            if (jump || k + 1 == K) {
+                push(xs[k], &left[k*C]);
+            }
+            if (k + 1 < K) {
+                for (auto& p : refined[k]) {
+                    push(p.first, &values[k][p.second]);
+                }
+                std::vector<Point>().swap(refined[k]);
+                std::vector<double>().swap(values[k]);
+            } else if (jump) {
+                push(xs[k], &right[k*C]);
+            }
+        }
+        table.pointsOut = table.energies.size();
+        
+    } catch (std::exception& e) {
+        std::cerr << "[LS]: error msg - " << e.what() << std::endl;
+        
+        // Return an empty table
+        return LSJointTable();
+    }
+    
+    return table;
+}
+
+ENDFInterpolationFunction LS::thin
+(const ENDFInterpolationFunction& lfunc, double tol, double zeroThres) {
+    
+    // Create data structure
+    ENDFInterpolationFunction func;
+    
+    try {
+        
+        if (!lfunc.isLinear()) {
+            throw std::logic_error("func is not linear!");
+        }
+        if (tol < 0.) {
+            throw std::logic_error("invalid tolerance!");
+        }
+        
+        // The kept points
+        auto& data = lfunc.data();
+        long  N    = data.size();
+        std::vector<long> kept;
+        
+        // Every point j between the anchor a and the trial end point b
+        // has to be met by the line from a within its band, which bounds
+        // the slope of the line from a. The bounds are accumulated while
+        // b moves forward, so each point is visited once
+        long a = 0;
+        if (N > 0) {
+            kept.push_back(0);
+        }
+        while (a < N-1) {
+            
+            double smin = -std::numeric_limits<double>::infinity();
+            double smax =  std::numeric_limits<double>::infinity();
+            
+            long b = a + 1;
+            for (; b < N; b++) {
+                
+                // Always keep both points of a jump
+                if (data[b].x == data[b-1].x) {
+                    break;
+                }
+                
+                // Check the line from a to b against the bounds
+                double dx = data[b].x - data[a].x;
+                double s  = (data[b].y - data[a].y) / dx;
+                if (s < smin || s > smax) {
+                    break;
+                }
+                
+                // Add the band of point b to the bounds
+                double band = std::max(tol*fabs(data[b].y), zeroThres);
+                smin = std::max(smin, (data[b].y - band - data[a].y) / dx);
+                smax = std::min(smax, (data[b].y + band - data[a].y) / dx);
+            }
+            
+            // The last point reached by a valid line is the new anchor,
+            // at a jump it is kept along with the point after the jump
+            if (b < N && data[b].x == data[b-1].x) {
+                if (b-1 > a) {
+                    kept.push_back(b-1);
+                }
+                kept.push_back(b);
+                a = b;
             } else {
-                it ++;
+                kept.push_back(b-1);
+                a = b-1;
             }
         }
         
-        // Add points on the stack to grid
-        func.init(stack.size());
-        long i = 0;
-        for (auto& p : stack) {
-            func.data(i).x = p.first;
-            func.data(i).y = p.second;
-            i ++;
+        // Add the kept points to grid
+        func.init(kept.size());
+        for (long i=0; i<kept.size(); i++) {
+            func.data(i).x = data[kept[i]].x;
+            func.data(i).y = data[kept[i]].y;
         }
         
     } catch (std::exception& e) {
@@ -440,17 +807,23 @@ ENDFTabularDistribution<> LS::linearize
         {
             long N = 1000;
             double DX = 1./N;
-            stack.push_back({-1., f.evaluate(-1.)});
+            std::vector<double> xs, ys(2*N+1);
+            xs.reserve(2*N+1);
+            xs.push_back(-1.);
             for (long i=0; i<N-1; i++) {
-                auto x = -1. + (i+1)*DX;
-                stack.push_back({x, f.evaluate(x)});
+                xs.push_back(-1. + (i+1)*DX);
             }
-            stack.push_back({0., f.evaluate(0.)});
+            xs.push_back(0.);
             for (long i=0; i<N-1; i++) {
-                auto x = 0. + (i+1)*DX;
-                stack.push_back({x, f.evaluate(x)});
+                xs.push_back(0. + (i+1)*DX);
+            }
+            xs.push_back(1.);
+            
+            // Evaluate the initial points at once
+            f.evaluate(xs.data(), ys.data(), xs.size());
+            for (long i=0; i<xs.size(); i++) {
+                stack.push_back({xs[i], ys[i]});
             }
-            stack.push_back({1., f.evaluate(1.)});
         }
         
         // Convergece function
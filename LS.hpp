@@ -28,11 +28,47 @@
 //namespace com {
 //namespace ibhe {
 
+// Several functions linearized on one shared energy grid
+// columns[c][i] is the function c at energies[i], a repeated energy is
+// a jump, and a function is zero out of its own energy range
+struct LSJointTable {
+    std::vector<double> energies;
+    std::vector< std::vector<double> > columns;
+    
+    // Points of the input functions, summed over the functions
+    long pointsIn    = 0;
+    // Distinct energies of the input functions
+    long pointsUnion = 0;
+    // Points of the shared grid
+    long pointsOut   = 0;
+};
+
 class LS {
 public:
     
+    // Linearize a function of interpolation laws 1 to 5 to the absolute
+    // tolerance tol. The intervals of the log interpolation laws are
+    // refined on nthreads threads (<= 0 uses all hardware threads), the
+    // result does not depend on the number of threads
     static ENDFInterpolationFunction linearize
     (const ENDFInterpolationFunction& ifunc,
+     double tol, double zeroThres, long nthreads = 1);
+    
+    // Linearize the functions jointly on one grid, refined from the union
+    // of their energies until every function meets the absolute tolerance
+    // tol at the middle point of every interval. All functions are
+    // evaluated at each middle point, so a point added for one serves the
+    // others. The intervals are refined on nthreads threads
+    static LSJointTable linearize
+    (const std::vector<const ENDFInterpolationFunction*>& ifuncs,
+     double tol, double zeroThres, long nthreads = 1);
+    
+    // Remove points of a linear function as long as linear interpolation
+    // over the kept points reproduces every removed point within the
+    // relative tolerance tol, or within zeroThres in absolute value.
+    // Jumps (repeated energies) and both ends are always kept
+    static ENDFInterpolationFunction thin
+    (const ENDFInterpolationFunction& lfunc,
      double tol, double zeroThres);
     
     // Need try one's best to eliminate negative value
@@ -1235,23 +1235,19 @@ bool NDLS::insertENDFFile(const std::string& endfFilepath) {
                     assert(LVL == 4);
                     
                     for (long j=0; j<NJS; j++) {
-                        long KBK = -1, KPS = -1;
+                        long KBK = -1, KPS = -1, NCH = -1;
                         
                         ID[LVL]=ReadList(LVL, IDX[LVL], [&] (const ENDFRecord& record)
                         {
                             KBK = record.nums[2];
                             KPS = record.nums[3];
+                            NCH = record.nums[5];
                         });
                         if(addInheritanceTableEntry(ID[LVL-1], ID[LVL]) == -1) {
                             throw std::logic_error("add inheritance error!");
                         }
                         
-                        long NCH = -1;
-                        
-                        ID[LVL]=ReadList(LVL, IDX[LVL], [&] (const ENDFRecord& record)
-                        {
-                            NCH = record.nums[5];
-                        });
+                        ID[LVL]=ReadList(LVL, IDX[LVL]);
                         if(addInheritanceTableEntry(ID[LVL-1], ID[LVL]) == -1) {
                             throw std::logic_error("add inheritance error!");
                         }
@@ -3913,7 +3909,82 @@ ENDFNeutronData* NDLS::getNeutronDataByHeader(const ENDFMaterialHeader& hmat) {
     auto readResonanceFile2LRU1LRF7 =
     [this] (ENDFNeutronData::Resonance::Range& range, long rangeChildId) {
         auto propertyChildrenId = getChildrenId(rangeChildId);
+        auto header = getHeader(propertyChildrenId[0]);
+        range.IFG  = header.L1;
+        range.KRM  = header.L2;
+        range.KRL  = header.N2;
+        long NJS   = header.N1;
+        
+        // Particle pairs
+        auto list = getList(propertyChildrenId[1]);
+        long NPP  = list.header.L1;
+        range.pairs.resize(NPP);
+        for (long p=0; p<NPP; p++) {
+            auto& pair = range.pairs[p];
+            pair.MA  = list.array[12*p];
+            pair.MB  = list.array[12*p+1];
+            pair.ZA  = list.array[12*p+2];
+            pair.ZB  = list.array[12*p+3];
+            pair.IA  = list.array[12*p+4];
+            pair.IB  = list.array[12*p+5];
+            pair.Q   = list.array[12*p+6];
+            pair.PNT = lround(list.array[12*p+7]);
+            pair.SHF = lround(list.array[12*p+8]);
+            pair.MT  = lround(list.array[12*p+9]);
+            pair.PA  = list.array[12*p+10];
+            pair.PB  = list.array[12*p+11];
+        }
         
+        // Spin groups, the background R-matrices and the tabulated
+        // phase shifts are skipped
+        auto groupChildrenId = getChildrenId(propertyChildrenId[1]);
+        range.spinGroups.resize(NJS);
+        long idx = 0;
+        for (long j=0; j<NJS; j++) {
+            auto& group = range.spinGroups[j];
+            auto glist = getList(groupChildrenId[idx++]);
+            group.AJ  = glist.header.C1;
+            group.PJ  = glist.header.C2;
+            group.KBK = glist.header.L1;
+            group.KPS = glist.header.L2;
+            long NCH  = glist.header.N2;
+            group.channels.resize(NCH);
+            for (long ch=0; ch<NCH; ch++) {
+                auto& channel = group.channels[ch];
+                channel.PPI = lround(glist.array[6*ch]);
+                channel.L   = lround(glist.array[6*ch+1]);
+                channel.SCH = glist.array[6*ch+2];
+                channel.BND = glist.array[6*ch+3];
+                channel.APE = glist.array[6*ch+4];
+                channel.APT = glist.array[6*ch+5];
+            }
+            
+            // Each resonance takes whole lines of six values
+            auto rlist = getList(groupChildrenId[idx++]);
+            long NRS  = rlist.header.L2;
+            long NV   = (NRS > 0) ? rlist.header.N1/NRS : 0;
+            group.ER.resize(NRS);
+            group.GAM.resize(NRS*NCH);
+            for (long r=0; r<NRS; r++) {
+                group.ER[r] = rlist.array[NV*r];
+                for (long ch=0; ch<NCH; ch++) {
+                    group.GAM[r*NCH+ch] = rlist.array[NV*r+1+ch];
+                }
+            }
+            
+            for (long k=0; k<2; k++) {
+                if ((k == 0 && group.KBK <= 0) ||
+                    (k == 1 && group.KPS <= 0)) {
+                    continue;
+                }
+                for (long ch=0; ch<NCH; ch++) {
+                    auto option = getList(groupChildrenId[idx++]);
+                    if (option.header.N1 == 1) {
+                        idx += 2;
+                    }
+                }
+            }
+        }
     };
     
     auto readResonanceFile2LRU1 =
@@ -3936,8 +4007,117 @@ ENDFNeutronData* NDLS::getNeutronDataByHeader(const ENDFMaterialHeader& hmat) {
     };
     
     auto readResonanceFile2LRU2 =
-    [&,this] (ENDFNeutronData::Resonance::Range& range, long rangeChildId) {
-        
+    [&,this] (ENDFNeutronData::Resonance::Range& range, long LFW,
+              long rangeChildId) {
+        auto propertyChildrenId = getChildrenId(rangeChildId);
+        if (range.LRF == 1 && LFW == 0) {
+            // Case A, energy independent parameters
+            auto header = getHeader(propertyChildrenId[0]);
+            range.SPI  = header.C1;
+            range.AP   = header.C2;
+            range.LSSF = header.L1;
+            long NLS = header.N1;
+            range.moments.resize(NLS);
+            auto momentumChildrenId = getChildrenId(propertyChildrenId[0]);
+            
+            for (long l=0; l<NLS; l++) {
+                auto list = getList(momentumChildrenId[l]);
+                auto& momentum = range.moments[l];
+                momentum.AWRI = list.header.C1;
+                momentum.L    = list.header.L1;
+                long NJS      = list.header.N2;
+                auto& atable  = momentum.URRTables.atable;
+                atable.resize(NJS);
+                
+                for (long j=0; j<NJS; j++) {
+                    atable[j].D    = list.array[6*j];
+                    atable[j].AJ   = list.array[6*j+1];
+                    atable[j].AMUN = list.array[6*j+2];
+                    atable[j].GNO  = list.array[6*j+3];
+                    atable[j].GG   = list.array[6*j+4];
+                }
+            }
+        } else if (range.LRF == 1 && LFW == 1) {
+            // Case B, energy dependent fission widths
+            auto list = getList(propertyChildrenId[0]);
+            range.SPI    = list.header.C1;
+            range.AP     = list.header.C2;
+            range.LSSF   = list.header.L1;
+            range.URRBES = list.array;
+            long NE  = list.header.N1;
+            long NLS = list.header.N2;
+            range.moments.resize(NLS);
+            auto momentumChildrenId = getChildrenId(propertyChildrenId[0]);
+            
+            for (long l=0; l<NLS; l++) {
+                auto header = getHeader(momentumChildrenId[l]);
+                auto& momentum = range.moments[l];
+                momentum.AWRI = header.C1;
+                momentum.L    = header.L1;
+                long NJS      = header.N1;
+                auto& btable  = momentum.URRTables.btable;
+                btable.resize(NJS);
+                auto spinChildrenId = getChildrenId(momentumChildrenId[l]);
+                
+                for (long j=0; j<NJS; j++) {
+                    auto jlist = getList(spinChildrenId[j]);
+                    btable[j].L    = jlist.header.L1;
+                    btable[j].MUF  = jlist.header.L2;
+                    btable[j].D    = jlist.array[0];
+                    btable[j].AJ   = jlist.array[1];
+                    btable[j].AMUN = jlist.array[2];
+                    btable[j].GNO  = jlist.array[3];
+                    btable[j].GG   = jlist.array[4];
+                    btable[j].GF.assign
+                    (jlist.array.begin() + 6, jlist.array.begin() + 6 + NE);
+                }
+            }
+        } else if (range.LRF == 2) {
+            // Case C, all parameters energy dependent
+            auto header = getHeader(propertyChildrenId[0]);
+            range.SPI  = header.C1;
+            range.AP   = header.C2;
+            range.LSSF = header.L1;
+            long NLS = header.N1;
+            range.moments.resize(NLS);
+            auto momentumChildrenId = getChildrenId(propertyChildrenId[0]);
+            
+            for (long l=0; l<NLS; l++) {
+                auto lheader = getHeader(momentumChildrenId[l]);
+                auto& momentum = range.moments[l];
+                momentum.AWRI = lheader.C1;
+                momentum.L    = lheader.L1;
+                long NJS      = lheader.N1;
+                auto& ctable  = momentum.URRTables.ctable;
+                ctable.resize(NJS);
+                auto spinChildrenId = getChildrenId(momentumChildrenId[l]);
+                
+                for (long j=0; j<NJS; j++) {
+                    auto jlist = getList(spinChildrenId[j]);
+                    auto& table = ctable[j];
+                    table.AJ   = jlist.header.C1;
+                    table.INT  = jlist.header.L1;
+                    table.AMUX = jlist.array[2];
+                    table.AMUN = jlist.array[3];
+                    table.AMUG = jlist.array[4];
+                    table.AMUF = jlist.array[5];
+                    long NE = jlist.header.N2;
+                    table.records.resize(NE);
+                    
+                    for (long e=0; e<NE; e++) {
+                        auto& record = table.records[e];
+                        record.ES  = jlist.array[6*e+6];
+                        record.D   = jlist.array[6*e+7];
+                        record.GX  = jlist.array[6*e+8];
+                        record.GNO = jlist.array[6*e+9];
+                        record.GG  = jlist.array[6*e+10];
+                        record.GF  = jlist.array[6*e+11];
+                    }
+                }
+            }
+        } else {
+            throw std::logic_error("unknown range representation!");
+        }
     };
     
     auto getDataFromFile2 = [&,this] () {
@@ -3976,8 +4156,10 @@ ENDFNeutronData* NDLS::getNeutronDataByHeader(const ENDFMaterialHeader& hmat) {
                     readResonanceFile2LRU0(range, rangeChildrenId[er]);
                 } else if (range.LRU == 1) {
                     readResonanceFile2LRU1(range, rangeChildrenId[er]);
+                    range.compile();
                 } else if (range.LRU == 2) {
-                    readResonanceFile2LRU2(range, rangeChildrenId[er]);
+                    readResonanceFile2LRU2
+                    (range, resonance.LFW, rangeChildrenId[er]);
                 }
             }
         }
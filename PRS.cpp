@@ -0,0 +1,106 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "PRS.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//namespace com {
+//namespace ibhe {
+
+long PRS::numThreads(long nthreads) {
+    if (nthreads > 0) {
+        return nthreads;
+    }
+    long n = std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+
+void PRS::parallelFor
+(long N, long nthreads, long chunk,
+ const std::function<void(long, long)>& action) {
+
+    // Nothing to do
+    if (N <= 0) {
+        return;
+    }
+
+    if (chunk < 1) {
+        chunk = 1;
+    }
+
+    // Never start more threads than chunks
+    long nchunks = (N + chunk - 1) / chunk;
+    long nworker = std::min(numThreads(nthreads), nchunks);
+
+    // Serial path
+    if (nworker <= 1) {
+        for (long begin=0; begin<N; begin+=chunk) {
+            action(begin, std::min(begin + chunk, N));
+        }
+        return;
+    }
+
+    // The next chunk to be handed out
+    std::atomic<long> next(0);
+
+    // The first captured exception
+    std::exception_ptr error = nullptr;
+    std::mutex errorMutex;
+
+    auto worker = [&] () {
+        try {
+            while (true) {
+                long begin = next.fetch_add(chunk);
+                if (begin >= N) {
+                    break;
+                }
+                action(begin, std::min(begin + chunk, N));
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (error == nullptr) {
+                error = std::current_exception();
+            }
+            // Stop handing out further chunks
+            next.store(N);
+        }
+    };
+
+    // The calling thread works as well
+    std::vector<std::thread> threads;
+    threads.reserve(nworker - 1);
+    for (long t=0; t<nworker-1; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+}
+
+//}
+//}
@@ -0,0 +1,51 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+// Parallel Runtime System (PRS)
+
+#ifndef PRS_HPP
+#define PRS_HPP
+
+#include <iostream>
+#include <functional>
+
+//namespace com {
+//namespace ibhe {
+
+class PRS {
+public:
+
+    // Resolve the number of worker threads
+    // nthreads <= 0 means using all hardware threads
+    static long numThreads(long nthreads);
+
+    // Apply action(begin, end) on the index range [0, N)
+    // The range is cut into chunks of the given size, the chunks are
+    // handed out to the worker threads dynamically, so the work per
+    // index does not need to be uniform. With a single thread the
+    // chunks are processed in order on the calling thread.
+    // The first exception thrown by any action is rethrown
+    static void parallelFor
+    (long N, long nthreads, long chunk,
+     const std::function<void(long, long)>& action);
+
+};
+
+//}
+//}
+
+#endif /* PRS_HPP */
@@ -0,0 +1,293 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "PTS.hpp"
+#include "PRS.hpp"
+#include "WMP.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <random>
+#include <vector>
+#include <cmath>
+
+//namespace com {
+//namespace ibhe {
+
+typedef ENDFNeutronData::Resonance::Xsec PTSXsec;
+
+// Half width of a ladder in the largest level spacing, the cross
+// sections are sampled within the central half of the ladder
+static const double ptsLadderSpacings = 100.;
+
+// Beyond this many Doppler widths from a resonance its line shape is
+// taken at 0K
+static const double ptsDopplerWidths = 30.;
+
+// Samples of the cross sections per ladder
+static const long ptsSamplesPerLadder = 128;
+
+// Energies per decade of ranges with energy independent parameters
+static const long ptsEnergiesPerDecade = 10;
+
+// A spin sequence of an isotope and the abundance of the isotope
+struct PTSSequence {
+    ENDFNeutronData::Resonance::Range::Sequence seq;
+    double ABN = 1.;
+};
+
+// Sample x^2/n of the chi-square distribution of n degrees of freedom,
+// one for n = 0
+static double PTSChiSquare(double n, std::mt19937_64& rng) {
+    if (n <= 0.) {
+        return 1.;
+    }
+    std::chi_squared_distribution<double> chi(n);
+    return chi(rng)/n;
+}
+
+// Sample one ladder of resonances around E and the cross sections at
+// ptsSamplesPerLadder energies within it, at each temperature
+static void PTSSampleLadder
+(double E, const std::vector<PTSSequence>& seqs, double potential,
+ const std::vector<double>& tempKs, std::mt19937_64& rng,
+ PTSXsec* samples) {
+    
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    
+    double Dmax = 0.;
+    for (auto& s : seqs) {
+        Dmax = std::max(Dmax, s.seq.D);
+    }
+    double H = ptsLadderSpacings*Dmax;
+    
+    // The resonances, with the peak cross section, the total width,
+    // the elastic shape factors and the branching ratios
+    std::vector<double> Er, sigma0, G, shape, inter, rcap, rfis;
+    std::vector<long> group;
+    for (long q=0; q<seqs.size(); q++) {
+        auto& s = seqs[q].seq;
+        if (s.D <= 0.) {
+            continue;
+        }
+        double c = 4*M_PI/(s.K*s.K)*s.GJ*seqs[q].ABN;
+        double e = E - H - s.D*uniform(rng);
+        while (e < E + H) {
+            double GN = s.GN*PTSChiSquare(s.AMUN, rng);
+            double GG = s.GG*PTSChiSquare(s.AMUG, rng);
+            double GF = s.GF*PTSChiSquare(s.AMUF, rng);
+            double GX = s.GX*PTSChiSquare(s.AMUX, rng);
+            double GT = GN + GG + GF + GX;
+            if (GT > 0.) {
+                Er.push_back(e);
+                sigma0.push_back(c*GN/GT);
+                G.push_back(GT);
+                shape.push_back(cos(2*s.PS) - 1 + GN/GT);
+                inter.push_back(sin(2*s.PS));
+                rcap.push_back(GG/GT);
+                rfis.push_back(GF/GT);
+                group.push_back(q);
+            }
+            // Wigner distribution of the level spacings
+            e += s.D*sqrt(-4/M_PI*log(1 - uniform(rng)));
+        }
+    }
+    
+    // Doppler widths of the sequences at each temperature
+    long nt = tempKs.size();
+    std::vector<double> delta(seqs.size()*nt);
+    for (long q=0; q<seqs.size(); q++) {
+        for (long t=0; t<nt; t++) {
+            delta[q*nt + t] =
+            sqrt(4*CMS::BoltzmannEvK*tempKs[t]*E/seqs[q].seq.AWRI);
+        }
+    }
+    
+    const double sqrtPi = sqrt(M_PI);
+    std::vector<PTSXsec> xs(nt);
+    for (long i=0; i<ptsSamplesPerLadder; i++) {
+        double es = E + H*(uniform(rng) - 0.5);
+        for (auto& x : xs) {
+            x = PTSXsec();
+            x.potential = potential;
+            x.elastic   = potential;
+        }
+        for (long r=0; r<Er.size(); r++) {
+            double x    = 2*(es - Er[r])/G[r];
+            double psi0 = 1/(1 + x*x);
+            double chi0 = x*psi0;
+            for (long t=0; t<nt; t++) {
+                double d = delta[group[r]*nt + t];
+                double psi = psi0, chi = chi0;
+                if (fabs(es - Er[r]) < ptsDopplerWidths*d) {
+                    double theta = G[r]/d;
+                    auto w = WMP::faddeeva
+                    (std::complex<double>(0.5*theta*x, 0.5*theta));
+                    psi = 0.5*sqrtPi*theta*w.real();
+                    chi = 0.5*sqrtPi*theta*w.imag();
+                }
+                xs[t].elastic += sigma0[r]*(shape[r]*psi + inter[r]*chi);
+                xs[t].capture += sigma0[r]*rcap[r]*psi;
+                xs[t].fission += sigma0[r]*rfis[r]*psi;
+            }
+        }
+        for (long t=0; t<nt; t++) {
+            xs[t].total = xs[t].elastic + xs[t].capture + xs[t].fission;
+            samples[i*nt + t] = xs[t];
+        }
+    }
+}
+
+// Accumulate w*b into a
+static void PTSAccumulate(PTSXsec& a, const PTSXsec& b, double w) {
+    a.total     += w*b.total;
+    a.elastic   += w*b.elastic;
+    a.fission   += w*b.fission;
+    a.capture   += w*b.capture;
+    a.potential += w*b.potential;
+}
+
+PTSData PTS::generate
+(const ENDFNeutronData* ndata, const std::vector<double>& tempKs,
+ long nbands, long nladders, unsigned long seed, long nthreads) {
+    
+    PTSData data;
+    
+    try {
+        
+        if (ndata == nullptr) {
+            throw std::logic_error("neutron data not valid!");
+        }
+        
+        if (nbands < 1 || nladders < 1) {
+            throw std::logic_error("invalid number of bands or ladders!");
+        }
+        
+        data.tempKs = tempKs;
+        
+        // The unresolved ranges and the energies of their parameters
+        std::vector<std::pair<const ENDFNeutronData::Resonance*,
+        const ENDFNeutronData::Resonance::Range*> > ranges;
+        for (auto& resonance : ndata->resonances) {
+            for (auto& range : resonance.ranges) {
+                if (range.LRU != 2 || range.EH <= range.EL) {
+                    continue;
+                }
+                ranges.push_back(std::make_pair(&resonance, &range));
+                data.LSSF = range.LSSF;
+                auto energies = range.parameterEnergies(resonance.LFW);
+                if (energies.empty()) {
+                    long n = std::max<long>
+                    (1, ceil(ptsEnergiesPerDecade*log10(range.EH/range.EL)));
+                    for (long i=1; i<n; i++) {
+                        energies.push_back
+                        (range.EL*pow(range.EH/range.EL, double(i)/n));
+                    }
+                }
+                energies.push_back(range.EL);
+                energies.push_back(range.EH);
+                data.energies.insert
+                (data.energies.end(), energies.begin(), energies.end());
+            }
+        }
+        std::sort(data.energies.begin(), data.energies.end());
+        data.energies.erase
+        (std::unique(data.energies.begin(), data.energies.end()),
+         data.energies.end());
+        if (ranges.empty()) {
+            std::cerr << "[PTS]: no unresolved resonance range" << std::endl;
+            return data;
+        }
+        
+        long nt = tempKs.size();
+        long ns = nladders*ptsSamplesPerLadder;
+        std::vector<PTSXsec> samples(ns*nt);
+        std::vector<long> order(ns);
+        data.tables.resize(data.energies.size()*nt);
+        
+        for (long e=0; e<data.energies.size(); e++) {
+            double E = data.energies[e];
+            
+            // The spin sequences of the ranges covering E
+            std::vector<PTSSequence> seqs;
+            std::vector<ENDFNeutronData::Resonance::Range::Sequence> rseqs;
+            double potential = 0.;
+            for (auto& r : ranges) {
+                if (E < r.second->EL || E > r.second->EH) {
+                    continue;
+                }
+                potential +=
+                r.first->ABN*r.second->sequences(E, r.first->LFW, rseqs);
+                for (auto& s : rseqs) {
+                    PTSSequence p;
+                    p.seq = s;
+                    p.ABN = r.first->ABN;
+                    seqs.push_back(p);
+                }
+            }
+            
+            PRS::parallelFor(nladders, nthreads, 1, [&] (long b, long f) {
+                for (long l=b; l<f; l++) {
+                    std::seed_seq seeds
+                    {(unsigned long)(seed), (unsigned long)(e),
+                     (unsigned long)(l)};
+                    std::mt19937_64 rng(seeds);
+                    PTSSampleLadder
+                    (E, seqs, potential, tempKs, rng,
+                     &samples[l*ptsSamplesPerLadder*nt]);
+                }
+            });
+            
+            // Bin the samples of each temperature by the total
+            for (long t=0; t<nt; t++) {
+                auto& table = data.tables[e*nt + t];
+                table.energy = E;
+                table.tempK  = tempKs[t];
+                for (long i=0; i<ns; i++) {
+                    order[i] = i;
+                    PTSAccumulate(table.average, samples[i*nt + t], 1./ns);
+                }
+                std::stable_sort(order.begin(), order.end(),
+                                 [&] (long i, long j) {
+                    return samples[i*nt + t].total < samples[j*nt + t].total;
+                });
+                long nb = std::min(nbands, ns);
+                table.probability.resize(nb);
+                table.bands.resize(nb);
+                for (long k=0; k<nb; k++) {
+                    long first = k*ns/nb;
+                    long last  = (k+1)*ns/nb;
+                    table.probability[k] = double(last - first)/ns;
+                    for (long i=first; i<last; i++) {
+                        PTSAccumulate
+                        (table.bands[k], samples[order[i]*nt + t],
+                         1./(last - first));
+                    }
+                }
+            }
+        }
+        
+    } catch (std::exception& e) {
+        std::cerr << "[PTS]: error msg - " << e.what() << std::endl;
+        data = PTSData();
+    }
+    
+    return data;
+}
+
+//}
+//}
@@ -0,0 +1,94 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+// Probability Table System (PTS)
+
+#ifndef PTS_HPP
+#define PTS_HPP
+
+#include <iostream>
+#include <vector>
+
+#include "CMS.hpp"
+#include "ENDF.hpp"
+
+//namespace com {
+//namespace ibhe {
+
+// Probability table of the unresolved range at one energy and
+// temperature. The samples of the cross sections are binned by their
+// total into bands of equal probability, each band keeps the average
+// cross sections of its samples
+struct PTSTable {
+    double energy = 0.;
+    double tempK  = 0.;
+    
+    // Probability of each band, in increasing order of the total
+    std::vector<double> probability;
+    std::vector<ENDFNeutronData::Resonance::Xsec> bands;
+    
+    // Average of all samples
+    ENDFNeutronData::Resonance::Xsec average;
+};
+
+// Probability tables of the unresolved ranges of a material
+struct PTSData {
+    
+    // The File 3 interpretation flag of the unresolved range, with
+    // LSSF = 1 the tables are to be used as factors of the averages
+    long LSSF = -1;
+    
+    std::vector<double> energies;
+    std::vector<double> tempKs;
+    
+    // The table of energy e and temperature t is at e*tempKs.size() + t
+    std::vector<PTSTable> tables;
+    
+    bool valid() const {
+        return !tables.empty();
+    }
+    
+    const PTSTable& table(long e, long t) const {
+        return tables[e*tempKs.size() + t];
+    }
+};
+
+class PTS {
+public:
+    
+    // Generate the probability tables of the unresolved ranges (LRU=2)
+    // of ndata at the energies the parameters are given at, and the
+    // temperatures tempKs. At each energy, nladders ladders of
+    // resonances are sampled from the statistics of the spin sequences
+    // and the single level cross sections, Doppler broadened, are
+    // sampled within them. The ladders are sampled on nthreads threads,
+    // each from its own random stream seeded by seed, the energy and
+    // the ladder, so the tables do not depend on nthreads. The
+    // competitive width only adds to the total width, the total is
+    // the sum of elastic, fission and capture. The data is empty on
+    // error
+    static PTSData generate
+    (const ENDFNeutronData* ndata, const std::vector<double>& tempKs,
+     long nbands = 20, long nladders = 64, unsigned long seed = 1,
+     long nthreads = 1);
+    
+};
+
+//}
+//}
+
+#endif /* PTS_HPP */
@@ -0,0 +1,668 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+#include "WMP.hpp"
+#include "PRS.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+//namespace com {
+//namespace ibhe {
+
+typedef std::complex<double> WMPComplex;
+
+// Initial average number of poles per window
+static const long wmpPolesPerWindow = 8;
+
+// Order of the background polynomials
+static const long wmpOrder = 8;
+
+// Maximum number of window halvings
+static const long wmpMaxRefinements = 6;
+
+// Doppler widths at the maximum temperature kept around a window
+static const double wmpDopplerWidths = 6.;
+
+// Uniform fit points per unknown of a window
+static const long wmpPointsPerUnknown = 4;
+
+// Offsets of the fit points around a pole, in units of Im(p)
+static const double wmpPoleOffsets[] = {
+    -16., -8., -4., -2., -1., -0.5, 0., 0.5, 1., 2., 4., 8., 16.
+};
+
+// Number of terms of the Weideman rational approximation
+static const long wmpWeidemanTerms = 32;
+
+// Coefficients of Weideman's approximation of the Faddeeva function
+// J.A.C. Weideman, SIAM J. Numer. Anal. 31 (1994) 1497-1518
+struct WMPWeideman {
+    double L;
+    double a[wmpWeidemanTerms+1];
+    WMPWeideman() {
+        long N  = wmpWeidemanTerms;
+        long M  = 2*N;
+        long M2 = 2*M;
+        L = sqrt(N/sqrt(2.));
+        
+        // Samples of exp(-t^2)*(L^2 + t^2), t = L*tan(theta/2)
+        std::vector<double> f(M2, 0.);
+        for (long k=-M+1; k<M; k++) {
+            double t = L*tan(0.5*k*M_PI/M);
+            f[(k + 2*M) % M2] = exp(-t*t)*(L*L + t*t);
+        }
+        
+        // The real part of the discrete Fourier transform
+        for (long n=0; n<=N; n++) {
+            double s = 0.;
+            for (long i=0; i<M2; i++) {
+                s += f[i]*cos(2*M_PI*n*i/M2);
+            }
+            a[n] = s/M2;
+        }
+    }
+};
+
+WMPComplex WMP::faddeeva(WMPComplex z) {
+    const WMPComplex I(0., 1.);
+    double r = std::abs(z);
+    
+    // Laplace continued fraction far from the origin
+    if (r >= 6.) {
+        long       n = (r >= 100.) ? 2 : ((r >= 20.) ? 6 : 16);
+        WMPComplex t = 0.;
+        for (long k=n; k>=1; k--) {
+            t = (0.5*k)/(z - t);
+        }
+        return I/(sqrt(M_PI)*(z - t));
+    }
+    
+    static const WMPWeideman w;
+    WMPComplex d = w.L - I*z;
+    WMPComplex Z = (w.L + I*z)/d;
+    WMPComplex p = 0.;
+    for (long n=wmpWeidemanTerms; n>=1; n--) {
+        p = p*Z + w.a[n];
+    }
+    return 2.*p/(d*d) + (1./sqrt(M_PI))/d;
+}
+
+// Least squares solution of the m x n system a*x = b, a is row major
+// By Householder QR with column pivoting, the columns left with
+// negligible norm get zero coefficients. a and b are destroyed
+static std::vector<double> WMPLeastSquares
+(std::vector<double>& a, long m, long n, std::vector<double>& b) {
+    
+    // Scale the columns to unit norm
+    std::vector<double> scale(n, 0.);
+    for (long j=0; j<n; j++) {
+        double s = 0.;
+        for (long i=0; i<m; i++) {
+            s += a[i*n+j]*a[i*n+j];
+        }
+        scale[j] = (s > 0.) ? 1./sqrt(s) : 0.;
+        for (long i=0; i<m; i++) {
+            a[i*n+j] *= scale[j];
+        }
+    }
+    
+    std::vector<long> perm(n);
+    for (long j=0; j<n; j++) {
+        perm[j] = j;
+    }
+    long rank = 0;
+    long kmax = std::min(m, n);
+    for (long k=0; k<kmax; k++) {
+        
+        // The column of largest remaining norm
+        long   piv  = k;
+        double best = -1.;
+        for (long j=k; j<n; j++) {
+            double s = 0.;
+            for (long i=k; i<m; i++) {
+                s += a[i*n+j]*a[i*n+j];
+            }
+            if (s > best) {
+                best = s;
+                piv  = j;
+            }
+        }
+        if (best <= 1E-26) {
+            break;
+        }
+        if (piv != k) {
+            for (long i=0; i<m; i++) {
+                std::swap(a[i*n+k], a[i*n+piv]);
+            }
+            std::swap(perm[k], perm[piv]);
+        }
+        
+        // The Householder reflection of column k
+        double norm = sqrt(best);
+        double alpha = (a[k*n+k] > 0.) ? -norm : norm;
+        a[k*n+k] -= alpha;
+        double vnorm2 = 0.;
+        for (long i=k; i<m; i++) {
+            vnorm2 += a[i*n+k]*a[i*n+k];
+        }
+        for (long j=k+1; j<n; j++) {
+            double s = 0.;
+            for (long i=k; i<m; i++) {
+                s += a[i*n+k]*a[i*n+j];
+            }
+            s *= 2./vnorm2;
+            for (long i=k; i<m; i++) {
+                a[i*n+j] -= s*a[i*n+k];
+            }
+        }
+        double s = 0.;
+        for (long i=k; i<m; i++) {
+            s += a[i*n+k]*b[i];
+        }
+        s *= 2./vnorm2;
+        for (long i=k; i<m; i++) {
+            b[i] -= s*a[i*n+k];
+        }
+        a[k*n+k] = alpha;
+        rank ++;
+    }
+    
+    // Back substitution on the columns of full rank
+    std::vector<double> y(n, 0.);
+    for (long k=rank-1; k>=0; k--) {
+        double s = b[k];
+        for (long j=k+1; j<rank; j++) {
+            s -= a[k*n+j]*y[j];
+        }
+        y[k] = s/a[k*n+k];
+    }
+    std::vector<double> x(n, 0.);
+    for (long k=0; k<n; k++) {
+        x[perm[k]] = y[k]*scale[perm[k]];
+    }
+    return x;
+}
+
+// Sum the pole terms and the polynomials of window w at u, broadened
+// with the Doppler width delta in u, into f (E times the cross sections)
+static void WMPEvaluateWindow
+(const WMPIsotope& iso, long w, double u, double delta, double* f) {
+    const WMPComplex I(0., 1.);
+    
+    for (long x=0; x<WMP_NREACTIONS; x++) {
+        f[x] = 0.;
+    }
+    for (long q=iso.windowBegin[w]; q<iso.windowBegin[w+1]; q++) {
+        WMPComplex c;
+        if (delta > 0.) {
+            c = (-I*sqrt(M_PI)/delta)*WMP::faddeeva((iso.poles[q] - u)/delta);
+        } else {
+            c = 1./(iso.poles[q] - u);
+        }
+        const WMPComplex* r = &iso.residues[q*WMP_NREACTIONS];
+        for (long x=0; x<WMP_NREACTIONS; x++) {
+            f[x] += r[x].real()*c.real() - r[x].imag()*c.imag();
+        }
+    }
+    
+    // The Gaussian moments of s^k, by the recurrence
+    // M(k+1) = s*M(k) + k*v*M(k-1), v = (delta/h)^2/2
+    double h = 0.5*iso.spacing;
+    double s = (u - (iso.uMin + (w + 0.5)*iso.spacing))/h;
+    double v = 0.5*(delta/h)*(delta/h);
+    long   K = iso.order + 1;
+    double moments[wmpOrder+1];
+    moments[0] = 1.;
+    if (K > 1) {
+        moments[1] = s;
+    }
+    for (long k=1; k+1<K; k++) {
+        moments[k+1] = s*moments[k] + k*v*moments[k-1];
+    }
+    for (long x=0; x<WMP_NREACTIONS; x++) {
+        const double* c = &iso.background[(w*WMP_NREACTIONS + x)*K];
+        for (long k=0; k<K; k++) {
+            f[x] += c[k]*moments[k];
+        }
+    }
+}
+
+// Number of Gauss-Legendre points per panel of the free gas integrals
+static const long wmpGaussPoints = 16;
+
+// Number of panels of the free gas integrals
+static const long wmpGaussPanels = 4;
+
+// Gauss-Legendre nodes and weights on [-1, 1]
+struct WMPGaussLegendre {
+    double x[wmpGaussPoints];
+    double w[wmpGaussPoints];
+    WMPGaussLegendre() {
+        long n = wmpGaussPoints;
+        for (long i=0; i<n; i++) {
+            // Newton's method on the Legendre polynomial of degree n
+            double z = cos(M_PI*(i + 0.75)/(n + 0.5)), dp = 1.;
+            for (long it=0; it<100; it++) {
+                double p0 = 1., p1 = z;
+                for (long k=2; k<=n; k++) {
+                    double p2 = ((2*k-1)*z*p1 - (k-1)*p0)/k;
+                    p0 = p1;
+                    p1 = p2;
+                }
+                dp = n*(z*p1 - p0)/(z*z - 1.);
+                double dz = p1/dp;
+                z -= dz;
+                if (fabs(dz) < 1E-15) {
+                    break;
+                }
+            }
+            x[i] = z;
+            w[i] = 2./((1. - z*z)*dp*dp);
+        }
+    }
+};
+
+// The pole terms are broadened with the Gaussian in u, which leaves out
+// the neutrons moving against the nucleus. Within a few Doppler widths
+// of u = 0 the free gas kernel
+//   (1/(sqrt(pi)*delta)) * [exp(-(u'-u)^2/delta^2) - exp(-(u'+u)^2/delta^2)]
+// is integrated over u' > 0 with the cross sections at 0K instead
+static void WMPEvaluateFreeGas
+(const WMPIsotope& iso, double u, double delta, double* f) {
+    static const WMPGaussLegendre gauss;
+    
+    for (long x=0; x<WMP_NREACTIONS; x++) {
+        f[x] = 0.;
+    }
+    double upper = u + wmpDopplerWidths*delta;
+    double panel = upper/wmpGaussPanels;
+    for (long k=0; k<wmpGaussPanels; k++) {
+        for (long i=0; i<wmpGaussPoints; i++) {
+            double v = panel*(k + 0.5 + 0.5*gauss.x[i]);
+            long   w = long((v - iso.uMin)/iso.spacing);
+            w = std::max(0L, std::min(w, iso.numWindows() - 1));
+            double y[WMP_NREACTIONS];
+            WMPEvaluateWindow(iso, w, v, 0., y);
+            double a = (v - u)/delta, b = (v + u)/delta;
+            double kernel = 0.5*panel*gauss.w[i]*
+            (exp(-a*a) - exp(-b*b))/(sqrt(M_PI)*delta);
+            for (long x=0; x<WMP_NREACTIONS; x++) {
+                f[x] += kernel*y[x];
+            }
+        }
+    }
+}
+
+ENDFNeutronData::Resonance::Xsec
+WMPData::evaluate(double energyEv, double tempK) const {
+    
+    if (energyEv < 0. || tempK < 0.) {
+        throw std::logic_error("negative energy or temperature!");
+    }
+    
+    ENDFNeutronData::Resonance::Xsec xsec;
+    double u = sqrt(energyEv);
+    for (auto& iso : isotopes) {
+        if (u < iso.uMin || u > iso.uMax || energyEv == 0.) {
+            continue;
+        }
+        if (iso.order > wmpOrder) {
+            throw std::logic_error("unsupport multipole order!");
+        }
+        long w = long((u - iso.uMin)/iso.spacing);
+        w = std::max(0L, std::min(w, iso.numWindows() - 1));
+        
+        double delta = sqrt(CMS::BoltzmannEvK*tempK/iso.AWR);
+        double f[WMP_NREACTIONS];
+        if (delta > 0. && u < wmpDopplerWidths*delta) {
+            WMPEvaluateFreeGas(iso, u, delta, f);
+        } else {
+            WMPEvaluateWindow(iso, w, u, delta, f);
+        }
+        
+        double factor = iso.ABN/energyEv;
+        xsec.elastic += factor*f[WMP_ELASTIC];
+        xsec.capture += factor*f[WMP_CAPTURE];
+        xsec.fission += factor*f[WMP_FISSION];
+    }
+    xsec.total = xsec.elastic + xsec.capture + xsec.fission;
+    
+    return xsec;
+}
+
+long WMPData::memorySize() const {
+    long size = 0;
+    for (auto& iso : isotopes) {
+        size += iso.windowBegin.size()*sizeof(long);
+        size += iso.poles.size()*sizeof(WMPComplex);
+        size += iso.residues.size()*sizeof(WMPComplex);
+        size += iso.background.size()*sizeof(double);
+    }
+    return size;
+}
+
+// E times the elastic, capture and fission cross sections of range at 0K
+// at the points u, reaction x of point i at i*WMP_NREACTIONS+x
+static std::vector<double> WMPReference
+(const ENDFNeutronData::Resonance::Range& range, long LFW,
+ const std::vector<double>& us) {
+    std::vector<double> energies(us.size());
+    for (long i=0; i<us.size(); i++) {
+        energies[i] = us[i]*us[i];
+    }
+    std::vector<ENDFNeutronData::Resonance::Xsec> xsecs(us.size());
+    range.generate(energies.data(), energies.size(), LFW, xsecs.data());
+    std::vector<double> f(WMP_NREACTIONS*us.size());
+    for (long i=0; i<us.size(); i++) {
+        f[i*WMP_NREACTIONS + WMP_ELASTIC] = energies[i]*xsecs[i].elastic;
+        f[i*WMP_NREACTIONS + WMP_CAPTURE] = energies[i]*xsecs[i].capture;
+        f[i*WMP_NREACTIONS + WMP_FISSION] = energies[i]*xsecs[i].fission;
+    }
+    return f;
+}
+
+// The fit points of [ua, ub], n uniform and a few around each pole
+static std::vector<double> WMPFitPoints
+(double ua, double ub, long n, const WMPComplex* poles, long np) {
+    std::vector<double> us;
+    for (long i=0; i<=n; i++) {
+        us.push_back(ua + (ub - ua)*i/n);
+    }
+    for (long q=0; q<np; q++) {
+        for (auto t : wmpPoleOffsets) {
+            double v = poles[q].real() + t*poles[q].imag();
+            if (v > ua && v < ub) {
+                us.push_back(v);
+            }
+        }
+    }
+    std::sort(us.begin(), us.end());
+    us.erase(std::unique(us.begin(), us.end()), us.end());
+    while (!us.empty() && us.front() <= 0.) {
+        us.erase(us.begin());
+    }
+    return us;
+}
+
+// Least squares fit of reaction x of f in the m x n basis, with the
+// residuals relative to f
+static std::vector<double> WMPFitReaction
+(const std::vector<double>& basis, long m, long n,
+ const std::vector<double>& f, long x) {
+    double fmax = 0.;
+    for (long i=0; i<m; i++) {
+        fmax = std::max(fmax, fabs(f[i*WMP_NREACTIONS + x]));
+    }
+    if (fmax == 0.) {
+        return std::vector<double>(n, 0.);
+    }
+    std::vector<double> a(m*n), b(m);
+    for (long i=0; i<m; i++) {
+        double fi = f[i*WMP_NREACTIONS + x];
+        double wi = 1./std::max(fabs(fi), 1E-8*fmax);
+        for (long j=0; j<n; j++) {
+            a[i*n+j] = wi*basis[i*n+j];
+        }
+        b[i] = wi*fi;
+    }
+    return WMPLeastSquares(a, m, n, b);
+}
+
+// The poles sorted by real part within [lo, hi), as indices
+static void WMPPolesWithin
+(const std::vector<WMPComplex>& sorted, double lo, double hi,
+ long& first, long& last) {
+    auto byReal = [] (const WMPComplex& p, double v) {
+        return p.real() < v;
+    };
+    first = std::lower_bound
+    (sorted.begin(), sorted.end(), lo, byReal) - sorted.begin();
+    last  = std::lower_bound
+    (sorted.begin(), sorted.end(), hi, byReal) - sorted.begin();
+}
+
+// The poles, residues and polynomials of a window, and the maximum
+// relative errors of elastic, capture, fission and total at 0K
+struct WMPWindowFit {
+    std::vector<WMPComplex> poles;
+    std::vector<WMPComplex> residues;
+    std::vector<double>     background;
+    double                  maxRelError[WMP_NREACTIONS+1];
+};
+
+// Fit window w of iso to the cross sections of range at 0K, the residues
+// of the poles near the window and the polynomials together. sorted are
+// the poles by real part. The fit points reach out to margin, so that
+// the poles within margin are fixed by their peaks, and the poles within
+// twice the margin take the tails at the ends
+static WMPWindowFit WMPFitWindow
+(const ENDFNeutronData::Resonance::Range& range, long LFW,
+ const WMPIsotope& iso, long w, const std::vector<WMPComplex>& sorted,
+ double margin) {
+    
+    WMPWindowFit fit;
+    double ua = iso.uMin + w*iso.spacing;
+    double ub = std::min(ua + iso.spacing, iso.uMax);
+    double uc = iso.uMin + (w + 0.5)*iso.spacing;
+    double h  = 0.5*iso.spacing;
+    
+    // The poles near the window
+    long first, last;
+    WMPPolesWithin(sorted, ua - 2*margin, ub + 2*margin, first, last);
+    fit.poles.assign(sorted.begin() + first, sorted.begin() + last);
+    long np = fit.poles.size();
+    long K  = iso.order + 1;
+    long n  = 2*np + K;
+    
+    std::vector<double> us = WMPFitPoints
+    (ua - margin, ub + margin, wmpPointsPerUnknown*n + 16,
+     fit.poles.data(), np);
+    std::vector<double> f = WMPReference(range, LFW, us);
+    long m = us.size();
+    
+    // The basis, Re[1/(p - u)], Re[i/(p - u)] of each pole, s^k
+    std::vector<double> basis(m*n);
+    for (long i=0; i<m; i++) {
+        double* row = &basis[i*n];
+        for (long q=0; q<np; q++) {
+            WMPComplex c = 1./(fit.poles[q] - us[i]);
+            row[2*q]   =  c.real();
+            row[2*q+1] = -c.imag();
+        }
+        double s = (us[i] - uc)/h, sk = 1.;
+        for (long k=0; k<K; k++) {
+            row[2*np+k] = sk;
+            sk *= s;
+        }
+    }
+    
+    fit.residues.assign(np*WMP_NREACTIONS, 0.);
+    fit.background.assign(WMP_NREACTIONS*K, 0.);
+    for (long x=0; x<WMP_NREACTIONS; x++) {
+        auto coeffs = WMPFitReaction(basis, m, n, f, x);
+        for (long q=0; q<np; q++) {
+            fit.residues[q*WMP_NREACTIONS + x] =
+            WMPComplex(coeffs[2*q], coeffs[2*q+1]);
+        }
+        for (long k=0; k<K; k++) {
+            fit.background[x*K + k] = coeffs[2*np+k];
+        }
+    }
+    
+    // Check at 0K halfway between the fit points
+    for (long x=0; x<=WMP_NREACTIONS; x++) {
+        fit.maxRelError[x] = 0.;
+    }
+    std::vector<double> checks;
+    for (long i=0; i+1<us.size(); i++) {
+        double v = 0.5*(us[i] + us[i+1]);
+        if (v >= ua && v <= ub) {
+            checks.push_back(v);
+        }
+    }
+    if (checks.empty()) {
+        return fit;
+    }
+    std::vector<double> g = WMPReference(range, LFW, checks);
+    WMPIsotope one;
+    one.uMin    = uc - h;
+    one.uMax    = uc + h;
+    one.spacing = iso.spacing;
+    one.order   = iso.order;
+    one.windowBegin = {0, np};
+    one.poles       = fit.poles;
+    one.residues    = fit.residues;
+    one.background  = fit.background;
+    for (long i=0; i<checks.size(); i++) {
+        double y[WMP_NREACTIONS];
+        WMPEvaluateWindow(one, 0, checks[i], 0., y);
+        double sum = 0., ref = 0.;
+        for (long x=0; x<WMP_NREACTIONS; x++) {
+            double r = g[i*WMP_NREACTIONS + x];
+            double e = fabs(y[x] - r)/std::max(fabs(r), CMS::zeroThres);
+            fit.maxRelError[x] = std::max(fit.maxRelError[x], e);
+            sum += y[x];
+            ref += r;
+        }
+        double e = fabs(sum - ref)/std::max(fabs(ref), CMS::zeroThres);
+        fit.maxRelError[WMP_NREACTIONS] =
+        std::max(fit.maxRelError[WMP_NREACTIONS], e);
+    }
+    
+    return fit;
+}
+
+WMPData WMP::convert
+(const ENDFNeutronData* ndata, double tol, double tempMaxK, long nthreads) {
+    
+    WMPData data;
+    
+    try {
+        
+        if (ndata == nullptr) {
+            throw std::logic_error("neutron data not valid!");
+        }
+        
+        if (tol <= 0. || tempMaxK < 0.) {
+            throw std::logic_error("invalid multipole parameters!");
+        }
+        
+        double  errors[WMP_NREACTIONS+1] = {};
+        for (auto& resonance : ndata->resonances) {
+            
+            // The first resolved range of the isotope
+            const ENDFNeutronData::Resonance::Range* range = nullptr;
+            for (auto& r : resonance.ranges) {
+                if (r.LRU == 1) {
+                    range = &r;
+                    break;
+                }
+            }
+            if (range == nullptr) {
+                continue;
+            }
+            if (range->LRF < 1 || range->LRF > 3) {
+                throw std::logic_error("unsupport LRF for multipole!");
+            }
+            
+            WMPIsotope iso;
+            iso.ABN   = resonance.ABN;
+            iso.AWR   = range->moments.empty() ?
+            ndata->AWR : range->moments.front().AWRI;
+            iso.uMin  = sqrt(range->EL);
+            iso.uMax  = sqrt(range->EH);
+            iso.order = wmpOrder;
+            if (!(iso.uMax > iso.uMin)) {
+                continue;
+            }
+            
+            auto sorted = range->poles();
+            std::sort(sorted.begin(), sorted.end(),
+                      [] (const WMPComplex& a, const WMPComplex& b) {
+                return a.real() < b.real();
+            });
+            long ninside = 0;
+            for (auto& p : sorted) {
+                if (p.real() >= iso.uMin && p.real() <= iso.uMax) {
+                    ninside ++;
+                }
+            }
+            double delta = sqrt(CMS::BoltzmannEvK*tempMaxK/iso.AWR);
+            
+            // Halve the windows until the fits are within tol
+            long nwindows = std::max(1L, ninside/wmpPolesPerWindow);
+            std::vector<WMPWindowFit> fits;
+            for (long refine=0; refine<=wmpMaxRefinements; refine++) {
+                iso.spacing = (iso.uMax - iso.uMin)/nwindows;
+                double margin =
+                std::max(0.5*iso.spacing, wmpDopplerWidths*delta);
+                fits.assign(nwindows, WMPWindowFit());
+                PRS::parallelFor(nwindows, nthreads, 1, [&] (long b, long e) {
+                    for (long w=b; w<e; w++) {
+                        fits[w] = WMPFitWindow
+                        (*range, resonance.LFW, iso, w, sorted, margin);
+                    }
+                });
+                double error = 0.;
+                for (auto& fit : fits) {
+                    for (long x=0; x<=WMP_NREACTIONS; x++) {
+                        error = std::max(error, fit.maxRelError[x]);
+                    }
+                }
+                if (error <= tol) {
+                    break;
+                }
+                nwindows *= 2;
+            }
+            
+            // Pack the windows
+            iso.windowBegin.push_back(0);
+            for (auto& fit : fits) {
+                iso.poles.insert
+                (iso.poles.end(), fit.poles.begin(), fit.poles.end());
+                iso.residues.insert
+                (iso.residues.end(), fit.residues.begin(), fit.residues.end());
+                iso.background.insert
+                (iso.background.end(), fit.background.begin(),
+                 fit.background.end());
+                iso.windowBegin.push_back(iso.poles.size());
+                for (long x=0; x<=WMP_NREACTIONS; x++) {
+                    errors[x] = std::max(errors[x], fit.maxRelError[x]);
+                }
+            }
+            data.isotopes.push_back(std::move(iso));
+        }
+        
+        data.maxRelError.elastic = errors[WMP_ELASTIC];
+        data.maxRelError.capture = errors[WMP_CAPTURE];
+        data.maxRelError.fission = errors[WMP_FISSION];
+        data.maxRelError.total   = errors[WMP_NREACTIONS];
+        
+    } catch (std::exception& e) {
+        std::cerr << "[WMP]: error msg - " << e.what() << std::endl;
+        data = WMPData();
+    }
+    
+    return data;
+}
+
+//}
+//}
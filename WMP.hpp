@@ -0,0 +1,129 @@
+//
+//  Licensed to the Apache Software Foundation (ASF) under one or more
+//  contributor license agreements.  See the NOTICE file distributed with
+//  this work for additional information regarding copyright ownership.
+//  The ASF licenses this file to You under the Apache License, Version 2.0
+//  (the "License"); you may not use this file except in compliance with
+//  the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+//
+
+// Windowed Multipole (WMP)
+
+#ifndef WMP_HPP
+#define WMP_HPP
+
+#include <iostream>
+#include <vector>
+#include <ccomplex>
+
+#include "CMS.hpp"
+#include "ENDF.hpp"
+
+//namespace com {
+//namespace ibhe {
+
+// Reactions of the multipole fits, the total is their sum
+enum WMPReaction {
+    WMP_ELASTIC = 0,
+    WMP_CAPTURE = 1,
+    WMP_FISSION = 2,
+    WMP_NREACTIONS
+};
+
+// Windowed multipole form of the resolved resonance range of an isotope
+// The range is cut into windows of equal width in u = sqrt(E), within
+// window w the cross sections times E are
+//   E*xs(u) = sum of Re[r_j/(p_j - u)] + sum of c_k*s^k, k = 0 .. order
+// over the poles p_j (Im p_j > 0) near the window, and a polynomial in
+// s = (u - center)/halfWidth taking the far poles and the potential
+// scattering. At temperature T the pole terms are broadened with the
+// Faddeeva function, and the polynomial with the moments of the Gaussian
+// of width sqrt(kT/AWR) in u
+struct WMPIsotope {
+    
+    // Abundance of the isotope
+    double ABN = 1.;
+    
+    // Atomic weight ratio of the isotope
+    double AWR = 1.;
+    
+    // The windows cover [uMin, uMax], each of width spacing
+    double uMin    = 0.;
+    double uMax    = 0.;
+    double spacing = 0.;
+    
+    // Order of the background polynomials
+    long order = 0;
+    
+    // The poles of window w are poles[windowBegin[w] .. windowBegin[w+1])
+    // A pole is stored in every window it is close to
+    std::vector<long> windowBegin;
+    std::vector< std::complex<double> > poles;
+    
+    // The residue of reaction x of pole q is residues[q*WMP_NREACTIONS+x]
+    std::vector< std::complex<double> > residues;
+    
+    // The polynomial of reaction x of window w starts from
+    // background[(w*WMP_NREACTIONS + x)*(order+1)]
+    std::vector<double> background;
+    
+    long numWindows() const {
+        return long(windowBegin.size()) - 1;
+    }
+};
+
+// Windowed multipole data of the resolved resonance ranges of a material
+struct WMPData {
+    
+    // The isotopes, summed with their abundances
+    std::vector<WMPIsotope> isotopes;
+    
+    // The maximum relative error of each cross section at 0K, checked
+    // against the reconstruction between the fitted points
+    ENDFNeutronData::Resonance::Xsec maxRelError;
+    
+    bool valid() const {
+        return !isotopes.empty();
+    }
+    
+    // Evaluate the cross sections at energyEv and tempK, zero out of the
+    // resolved ranges. The potential scattering is not separated from the
+    // elastic scattering and left zero
+    ENDFNeutronData::Resonance::Xsec
+    evaluate(double energyEv, double tempK) const;
+    
+    // Number of bytes of the poles, residues and polynomials
+    long memorySize() const;
+};
+
+class WMP {
+public:
+    
+    // Convert the resolved resonance ranges (LRF=1,2,3) of ndata to the
+    // windowed multipole form. The residues and polynomials are fitted
+    // to the cross sections at 0K, the windows are narrowed until the
+    // relative error is within tol, or as far as the poles allow. Each
+    // window keeps the poles within twice the larger of half its width
+    // and 6 Doppler widths at tempMaxK. The windows are fitted on
+    // nthreads threads, the data is empty on error
+    static WMPData convert
+    (const ENDFNeutronData* ndata, double tol, double tempMaxK = 3000.,
+     long nthreads = 1);
+    
+    // The Faddeeva function w(z) = exp(-z^2)*erfc(-i*z), Im(z) >= 0
+    static std::complex<double> faddeeva(std::complex<double> z);
+    
+};
+
+//}
+//}
+
+#endif /* WMP_HPP */
@@ -17,23 +17,179 @@
 
 #include "XRS.hpp"
 #include "CMS.hpp"
+#include "PRS.hpp"
+#include "IRS.hpp"
 
-#include <list>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
 
 //namespace com {
 //namespace ibhesd {
 
+// Number of refinement intervals per thread, for load balancing
+// and progress reports
+static const long xrsIntervalsPerThread = 16;
+
+// The streamed reconstruction cuts the range into this many intervals,
+// and holds the points of a chunk of consecutive intervals in memory
+static const long xrsStreamIntervals = 4096;
+static const long xrsStreamChunk     = 64;
+
+// Streamed file: a header of the magic number, the number of points,
+// the index stride and the position of the index as 64-bit integers,
+// then the points as (x, elastic, fission, capture, potential) and the
+// index, the energy of every stride-th point. The magic number is only
+// written with the final header, so an unfinished file is not valid
+static const char xrsStreamMagic[8] = {'X','R','S','R','R','0','1','\0'};
+static const long xrsStreamStride   = 256;
+static const long xrsStreamValues   = 5;
+
+using XRSXsec = ENDFNeutronData::Resonance::Xsec;
+using XRSNode = std::pair<double, XRSXsec>;
+
+// Whether the middle point p3 is converged against p1 and p2
+static bool XRSConverged
+(const XRSXsec& p1, const XRSXsec& p2, const XRSXsec& p3, double tol) {
+    // Set zero threshold
+    const double thres = CMS::zeroThres; // barn
+    
+    // Check zero threshold
+    if ((fabs(p1.fission) <= thres &&
+         fabs(p2.fission) <= thres) &&
+        (fabs(p1.elastic) <= thres &&
+         fabs(p2.elastic) <= thres) &&
+        (fabs(p1.capture) <= thres &&
+         fabs(p2.capture) <= thres) &&
+        (fabs(p1.potential) <= thres &&
+         fabs(p2.potential) <= thres) )
+    {
+        return true;
+    }
+    // Check middle point convergence
+    if ((fabs(p3.fission - 0.5*(p1.fission+p2.fission))
+        <= tol*fabs(p3.fission)) &&
+        (fabs(p3.capture - 0.5*(p1.capture+p2.capture))
+        <= tol*fabs(p3.capture)) &&
+        (fabs(p3.elastic - 0.5*(p1.elastic+p2.elastic))
+         <= tol*fabs(p3.elastic)) &&
+        (fabs(p3.potential - 0.5*(p1.potential+p2.potential))
+         <= tol*fabs(p3.potential)))
+    {
+        return true;
+    }
+    // Return false otherwise
+    return false;
+}
+
+// Split the intervals between the nodes at their middle points until
+// all are converged, or at least limit (> 0) are still open. leaf tells
+// whether the interval following a node is converged. The middle points
+// are evaluated one by one, as in the serial refinement, so the points
+// are the same bit for bit
+static void XRSExpand
+(const ENDFNeutronData* ndata, double tol, long nthreads, double tempK,
+ long limit, std::vector<XRSNode>& nodes, std::vector<char>& leaf) {
+    
+    while (true) {
+        
+        // The intervals not yet converged
+        std::vector<long> open;
+        for (long k=0; k+1<nodes.size(); k++) {
+            if (!leaf[k]) {
+                open.push_back(k);
+            }
+        }
+        if (open.empty() || (limit > 0 && open.size() >= limit)) {
+            break;
+        }
+        
+        // Evaluate their middle points
+        std::vector<XRSNode> mids(open.size());
+        PRS::parallelFor(open.size(), nthreads, 1, [&] (long b, long e) {
+            for (long n=b; n<e; n++) {
+                long   k  = open[n];
+                double em = 0.5*(nodes[k].first + nodes[k+1].first);
+                mids[n] = std::make_pair
+                (em, ndata->getResolvedResonanceXsec(em, tempK));
+            }
+        });
+        
+        // Split the intervals not converged
+        std::vector<XRSNode> newNodes;
+        std::vector<char> newLeaf;
+        long n = 0;
+        for (long k=0; k+1<nodes.size(); k++) {
+            newNodes.push_back(nodes[k]);
+            if (leaf[k]) {
+                newLeaf.push_back(1);
+                continue;
+            }
+            auto& xm = mids[n++];
+            // The interval can not be split below the resolution
+            if (xm.first == nodes[k].first || xm.first == nodes[k+1].first ||
+                XRSConverged
+                (nodes[k].second, nodes[k+1].second, xm.second, tol)) {
+                newLeaf.push_back(1);
+            } else {
+                newLeaf.push_back(0);
+                newNodes.push_back(xm);
+                newLeaf.push_back(0);
+            }
+        }
+        newNodes.push_back(nodes.back());
+        
+        nodes.swap(newNodes);
+        leaf.swap(newLeaf);
+    }
+}
+
+// Refine the intervals between the nodes concurrently, each gives its
+// points except the upper end in parts, report is called with the number
+// of points of each finished interval
+static void XRSRefine
+(const ENDFNeutronData* ndata, double tol, long nthreads, double tempK,
+ const std::vector<XRSNode>& nodes, const std::vector<char>& leaf,
+ std::vector< std::vector<XRSNode> >& parts,
+ const std::function<void(long)>& report) {
+    
+    auto converged = [tol]
+    (const XRSXsec& p1, const XRSXsec& p2, const XRSXsec& p3) -> bool {
+        return XRSConverged(p1, p2, p3, tol);
+    };
+    
+    long nint = nodes.size() - 1;
+    parts.resize(nint);
+    PRS::parallelFor(nint, nthreads, 1, [&] (long b, long e) {
+        IRSEngine<XRSXsec> engine;
+        auto eval = [&] (double x) {
+            return ndata->getResolvedResonanceXsec(x, tempK);
+        };
+        for (long k=b; k<e; k++) {
+            if (leaf[k]) {
+                parts[k].push_back(nodes[k]);
+            } else {
+                engine.refine
+                (nodes[k], nodes[k+1], eval, converged, parts[k]);
+            }
+            report(parts[k].size());
+        }
+    });
+}
+
 XRSRRFunction XRS::processResolvedResonance
-(ENDFNeutronData *ndata, double tol) {
+(const ENDFNeutronData* ndata, double tol, long nthreads,
+ const XRSProgressFunc& progress, double tempK) {
     
     // Data points
     XRSRRFunction xsec;
     
     try {
         
-        // Make a local copy of data
-        std::vector<XRSRRDataPoint> data;
-        
         if (ndata == nullptr) {
             throw std::logic_error("neutron data not valid!");
         }
@@ -42,12 +198,6 @@ XRSRRFunction XRS::processResolvedResonance
             throw std::logic_error("invalid tolerance!");
         }
         
-        // Using alias for simplicities
-        using Xsec = ENDFNeutronData::Resonance::Xsec;
-        
-        // Prepare the stack for invert stack method
-        std::list< std::pair<double, Xsec> > stack;
-        
         // Obtain the energy ranges of resolved resonance
         auto p = ndata->getResolvedResonanceRange();
         
@@ -57,42 +207,9 @@ XRSRRFunction XRS::processResolvedResonance
             return xsec;
         }
         
-        // Set zero threshold
-        const double thres = CMS::zeroThres; // barn
-        
-        // Lambda function for determing the convergence
-        auto converged = [&]
-        (const Xsec& p1, const Xsec& p2, const Xsec& p3) -> bool {
-            // Check zero threshold
-            if ((fabs(p1.fission) <= thres &&
-                 fabs(p2.fission) <= thres) &&
-                (fabs(p1.elastic) <= thres &&
-                 fabs(p2.elastic) <= thres) &&
-                (fabs(p1.capture) <= thres &&
-                 fabs(p2.capture) <= thres) &&
-                (fabs(p1.potential) <= thres &&
-                 fabs(p2.potential) <= thres) )
-            {
-                return true;
-            }
-            // Check middle point convergence
-            if ((fabs(p3.fission - 0.5*(p1.fission+p2.fission))
-                <= tol*fabs(p3.fission)) &&
-                (fabs(p3.capture - 0.5*(p1.capture+p2.capture))
-                <= tol*fabs(p3.capture)) &&
-                (fabs(p3.elastic - 0.5*(p1.elastic+p2.elastic))
-                 <= tol*fabs(p3.elastic)) &&
-                (fabs(p3.potential - 0.5*(p1.potential+p2.potential))
-                 <= tol*fabs(p3.potential)))
-            {
-                return true;
-            }
-            // Return false otherwise
-            return false;
-        };
-        
         // Lambda function for adding to result
-        auto addToResult = [&] (const std::pair<double, Xsec>& pair) {
+        auto addToResult = [&]
+        (const XRSNode& pair, std::vector<XRSRRDataPoint>& data) {
             XRSRRDataPoint dp;
             dp.x           = pair.first;
             dp.y.elastic   = pair.second.elastic;
@@ -102,34 +219,53 @@ XRSRRFunction XRS::processResolvedResonance
             data.push_back(dp);
         };
         
-        // Insert the lower and upper points
-        stack.push_back
-        ( std::make_pair(p.first, ndata->getResolvedResonanceXsec(p.first)) );
-        stack.push_back
-        ( std::make_pair(p.second, ndata->getResolvedResonanceXsec(p.second)) );
-        
-        // Perform inverted stack methods
-        decltype(stack)::iterator it, itnext;
-        while (stack.size() >= 2) {
-            it = stack.begin();
-            itnext = std::next(it);
-            double em = 0.5*(it->first + itnext->first);
-            auto   xm = ndata->getResolvedResonanceXsec(em);
-            if (!converged(it->second, itnext->second, xm)) {
-                stack.insert(itnext, std::make_pair(em, xm));
-            } else {
-                addToResult(stack.front());
-                stack.pop_front();
-                if (data.size() % 5000 == 0) {
-                    std::cout << data.size() << " data points added!"
-                    << std::endl;
-                }
+        // Progress is reported as the intervals are finished
+        std::atomic<long> finished(0);
+        std::mutex progressMutex;
+        auto report = [&] (long npoints) {
+            long total = finished.fetch_add(npoints) + npoints;
+            if (progress) {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                progress(total);
             }
-        }
+        };
+        
+        // The refinement splits an interval at its middle point until
+        // converged, the final grid consists of the leaves of this binary
+        // tree, independent of the order the intervals are visited in.
+        // So the tree is first expanded breadth first into enough
+        // intervals, which are then refined concurrently and stitched
+        // in order, giving exactly the points of the serial refinement
+        std::vector<XRSNode> nodes;
+        nodes.push_back
+        ( std::make_pair
+         (p.first, ndata->getResolvedResonanceXsec(p.first, tempK)) );
+        nodes.push_back
+        ( std::make_pair
+         (p.second, ndata->getResolvedResonanceXsec(p.second, tempK)) );
+        std::vector<char> leaf(1, 0);
+        
+        long nworker = PRS::numThreads(nthreads);
+        long target  = nworker*xrsIntervalsPerThread;
+        XRSExpand(ndata, tol, nthreads, tempK, target, nodes, leaf);
         
-        // Add the last data point
-        addToResult(stack.front());
-        stack.pop_front();
+        std::vector< std::vector<XRSNode> > parts;
+        XRSRefine(ndata, tol, nthreads, tempK, nodes, leaf, parts, report);
+        
+        // Stitch the intervals in order, and add the last data point
+        std::vector<XRSRRDataPoint> data;
+        long npoints = 1;
+        for (auto& part : parts) {
+            npoints += part.size();
+        }
+        data.reserve(npoints);
+        for (auto& part : parts) {
+            for (auto& node : part) {
+                addToResult(node, data);
+            }
+            std::vector<XRSNode>().swap(part);
+        }
+        addToResult(nodes.back(), data);
         
         // Copy to xsec
         xsec.init(data);
@@ -142,5 +278,271 @@ XRSRRFunction XRS::processResolvedResonance
     return xsec;
 }
 
+long XRS::processResolvedResonance
+(const ENDFNeutronData* ndata, double tol, const std::string& filepath,
+ long nthreads, const XRSProgressFunc& progress, double tempK) {
+    
+    long npoints = 0;
+    
+    // Whether the file is created, it is removed on error
+    bool created = false;
+    
+    try {
+        
+        if (ndata == nullptr) {
+            throw std::logic_error("neutron data not valid!");
+        }
+        
+        if (tol <= 0.) {
+            throw std::logic_error("invalid tolerance!");
+        }
+        
+        std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::logic_error("cannot open " + filepath + "!");
+        }
+        created = true;
+        
+        // Header, left blank until finished
+        int64_t header[3] = {0, xrsStreamStride, 0};
+        char blank[sizeof(xrsStreamMagic)] = {};
+        out.write(blank, sizeof(blank));
+        out.write((const char*)header, sizeof(header));
+        
+        // Points are written as they are finished, the index is kept
+        std::vector<double> index;
+        std::vector<double> buffer;
+        auto write = [&] (const XRSNode& node) {
+            if (npoints % xrsStreamStride == 0) {
+                index.push_back(node.first);
+            }
+            buffer.push_back(node.first);
+            buffer.push_back(node.second.elastic);
+            buffer.push_back(node.second.fission);
+            buffer.push_back(node.second.capture);
+            buffer.push_back(node.second.potential);
+            npoints++;
+        };
+        auto flush = [&] () {
+            out.write((const char*)buffer.data(),
+                      buffer.size()*sizeof(double));
+            buffer.clear();
+            if (!out) {
+                throw std::logic_error("cannot write " + filepath + "!");
+            }
+        };
+        
+        // Obtain the energy ranges of resolved resonance
+        auto p = ndata->getResolvedResonanceRange();
+        
+        if (p.first != 0. || p.second != 0.) {
+            
+            std::atomic<long> finished(0);
+            std::mutex progressMutex;
+            auto report = [&] (long n) {
+                long total = finished.fetch_add(n) + n;
+                if (progress) {
+                    std::lock_guard<std::mutex> lock(progressMutex);
+                    progress(total);
+                }
+            };
+            
+            // The top of the tree cuts the range into intervals, a chunk
+            // of them is refined as in memory at a time and written.
+            // The points are those of the reconstruction in memory
+            std::vector<XRSNode> nodes;
+            nodes.push_back
+            ( std::make_pair
+             (p.first, ndata->getResolvedResonanceXsec(p.first, tempK)) );
+            nodes.push_back
+            ( std::make_pair
+             (p.second, ndata->getResolvedResonanceXsec(p.second, tempK)) );
+            std::vector<char> leaf(1, 0);
+            XRSExpand
+            (ndata, tol, nthreads, tempK, xrsStreamIntervals, nodes, leaf);
+            
+            long nworker = PRS::numThreads(nthreads);
+            long target  = nworker*xrsIntervalsPerThread;
+            long nint    = nodes.size() - 1;
+            for (long c=0; c<nint; c+=xrsStreamChunk) {
+                long e = std::min(nint, c + xrsStreamChunk);
+                std::vector<XRSNode> chunk
+                (nodes.begin() + c, nodes.begin() + e + 1);
+                std::vector<char> chunkLeaf
+                (leaf.begin() + c, leaf.begin() + e);
+                XRSExpand
+                (ndata, tol, nthreads, tempK, target, chunk, chunkLeaf);
+                
+                std::vector< std::vector<XRSNode> > parts;
+                XRSRefine
+                (ndata, tol, nthreads, tempK, chunk, chunkLeaf, parts,
+                 report);
+                for (auto& part : parts) {
+                    for (auto& node : part) {
+                        write(node);
+                    }
+                    std::vector<XRSNode>().swap(part);
+                    flush();
+                }
+            }
+            write(nodes.back());
+            flush();
+        }
+        
+        // The index and the final header
+        header[0] = npoints;
+        header[2] = sizeof(xrsStreamMagic) + sizeof(header) +
+        npoints*xrsStreamValues*sizeof(double);
+        out.write((const char*)index.data(), index.size()*sizeof(double));
+        out.seekp(0);
+        out.write(xrsStreamMagic, sizeof(xrsStreamMagic));
+        out.write((const char*)header, sizeof(header));
+        out.close();
+        if (!out) {
+            throw std::logic_error("cannot write " + filepath + "!");
+        }
+        
+    } catch (std::exception& e) {
+        std::cerr << "[XRS]: error msg - " << e.what() << std::endl;
+        if (created) {
+            std::remove(filepath.c_str());
+        }
+        npoints = -1;
+    }
+    
+    return npoints;
+}
+
+XRSRRFile::XRSRRFile(const std::string& filepath) {
+    open(filepath);
+}
+
+bool XRSRRFile::open(const std::string& filepath) {
+    
+    close();
+    _in.open(filepath, std::ios::binary);
+    
+    char magic[sizeof(xrsStreamMagic)];
+    int64_t header[3];
+    _in.read(magic, sizeof(magic));
+    _in.read((char*)header, sizeof(header));
+    if (!_in || !std::equal(magic, magic + sizeof(magic), xrsStreamMagic)) {
+        std::cerr << "[XRS]: not a streamed reconstruction - "
+        << filepath << std::endl;
+        close();
+        return false;
+    }
+    _size   = header[0];
+    _stride = header[1];
+    _begin  = sizeof(magic) + sizeof(header);
+    
+    _index.resize(_size > 0 ? (_size - 1)/_stride + 1 : 0);
+    _in.seekg(header[2]);
+    _in.read((char*)_index.data(), _index.size()*sizeof(double));
+    if (!_in || _stride <= 0) {
+        std::cerr << "[XRS]: truncated streamed reconstruction - "
+        << filepath << std::endl;
+        close();
+        return false;
+    }
+    
+    return true;
+}
+
+void XRSRRFile::close() {
+    if (_in.is_open()) {
+        _in.close();
+    }
+    _in.clear();
+    _size  = 0;
+    _index.clear();
+    _block.clear();
+    _blockFirst = -1;
+}
+
+long XRSRRFile::read
+(long first, long n, std::vector<XRSRRDataPoint>& points) {
+    
+    points.clear();
+    if (first < 0 || first >= _size || n <= 0) {
+        return 0;
+    }
+    n = std::min(n, _size - first);
+    
+    std::vector<double> values(n*xrsStreamValues);
+    _in.clear();
+    _in.seekg(_begin + first*xrsStreamValues*sizeof(double));
+    _in.read((char*)values.data(), values.size()*sizeof(double));
+    if (!_in) {
+        throw std::logic_error("cannot read streamed reconstruction!");
+    }
+    
+    points.resize(n);
+    for (long i=0; i<n; i++) {
+        const double* v = &values[i*xrsStreamValues];
+        points[i].x           = v[0];
+        points[i].y.elastic   = v[1];
+        points[i].y.fission   = v[2];
+        points[i].y.capture   = v[3];
+        points[i].y.potential = v[4];
+    }
+    
+    return n;
+}
+
+long XRSRRFile::locate(double x) {
+    
+    if (_size == 0 || x < _index.front()) {
+        return -1;
+    }
+    
+    try {
+        
+        // The block from the index, then the point in the block, the last
+        // block read is kept for nearby lookups
+        long b = std::upper_bound(_index.begin(), _index.end(), x) -
+        _index.begin() - 1;
+        if (_blockFirst != b*_stride) {
+            // The block with the first point of the next block
+            read(b*_stride, _stride + 1, _block);
+            _blockFirst = b*_stride;
+        }
+        long i = std::upper_bound
+        (_block.begin(), _block.end(), x,
+         [] (double v, const XRSRRDataPoint& p) {return v < p.x;}) -
+        _block.begin() - 1;
+        
+        return _blockFirst + i;
+        
+    } catch (std::exception& e) {
+        std::cerr << "[XRS]: error msg - " << e.what() << std::endl;
+    }
+    
+    return -1;
+}
+
+XRSRRXsec XRSRRFile::evaluate(double x) {
+    
+    XRSRRXsec xsec;
+    long i = locate(x);
+    if (i < 0 || i >= _size - 1) {
+        if (i == _size - 1 && i >= 0 && x == _block.back().x) {
+            return _block.back().y;
+        }
+        return xsec;
+    }
+    
+    // Linear-linear interpolation, as the refinement
+    auto& p1 = _block[i - _blockFirst];
+    auto& p2 = _block[i - _blockFirst + 1];
+    double t = (p2.x > p1.x) ? (x - p1.x)/(p2.x - p1.x) : 0.;
+    xsec.elastic   = p1.y.elastic   + t*(p2.y.elastic   - p1.y.elastic);
+    xsec.fission   = p1.y.fission   + t*(p2.y.fission   - p1.y.fission);
+    xsec.capture   = p1.y.capture   + t*(p2.y.capture   - p1.y.capture);
+    xsec.potential = p1.y.potential + t*(p2.y.potential - p1.y.potential);
+    
+    return xsec;
+}
+
 //}
 //}
\ No newline at end of file
@@ -19,6 +19,10 @@
 #define XRS_HPP
 
 #include <iostream>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
 
 #include "ENDF.hpp"
 #include "CMS.hpp"
@@ -47,10 +51,77 @@ struct XRSRRXsec {
 typedef ENDFObjectDataPoint<XRSRRXsec> XRSRRDataPoint;
 typedef ENDFObjectInterpolationFunction<XRSRRXsec>  XRSRRFunction;
 
+// Progress report, called with the number of data points finished
+typedef std::function<void(long)> XRSProgressFunc;
+
 class XRS {
 public:
+    // Reconstruct the resolved resonance cross sections to tolerance tol
+    // The range is refined on nthreads threads (<= 0 uses all hardware
+    // threads), the points do not depend on the number of threads.
+    // progress is called with the number of finished points if given,
+    // as the refinement intervals (about 16 per thread) are finished.
+    // With tempK > 0 the SLBW and MLBW ranges are reconstructed Doppler
+    // broadened, with no 0K grid and broadening pass. The resonances of
+    // l >= 1 are then integrated over the free gas kernel at each point,
+    // which is slower than the line shapes of the s-wave resonances
     static XRSRRFunction processResolvedResonance
-    (ENDFNeutronData* ndata, double tol);
+    (const ENDFNeutronData* ndata, double tol, long nthreads = 1,
+     const XRSProgressFunc& progress = nullptr, double tempK = 0.);
+    
+    // Reconstruct as above, streaming the points to the binary file at
+    // filepath as the range is refined chunk by chunk, so only a chunk
+    // of the points is held in memory. The points are the same as those
+    // in memory. Returns the number of points, -1 on error
+    static long processResolvedResonance
+    (const ENDFNeutronData* ndata, double tol, const std::string& filepath,
+     long nthreads = 1, const XRSProgressFunc& progress = nullptr,
+     double tempK = 0.);
+    
+};
+
+// Reader of a reconstruction streamed to a file, the points are read on
+// demand and only an index of the energy of every 256th point is loaded
+class XRSRRFile {
+public:
+    
+    XRSRRFile() {}
+    XRSRRFile(const std::string& filepath);
+    
+    // Open a streamed file, false if it is not valid
+    bool open(const std::string& filepath);
+    void close();
+    
+    bool valid() const {return _in.is_open();}
+    
+    // Number of points
+    long size() const {return _size;}
+    
+    // Read n points from position first into points, in increasing
+    // energies. Returns the number of points read
+    long read(long first, long n, std::vector<XRSRRDataPoint>& points);
+    
+    // Position of the last point with energy not above x, -1 if below
+    // the first point or if the file can not be read
+    long locate(double x);
+    
+    // Cross sections at x, linearly interpolated, zero outside the range
+    // or if the file can not be read
+    XRSRRXsec evaluate(double x);
+    
+private:
+    
+    std::ifstream _in;
+    long _size   = 0;
+    long _stride = 1;
+    long _begin  = 0;
+    
+    // Energy of every stride-th point
+    std::vector<double> _index;
+    
+    // The last block of points read by locate
+    std::vector<XRSRRDataPoint> _block;
+    long _blockFirst = -1;
     
 };
 